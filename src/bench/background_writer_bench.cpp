@@ -0,0 +1,98 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Measures what the background writer saves on the miss path. A thread pins random pages
+ * of a file larger than the pool and dirties a fraction of them, first with the writer off
+ * and then with it on. For each run the average latency of a miss is printed along with
+ * how many dirty pages the writer cleaned and how many evictions still had to write.
+ *
+ * Usage: ./background_writer_bench [ops] [dirtyPercent] [cleanPercent]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include "bench_util.h"
+#include "buffer.h"
+#include "file.h"
+
+using namespace badgerdb;
+
+const std::string benchFileName = "bench_writer.db";
+const int numPages = 4000;
+const std::uint32_t numFrames = 500;
+
+void run(bool withWriter, int ops, int dirtyPercent, double cleanFraction)
+{
+	PageFile file = PageFile::open(benchFileName);
+	BufMgr* bufMgr = new BufMgr(numFrames);
+	if (withWriter)
+		bufMgr->startBackgroundWriter(cleanFraction, std::chrono::milliseconds(1));
+
+	std::mt19937 rng(7);
+	std::uniform_int_distribution<PageId> pick(1, numPages);
+	std::uniform_int_distribution<int> percent(0, 99);
+
+	double missSecs = 0;
+	for (int i = 0; i < ops; i++)
+	{
+		PageId pageNo = pick(rng);
+		Page* page;
+		const int missesBefore = bufMgr->getBufStats().misses;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bufMgr->readPage(&file, pageNo, page);
+		if (bufMgr->getBufStats().misses != missesBefore)
+			missSecs += secondsSince(start);
+		bufMgr->unPinPage(&file, pageNo, percent(rng) < dirtyPercent);
+
+		// leave the writer some room, as a real query would between page accesses
+		if (withWriter && i % 64 == 0)
+			std::this_thread::yield();
+	}
+
+	BufStats& stats = bufMgr->getBufStats();
+	std::printf("writer:%-3s misses:%7d avg miss:%8.2f us  writer writes:%7d eviction writes:%7d\n",
+		withWriter ? "on" : "off", (int) stats.misses, stats.misses ? 1e6 * missSecs / stats.misses : 0.0,
+		(int) stats.writerWrites, (int) stats.evictionWrites);
+
+	delete bufMgr;
+}
+
+int main(int argc, char **argv)
+{
+	int ops = 200000;
+	int dirtyPercent = 30;
+	int cleanPercent = 10;
+	if (argc > 1)
+		ops = atoi(argv[1]);
+	if (argc > 2)
+		dirtyPercent = atoi(argv[2]);
+	if (argc > 3)
+		cleanPercent = atoi(argv[3]);
+
+	removeIfPresent(benchFileName);
+
+	{
+		PageFile file = PageFile::create(benchFileName);
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			file.allocatePage(pageNo);
+		}
+	}
+
+	std::printf("pages:%d frames:%u ops:%d dirty:%d%% clean target:%d%%\n",
+		numPages, numFrames, ops, dirtyPercent, cleanPercent);
+	run(false, ops, dirtyPercent, cleanPercent / 100.0);
+	run(true, ops, dirtyPercent, cleanPercent / 100.0);
+
+	File::remove(benchFileName);
+	return 0;
+}
@@ -0,0 +1,101 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Helpers shared by the benchmarks: file cleanup, timing, and counters of this process
+ * from /proc.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "file.h"
+#include "exceptions/file_not_found_exception.h"
+
+namespace badgerdb {
+
+/**
+ * Deletes a file left over from an earlier run, if there is one.
+ *
+ * @param name	Name of the file
+ */
+inline void removeIfPresent(const std::string& name)
+{
+	try
+	{
+		File::remove(name);
+	}
+	catch(FileNotFoundException &e)
+	{
+	}
+}
+
+/**
+ * Seconds since the given time.
+ *
+ * @param start	Start of the interval
+ */
+inline double secondsSince(const std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Nanoseconds per operation since the given time.
+ *
+ * @param start	Start of the interval
+ * @param ops  	Operations done in it
+ */
+inline double nsSince(const std::chrono::steady_clock::time_point start, const int ops)
+{
+	return 1e9 * secondsSince(start) / ops;
+}
+
+/**
+ * Value of a field in a /proc file of this process, like "VmRSS:" in /proc/self/status.
+ * 0 if the file or field can't be found.
+ *
+ * @param path 	File to read
+ * @param field	Field name, with its colon
+ */
+inline long procField(const char* path, const char* field)
+{
+	FILE* proc = fopen(path, "r");
+	char line[256];
+	long value = 0;
+	const std::size_t length = strlen(field);
+	while (proc != NULL && fgets(line, sizeof(line), proc) != NULL)
+	{
+		if (strncmp(line, field, length) == 0)
+			value = atol(line + length);
+	}
+	if (proc != NULL)
+		fclose(proc);
+	return value;
+}
+
+/**
+ * Resident set size of this process, in kilobytes.
+ */
+inline long residentKb()
+{
+	return procField("/proc/self/status", "VmRSS:");
+}
+
+/**
+ * Read system calls of this process so far.
+ */
+inline long readCalls()
+{
+	return procField("/proc/self/io", "syscr:");
+}
+
+}
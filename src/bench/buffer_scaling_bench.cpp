@@ -0,0 +1,104 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Scalability benchmark for BufMgr: every thread repeatedly pins a random page with
+ * readPage() and releases it with unPinPage(). The run is repeated with 1 to N threads,
+ * once with an unpartitioned pool and once with the pool split into partitions, and the
+ * aggregate throughput is printed for each thread count.
+ *
+ * Usage: ./buffer_scaling_bench [maxThreads] [opsPerThread] [partitions]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "bench_util.h"
+#include "buffer.h"
+#include "file.h"
+
+using namespace badgerdb;
+
+const std::string benchFileName = "bench_scaling.db";
+const int numPages = 1000;
+const std::uint32_t numFrames = 512;
+
+void worker(BufMgr* bufMgr, File* file, std::uint32_t seed, int ops)
+{
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<PageId> pick(1, numPages);
+
+	for (int i = 0; i < ops; i++)
+	{
+		PageId pageNo = pick(rng);
+		Page* page;
+		bufMgr->readPage(file, pageNo, page);
+		bufMgr->unPinPage(file, pageNo, false);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int maxThreads = std::thread::hardware_concurrency();
+	int opsPerThread = 200000;
+	int partitions = std::thread::hardware_concurrency();
+	if (argc > 1)
+		maxThreads = atoi(argv[1]);
+	if (argc > 2)
+		opsPerThread = atoi(argv[2]);
+	if (argc > 3)
+		partitions = atoi(argv[3]);
+	if (maxThreads < 1)
+		maxThreads = 1;
+	if (partitions < 1)
+		partitions = 1;
+
+	removeIfPresent(benchFileName);
+
+	{
+		PageFile file = PageFile::create(benchFileName);
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			file.allocatePage(pageNo);
+		}
+	}
+
+	std::cout << "pages:" << numPages << " frames:" << numFrames
+		<< " ops/thread:" << opsPerThread << std::endl;
+
+	const int partitionCounts[] = { 1, partitions };
+	for (int run = 0; run < (partitions > 1 ? 2 : 1); run++)
+	{
+		for (int threads = 1; threads <= maxThreads; threads++)
+		{
+			PageFile file = PageFile::open(benchFileName);
+			BufMgr* bufMgr = new BufMgr(numFrames, CLOCK, POOL_DEFAULT, numFrames, partitionCounts[run]);
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			std::vector<std::thread> pool;
+			for (int t = 0; t < threads; t++)
+				pool.push_back(std::thread(worker, bufMgr, &file, 17 + t, opsPerThread));
+			for (int t = 0; t < threads; t++)
+				pool[t].join();
+			double secs = secondsSince(start);
+
+			double ops = (double) threads * opsPerThread;
+			std::printf("partitions:%2u  threads:%2d  ops/sec:%12.0f  diskreads:%d\n",
+				bufMgr->getNumPartitions(), threads, ops / secs, (int) bufMgr->getBufStats().diskreads);
+
+			delete bufMgr;
+		}
+	}
+
+	File::remove(benchFileName);
+	return 0;
+}
@@ -0,0 +1,104 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Measures the clock sweep on its own, for pools of up to millions of frames. Every frame
+ * holds a page; between two misses a number of hits set the reference bits of random frames,
+ * so the more hits per miss, the more frames the hand must pass before it finds a victim. A
+ * few frames stay pinned throughout. Printed per run: time per victim and frames passed per
+ * victim, and the time to find a victim right after every frame was referenced, e.g. by a
+ * scan, when the hand has to pass the whole pool.
+ *
+ * Usage: ./clock_sweep_bench [misses] [max frames]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include "bench_util.h"
+#include "buffer.h"
+#include "replacement_policy.h"
+
+using namespace badgerdb;
+
+void run(const std::uint32_t frames, const int hitsPerMiss, const int misses)
+{
+	FrameStateTable states(frames);
+	ReplacementPolicy* policy = ReplacementPolicy::create(CLOCK, &states, 0, frames, frames);
+	std::mt19937 rng(9);
+	std::uniform_int_distribution<FrameId> pick(0, frames - 1);
+	for (FrameId i = 0; i < frames; i++)
+	{
+		states.assign(i);
+		states.pinCnt(i) = i % 1000 == 0 ? 1 : 0;
+	}
+
+	ReplacementPolicy::ClaimFn claim = [&states](FrameId frame) {
+		int unpinned = 0;
+		return states.pinCnt(frame).compare_exchange_strong(unpinned, 1);
+	};
+
+	// warm up into the steady state, then measure
+	double sweepNanos = 0;
+	std::uint64_t passed = 0;
+	for (int round = 0; round < 2; round++)
+	{
+		sweepNanos = 0;
+		passed = 0;
+		for (int i = 0; i < misses; i++)
+		{
+			for (int h = 0; h < hitsPerMiss; h++)
+				policy->recordAccess(pick(rng));
+
+			FrameId victim;
+			std::uint32_t examined = 0;
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			if (!policy->pickVictim(victim, claim, examined))
+			{
+				std::printf("no victim\n");
+				std::exit(1);
+			}
+			sweepNanos += nsSince(start, 1);
+			passed += examined;
+
+			// the new page is loaded and unpinned
+			policy->recordLoad(victim, File::INVALID_ID, 0);
+			states.pinCnt(victim) = 0;
+		}
+	}
+
+	for (FrameId i = 0; i < frames; i++)
+		policy->recordAccess(i);
+	FrameId victim;
+	std::uint32_t examined = 0;
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	policy->pickVictim(victim, claim, examined);
+	const double fullSweep = 1e6 * secondsSince(start);
+
+	std::printf("frames:%8u  hits/miss:%5d  victim:%9.1f ns  passed/victim:%9.1f  full sweep:%9.1f us\n",
+		frames, hitsPerMiss, sweepNanos / misses, (double) passed / misses, fullSweep);
+	delete policy;
+}
+
+int main(int argc, char **argv)
+{
+	int misses = 20000;
+	std::uint32_t maxFrames = 4 << 20;
+	if (argc > 1)
+		misses = atoi(argv[1]);
+	if (argc > 2)
+		maxFrames = atoi(argv[2]);
+
+	for (std::uint32_t frames = 1 << 16; frames <= maxFrames; frames <<= 3)
+	{
+		run(frames, 10, misses);
+		run(frames, 100, misses);
+		run(frames, 1000, misses);
+	}
+	return 0;
+}
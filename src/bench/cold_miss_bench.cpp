@@ -0,0 +1,148 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Measures what exceptions cost on the miss path. First a hash table miss is timed the old
+ * way, with lookup() throwing HashNotFoundException to the caller, and through tryLookup().
+ * Then the latency of a cold readPage() is printed, every access a miss on a file sitting
+ * in the kernel page cache, and finally a read into a fully pinned pool through readPage()
+ * (BufferExceededException) against tryReadPage() (BUF_EXCEEDED).
+ *
+ * Usage: ./cold_miss_bench [ops]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "bench_util.h"
+#include "buffer.h"
+#include "bufHashTbl.h"
+#include "file.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/hash_not_found_exception.h"
+
+using namespace badgerdb;
+
+const std::string benchFileName = "bench_cold_miss.db";
+const int numPages = 2000;
+const std::uint32_t numFrames = 500;
+
+void hashTableMisses(File* file, const int ops)
+{
+	BufHashTbl table(numFrames);
+	for (std::uint32_t i = 0; i < numFrames; i++)
+		table.insert(file, i + 1, i);
+
+	FrameId frameNo = 0;
+	int missing = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ops; i++)
+	{
+		try
+		{
+			table.lookup(file, numFrames + 1 + i, frameNo);
+		}
+		catch(HashNotFoundException &e)
+		{
+			missing++;
+		}
+	}
+	const double throwing = nsSince(start, ops);
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ops; i++)
+	{
+		if (!table.tryLookup(file, numFrames + 1 + i, frameNo))
+			missing++;
+	}
+	const double status = nsSince(start, ops);
+
+	std::printf("hash miss     lookup (throws):%9.1f ns  tryLookup:%7.1f ns  (%d misses)\n",
+		throwing, status, missing);
+}
+
+void coldReads(PageFile& file, const int ops)
+{
+	BufMgr* bufMgr = new BufMgr(numFrames);
+	Page* page;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ops; i++)
+	{
+		const PageId pageNo = 1 + i % numPages;
+		bufMgr->readPage(&file, pageNo, page);
+		bufMgr->unPinPage(&file, pageNo, false);
+	}
+	const double readNs = nsSince(start, ops);
+	std::printf("cold miss     readPage:%16.1f ns  (%d misses of %d reads)\n",
+		readNs, (int) bufMgr->getBufStats().misses, ops);
+	delete bufMgr;
+}
+
+void fullPool(PageFile& file, const int ops)
+{
+	BufMgr* bufMgr = new BufMgr(numFrames);
+	bufMgr->setPinWaitTimeout(std::chrono::milliseconds(0));
+	Page* page;
+	for (std::uint32_t i = 0; i < numFrames; i++)
+		bufMgr->readPage(&file, i + 1, page);
+
+	int refused = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ops; i++)
+	{
+		try
+		{
+			bufMgr->readPage(&file, numFrames + 1, page);
+		}
+		catch(BufferExceededException &e)
+		{
+			refused++;
+		}
+	}
+	const double throwing = nsSince(start, ops);
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ops; i++)
+	{
+		if (bufMgr->tryReadPage(&file, numFrames + 1, page) == BUF_EXCEEDED)
+			refused++;
+	}
+	const double status = nsSince(start, ops);
+
+	std::printf("full pool     readPage (throws):%7.1f ns  tryReadPage:%5.1f ns  (%d refused)\n",
+		throwing, status, refused);
+
+	for (std::uint32_t i = 0; i < numFrames; i++)
+		bufMgr->unPinPage(&file, i + 1, false);
+	delete bufMgr;
+}
+
+int main(int argc, char **argv)
+{
+	int ops = 200000;
+	if (argc > 1)
+		ops = atoi(argv[1]);
+
+	removeIfPresent(benchFileName);
+
+	{
+		PageFile file = PageFile::create(benchFileName);
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			file.allocatePage(pageNo);
+		}
+
+		std::printf("pages:%d frames:%u ops:%d\n", numPages, numFrames, ops);
+		hashTableMisses(&file, ops);
+		coldReads(file, ops);
+		fullPool(file, ops / 10);
+	}
+
+	File::remove(benchFileName);
+	return 0;
+}
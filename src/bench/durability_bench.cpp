@@ -0,0 +1,78 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Measures what each durability level costs a bulk load. Pages are allocated through a
+ * pool a quarter the size of the file, filled and unpinned dirty, so most reach the file
+ * through evictions; every batch of pages ends with commit(), and the load with flushFile().
+ * DURABILITY_NONE leaves all syncing to the operating system, SYNC_ON_FLUSHFILE syncs once
+ * at the end and SYNC_ON_COMMIT once per batch. Printed per level: pages loaded per second
+ * and the time of the closing flushFile().
+ *
+ * Usage: ./durability_bench [pages] [pages per commit]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "bench_util.h"
+#include "buffer.h"
+#include "file.h"
+
+using namespace badgerdb;
+
+const std::string benchFileName = "bench_durability.db";
+
+void run(const Durability level, const char* name, const int numPages, const int perCommit)
+{
+	removeIfPresent(benchFileName);
+
+	{
+		BlobFile file = BlobFile::create(benchFileName);
+		BufMgr* bufMgr = new BufMgr(numPages / 4 > 0 ? numPages / 4 : 1);
+		bufMgr->setDurability(level);
+
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			Page* page;
+			bufMgr->allocPage(&file, pageNo, page);
+			while (page->hasSpaceForRecord("row of a table being loaded, a hundred bytes or so"))
+				page->insertRecord("row of a table being loaded, a hundred bytes or so");
+			bufMgr->unPinPage(&file, pageNo, true);
+			if ((i + 1) % perCommit == 0)
+				bufMgr->commit(&file);
+		}
+		const std::chrono::steady_clock::time_point flushStart = std::chrono::steady_clock::now();
+		bufMgr->flushFile(&file);
+		const double flushSeconds = secondsSince(flushStart);
+		const double seconds = secondsSince(start);
+
+		std::printf("%-17s  load: %9.0f pages/s  closing flushFile: %8.2f ms\n",
+			name, numPages / seconds, flushSeconds * 1e3);
+		delete bufMgr;
+	}
+	File::remove(benchFileName);
+}
+
+int main(int argc, char **argv)
+{
+	int numPages = 20000;
+	int perCommit = 1000;
+	if (argc > 1)
+		numPages = atoi(argv[1]);
+	if (argc > 2)
+		perCommit = atoi(argv[2]);
+
+	std::printf("pages:%d pages per commit:%d\n", numPages, perCommit);
+	run(DURABILITY_NONE, "none", numPages, perCommit);
+	run(SYNC_ON_FLUSHFILE, "sync on flushFile", numPages, perCommit);
+	run(SYNC_ON_COMMIT, "sync on commit", numPages, perCommit);
+	return 0;
+}
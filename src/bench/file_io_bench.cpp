@@ -0,0 +1,154 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Compares positional page I/O of BlobFile with the shared std::fstream it replaced. The
+ * stream path is the old one: one stream for all users of the file, a latch around every
+ * seek plus read or write, and a flush after each write. Every thread reads or writes 8 KB
+ * pages at random positions of a file that sits in the kernel page cache, so the time is
+ * spent in the I/O layers rather than on the disk. Printed per run: operations per second
+ * over all threads.
+ *
+ * Usage: ./file_io_bench [ops per thread] [pages]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bench_util.h"
+#include "file.h"
+
+using namespace badgerdb;
+
+const std::string benchFileName = "bench_file_io.db";
+
+/**
+ * The fstream path: what File did with the shared stream before it used descriptors.
+ */
+struct StreamFile
+{
+	std::fstream stream;
+	std::mutex latch;
+
+	StreamFile(const std::string& name)
+		: stream(name, std::fstream::in | std::fstream::out | std::fstream::binary) {}
+
+	// the bench file is new, so the header has the first page slot to itself
+	static std::streampos position(const PageId pageNo)
+	{
+		return static_cast<std::streampos>(pageNo) * Page::SIZE;
+	}
+
+	void readPage(const PageId pageNo, Page& page)
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		stream.seekg(position(pageNo), std::ios::beg);
+		stream.read(reinterpret_cast<char*>(&page), Page::SIZE);
+	}
+
+	void writePage(const PageId pageNo, const Page& page)
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		stream.seekp(position(pageNo), std::ios::beg);
+		stream.write(reinterpret_cast<const char*>(&page), Page::SIZE);
+		stream.flush();
+	}
+};
+
+/**
+ * BlobFile::readPage() returns a page; read in place like the buffer pool does.
+ */
+struct DescriptorFile
+{
+	BlobFile file;
+
+	DescriptorFile(const std::string& name) : file(BlobFile::open(name)) {}
+
+	void readPage(const PageId pageNo, Page& page) { file.readPageInto(pageNo, page); }
+	void writePage(const PageId pageNo, const Page& page) { file.writePage(pageNo, page); }
+};
+
+/**
+ * Runs ops random reads or writes on each of the threads and returns operations per second.
+ */
+template <class FileType>
+double run(FileType* file, const int numPages, const int threads, const int ops, const bool writes)
+{
+	std::vector<std::thread> workers;
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int t = 0; t < threads; t++)
+	{
+		workers.push_back(std::thread([=]() {
+			std::mt19937 rng(17 + t);
+			std::uniform_int_distribution<PageId> pick(1, numPages);
+			Page page;
+			page.insertRecord("written by the bench");
+			for (int i = 0; i < ops; i++)
+			{
+				if (writes)
+					file->writePage(pick(rng), page);
+				else
+					file->readPage(pick(rng), page);
+			}
+		}));
+	}
+	for (std::size_t t = 0; t < workers.size(); t++)
+		workers[t].join();
+	return threads * ops / secondsSince(start);
+}
+
+int main(int argc, char **argv)
+{
+	int ops = 100000;
+	int numPages = 10000;
+	if (argc > 1)
+		ops = atoi(argv[1]);
+	if (argc > 2)
+		numPages = atoi(argv[2]);
+
+	removeIfPresent(benchFileName);
+
+	{
+		BlobFile file = BlobFile::create(benchFileName);
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			Page page = file.allocatePage(pageNo);
+			page.insertRecord("page " + std::to_string(pageNo));
+			file.writePage(pageNo, page);
+		}
+	}
+
+	std::printf("pages:%d ops/thread:%d page size:%zu\n", numPages, ops, Page::SIZE);
+	const int threadCounts[] = { 1, 4 };
+	for (std::size_t i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); i++)
+	{
+		const int threads = threadCounts[i];
+		for (int writes = 0; writes < 2; writes++)
+		{
+			StreamFile* stream = new StreamFile(benchFileName);
+			const double streamOps = run(stream, numPages, threads, ops, writes);
+			delete stream;
+
+			DescriptorFile* fd = new DescriptorFile(benchFileName);
+			const double fdOps = run(fd, numPages, threads, ops, writes);
+			delete fd;
+
+			std::printf("threads:%d %-6s  fstream:%10.0f ops/s  pread/pwrite:%10.0f ops/s  (%.2fx)\n",
+				threads, writes ? "writes" : "reads", streamOps, fdOps, fdOps / streamOps);
+		}
+	}
+
+	File::remove(benchFileName);
+	return 0;
+}
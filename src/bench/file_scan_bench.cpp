@@ -0,0 +1,104 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Counts the reads behind a FileScan, as /proc/self/io reports them. A PageFile of record
+ * pages is walked with a bare FileIterator, which now takes the next page number from the
+ * page directory instead of reading the page header, and then scanned through a pool much
+ * smaller than the file, with and without read-ahead. Each page should cost the scan one
+ * read, whether it is the pool or the prefetch workers doing it. Printed per run: time and
+ * read calls per page, and the pages the pool read.
+ *
+ * Usage: ./file_scan_bench [pages] [frames]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "bench_util.h"
+#include "buffer.h"
+#include "file.h"
+#include "file_iterator.h"
+#include "filescan.h"
+#include "exceptions/end_of_file_exception.h"
+
+using namespace badgerdb;
+
+const std::string benchFileName = "bench_file_scan.db";
+
+void scan(PageFile* file, const std::uint32_t frames, const std::uint32_t readAhead, const int numPages)
+{
+	BufMgr* bufMgr = new BufMgr(frames);
+	long records = 0;
+	const long before = readCalls();
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	{
+		FileScan fileScan(file, bufMgr);
+		fileScan.setReadAhead(readAhead);
+		try
+		{
+			RecordId rid;
+			while (true)
+			{
+				fileScan.scanNext(rid);
+				records++;
+			}
+		}
+		catch(EndOfFileException &e)
+		{
+		}
+	}
+	const double seconds = secondsSince(start);
+	const BufStats& stats = bufMgr->getBufStats();
+	std::printf("scan, read-ahead %2u       %8.1f ns/page  reads/page:%5.2f  pool reads:%7d"
+		"  prefetched:%7d  records:%ld\n", readAhead, 1e9 * seconds / numPages,
+		(double) (readCalls() - before) / numPages, stats.diskreads.load(), stats.prefetchReads.load(), records);
+	delete bufMgr;
+}
+
+int main(int argc, char **argv)
+{
+	int numPages = 20000;
+	std::uint32_t frames = 100;
+	if (argc > 1)
+		numPages = atoi(argv[1]);
+	if (argc > 2)
+		frames = atoi(argv[2]);
+
+	removeIfPresent(benchFileName);
+
+	{
+		PageFile file = PageFile::create(benchFileName);
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			Page page = file.allocatePage(pageNo);
+			while (page.hasSpaceForRecord("row of a table being scanned, a hundred bytes or so"))
+				page.insertRecord("row of a table being scanned, a hundred bytes or so");
+			file.writePage(pageNo, page);
+		}
+	}
+
+	std::printf("pages:%d frames:%u\n", numPages, frames);
+	{
+		PageFile file = PageFile::open(benchFileName);
+		const long before = readCalls();
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		int walked = 0;
+		for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+			walked++;
+		std::printf("FileIterator walk          %8.1f ns/page  reads/page:%5.2f  pages:%d\n",
+			1e9 * secondsSince(start) / walked, (double) (readCalls() - before) / walked, walked);
+
+		scan(&file, frames, 0, numPages);
+		scan(&file, frames, FileScan::DEFAULT_READ_AHEAD, numPages);
+	}
+
+	File::remove(benchFileName);
+	return 0;
+}
@@ -0,0 +1,110 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Times BufMgr::flushFile. First a small file is dirtied and flushed over and over while
+ * a large file fills the rest of the pool, which shows what closing a small index costs in
+ * a big pool. Then every page of the large file is dirtied in random order and the whole
+ * file is flushed, which shows how well the dirty pages are written back in file order.
+ *
+ * Usage: ./flush_bench [frames] [smallFlushes]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include "bench_util.h"
+#include "buffer.h"
+#include "file.h"
+
+using namespace badgerdb;
+
+const std::string largeFileName = "bench_flush_large.db";
+const std::string smallFileName = "bench_flush_small.db";
+const int smallPages = 4;
+
+void fill(const std::string& name, const std::uint32_t pages)
+{
+	BlobFile file = BlobFile::create(name);
+	for (std::uint32_t i = 0; i < pages; i++)
+	{
+		PageId pageNo;
+		file.allocatePage(pageNo);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	std::uint32_t frames = 20000;
+	int smallFlushes = 1000;
+	if (argc > 1)
+		frames = atoi(argv[1]);
+	if (argc > 2)
+		smallFlushes = atoi(argv[2]);
+	const std::uint32_t largePages = frames - smallPages;
+
+	removeIfPresent(largeFileName);
+	removeIfPresent(smallFileName);
+	fill(largeFileName, largePages);
+	fill(smallFileName, smallPages);
+
+	{
+		BlobFile large = BlobFile::open(largeFileName);
+		BlobFile small = BlobFile::open(smallFileName);
+		BufMgr* bufMgr = new BufMgr(frames);
+
+		// pin the large file in random order, so frame order says nothing about page order
+		std::vector<PageId> order;
+		for (PageId pageNo = 1; pageNo <= largePages; pageNo++)
+			order.push_back(pageNo);
+		std::shuffle(order.begin(), order.end(), std::mt19937(7));
+		for (std::size_t i = 0; i < order.size(); i++)
+		{
+			Page* page;
+			bufMgr->readPage(&large, order[i], page);
+			bufMgr->unPinPage(&large, order[i], false);
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int round = 0; round < smallFlushes; round++)
+		{
+			for (PageId pageNo = 1; pageNo <= smallPages; pageNo++)
+			{
+				Page* page;
+				bufMgr->readPage(&small, pageNo, page);
+				bufMgr->unPinPage(&small, pageNo, true);
+			}
+			bufMgr->flushFile(&small);
+		}
+		const double smallSeconds = secondsSince(start);
+		std::printf("frames:%u  flush of a %d page file: %8.1f us\n",
+			frames, smallPages, smallSeconds * 1e6 / smallFlushes);
+
+		for (std::size_t i = 0; i < order.size(); i++)
+		{
+			Page* page;
+			bufMgr->readPage(&large, order[i], page);
+			bufMgr->unPinPage(&large, order[i], true);
+		}
+		start = std::chrono::steady_clock::now();
+		bufMgr->flushFile(&large);
+		const double largeSeconds = secondsSince(start);
+		std::printf("frames:%u  flush of %u dirty pages:  %8.1f ms  %7.1f MB/s\n",
+			frames, largePages, largeSeconds * 1e3,
+			largePages * (double) Page::SIZE / (1 << 20) / largeSeconds);
+
+		delete bufMgr;
+	}
+
+	File::remove(largeFileName);
+	File::remove(smallFileName);
+	return 0;
+}
@@ -0,0 +1,188 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Microbenchmark comparing the open-addressing BufHashTbl with the chained hash table it
+ * replaced. Both tables are filled with numBufs entries spread over a few files, then
+ * timed on lookups that hit and on lookups that miss (the miss path of both throws
+ * HashNotFoundException, exactly as BufMgr::readPage sees it).
+ *
+ * Usage: ./hash_table_bench [numBufs] [lookups]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <vector>
+#include "bench_util.h"
+#include "bufHashTbl.h"
+#include "file.h"
+#include "exceptions/hash_not_found_exception.h"
+
+using namespace badgerdb;
+
+/**
+ * The chained table BufHashTbl used to be: one heap-allocated bucket per entry and
+ * (pointer + pageNo) % HTSIZE as the hash.
+ */
+class ChainedHashTbl
+{
+ private:
+	struct hashBucket {
+		File *file;
+		PageId pageNo;
+		FrameId frameNo;
+		hashBucket*   next;
+	};
+
+	int HTSIZE;
+	hashBucket**  ht;
+
+	int hash(const File* file, const PageId pageNo)
+	{
+		unsigned long tmp = (unsigned long)file;
+		return (int)((tmp + pageNo) % HTSIZE);
+	}
+
+ public:
+	ChainedHashTbl(int htSize)
+		: HTSIZE(htSize)
+	{
+		ht = new hashBucket* [htSize];
+		for(int i=0; i < HTSIZE; i++)
+			ht[i] = NULL;
+	}
+
+	~ChainedHashTbl()
+	{
+		for(int i = 0; i < HTSIZE; i++) {
+			while (ht[i]) {
+				hashBucket* tmpBuf = ht[i];
+				ht[i] = ht[i]->next;
+				delete tmpBuf;
+			}
+		}
+		delete [] ht;
+	}
+
+	void insert(const File* file, const PageId pageNo, const FrameId frameNo)
+	{
+		int index = hash(file, pageNo);
+		hashBucket* tmpBuc = new hashBucket;
+		tmpBuc->file = (File*) file;
+		tmpBuc->pageNo = pageNo;
+		tmpBuc->frameNo = frameNo;
+		tmpBuc->next = ht[index];
+		ht[index] = tmpBuc;
+	}
+
+	void lookup(const File* file, const PageId pageNo, FrameId &frameNo)
+	{
+		int index = hash(file, pageNo);
+		hashBucket* tmpBuc = ht[index];
+		while (tmpBuc) {
+			if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+			{
+				frameNo = tmpBuc->frameNo;
+				return;
+			}
+			tmpBuc = tmpBuc->next;
+		}
+		throw HashNotFoundException(file->filename(), pageNo);
+	}
+};
+
+const int numFiles = 4;
+
+struct Key {
+	File* file;
+	PageId pageNo;
+};
+
+template <class Table>
+double timeLookups(Table& table, const std::vector<Key>& keys, int lookups, bool expectHit)
+{
+	FrameId frameNo = 0;
+	unsigned long sink = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < lookups; i++)
+	{
+		const Key& key = keys[i % keys.size()];
+		try
+		{
+			table.lookup(key.file, key.pageNo, frameNo);
+			sink += frameNo;
+		}
+		catch(HashNotFoundException &e)
+		{
+			sink++;
+		}
+	}
+	const double ns = nsSince(start, lookups);
+	if (sink == 0 && expectHit)
+		std::printf("(no hits)\n");
+	return ns;
+}
+
+int main(int argc, char **argv)
+{
+	std::uint32_t numBufs = 100000;
+	int lookups = 2000000;
+	if (argc > 1)
+		numBufs = atoi(argv[1]);
+	if (argc > 2)
+		lookups = atoi(argv[2]);
+
+	std::vector<File*> files;
+	for (int f = 0; f < numFiles; f++)
+	{
+		std::ostringstream name;
+		name << "bench_hash_" << f << ".db";
+		removeIfPresent(name.str());
+		files.push_back(new PageFile(name.str(), true));
+	}
+
+	// resident keys: consecutive pages of each file, as a sequential load leaves them
+	std::vector<Key> present, absent;
+	for (std::uint32_t i = 0; i < numBufs; i++)
+	{
+		Key key = { files[i % numFiles], (PageId) (i / numFiles + 1) };
+		present.push_back(key);
+		Key miss = { files[i % numFiles], (PageId) (i / numFiles + 1 + numBufs) };
+		absent.push_back(miss);
+	}
+	std::mt19937 rng(7);
+	std::shuffle(present.begin(), present.end(), rng);
+	std::shuffle(absent.begin(), absent.end(), rng);
+
+	ChainedHashTbl chained(((((int) (numBufs * 1.2))*2)/2)+1);
+	BufHashTbl flat(numBufs);
+	for (std::uint32_t i = 0; i < numBufs; i++)
+	{
+		chained.insert(present[i].file, present[i].pageNo, i);
+		flat.insert(present[i].file, present[i].pageNo, i);
+	}
+
+	// misses throw, so time fewer of them
+	int missLookups = lookups / 20;
+	std::printf("entries:%u\n", numBufs);
+	std::printf("%-10s hit:%8.1f ns  miss:%8.1f ns\n", "chained",
+		timeLookups(chained, present, lookups, true), timeLookups(chained, absent, missLookups, false));
+	std::printf("%-10s hit:%8.1f ns  miss:%8.1f ns\n", "flat",
+		timeLookups(flat, present, lookups, true), timeLookups(flat, absent, missLookups, false));
+
+	for (int f = 0; f < numFiles; f++)
+	{
+		std::string name = files[f]->filename();
+		delete files[f];
+		File::remove(name);
+	}
+	return 0;
+}
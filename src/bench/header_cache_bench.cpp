@@ -0,0 +1,117 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Counts the system calls behind page allocation and page reads, as /proc/self/io reports
+ * them, now that the file header is cached. Pages are allocated in a BlobFile with the
+ * header written back after every change, as before the cache, and with the default of
+ * writing it back on close only. Then random pages of a PageFile are read, which used to
+ * cost a header read for the bounds check on top of the page. Printed per run: time and
+ * read and write calls per operation.
+ *
+ * Usage: ./header_cache_bench [allocations] [reads]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include "bench_util.h"
+#include "file.h"
+
+using namespace badgerdb;
+
+const std::string blobFileName = "bench_header_blob.db";
+const std::string pageFileName = "bench_header_page.db";
+
+/**
+ * Read and write system calls of this process so far.
+ */
+struct IoCalls
+{
+	long reads;
+	long writes;
+
+	IoCalls() : reads(0), writes(0)
+	{
+		FILE* io = fopen("/proc/self/io", "r");
+		char line[256];
+		while (io != NULL && fgets(line, sizeof(line), io) != NULL)
+		{
+			if (strncmp(line, "syscr:", 6) == 0)
+				reads = atol(line + 6);
+			else if (strncmp(line, "syscw:", 6) == 0)
+				writes = atol(line + 6);
+		}
+		if (io != NULL)
+			fclose(io);
+	}
+};
+
+void report(const char* name, const std::chrono::steady_clock::time_point start, const IoCalls& before, const int ops)
+{
+	const double ns = nsSince(start, ops);
+	const IoCalls after;
+	std::printf("%-30s %8.1f ns/op  reads/op:%5.2f  writes/op:%5.2f\n", name, ns,
+		(double) (after.reads - before.reads) / ops, (double) (after.writes - before.writes) / ops);
+}
+
+void allocate(const std::uint32_t interval, const char* name, const int allocations)
+{
+	removeIfPresent(blobFileName);
+	BlobFile file = BlobFile::create(blobFileName);
+	file.setHeaderWriteInterval(interval);
+	const IoCalls before;
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < allocations; i++)
+	{
+		PageId pageNo;
+		file.allocatePage(pageNo);
+	}
+	report(name, start, before, allocations);
+}
+
+int main(int argc, char **argv)
+{
+	int allocations = 100000;
+	int reads = 100000;
+	if (argc > 1)
+		allocations = atoi(argv[1]);
+	if (argc > 2)
+		reads = atoi(argv[2]);
+	const int filePages = 2000;
+
+	std::printf("allocations:%d reads:%d\n", allocations, reads);
+	allocate(1, "allocate, header every change", allocations);
+	allocate(0, "allocate, header on close", allocations);
+	File::remove(blobFileName);
+
+	removeIfPresent(pageFileName);
+	{
+		PageFile file = PageFile::create(pageFileName);
+		for (int i = 0; i < filePages; i++)
+		{
+			PageId pageNo;
+			file.allocatePage(pageNo);
+		}
+	}
+	{
+		PageFile file = PageFile::open(pageFileName);
+		std::mt19937 rng(3);
+		std::uniform_int_distribution<PageId> pick(1, filePages);
+		Page page;
+		const IoCalls before;
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < reads; i++)
+			file.readPageInto(pick(rng), page);
+		report("PageFile random read", start, before, reads);
+	}
+	File::remove(pageFileName);
+	return 0;
+}
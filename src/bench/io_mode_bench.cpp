@@ -0,0 +1,122 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Compares buffered and O_DIRECT page I/O, and normal against huge-page pool memory. Each
+ * run starts with the file dropped from the page cache, then pins random pages of a file
+ * twice the size of the pool. Printed per run: throughput, the resident set of the process
+ * and how much of the file the kernel page cache holds on top of it.
+ *
+ * Usage: ./io_mode_bench [ops] [frames]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <random>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+#include "bench_util.h"
+#include "buffer.h"
+#include "file.h"
+
+using namespace badgerdb;
+
+const std::string benchFileName = "bench_io_mode.db";
+
+/**
+ * Bytes of the file currently held in the kernel page cache, in kB.
+ */
+long pageCacheKb()
+{
+	int fd = open(benchFileName.c_str(), O_RDONLY);
+	off_t length = lseek(fd, 0, SEEK_END);
+	void* map = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+	const long osPage = sysconf(_SC_PAGESIZE);
+	std::vector<unsigned char> resident((length + osPage - 1) / osPage);
+	long kb = 0;
+	if (map != MAP_FAILED && mincore(map, length, &resident[0]) == 0)
+	{
+		for (std::size_t i = 0; i < resident.size(); i++)
+			if (resident[i] & 1)
+				kb += osPage / 1024;
+	}
+	if (map != MAP_FAILED)
+		munmap(map, length);
+	close(fd);
+	return kb;
+}
+
+void dropPageCache()
+{
+	int fd = open(benchFileName.c_str(), O_RDONLY);
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+}
+
+void run(FileIoMode mode, PoolMemory memory, std::uint32_t frames, int numPages, int ops)
+{
+	dropPageCache();
+	PageFile file(benchFileName, false, mode);
+	BufMgr* bufMgr = new BufMgr(frames, CLOCK, memory);
+
+	std::mt19937 rng(3);
+	std::uniform_int_distribution<PageId> pick(1, numPages);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ops; i++)
+	{
+		PageId pageNo = pick(rng);
+		Page* page;
+		bufMgr->readPage(&file, pageNo, page);
+		bufMgr->unPinPage(&file, pageNo, false);
+	}
+	double secs = secondsSince(start);
+
+	const char* memoryName = bufMgr->getPoolMemory() == POOL_DEFAULT ? "normal" :
+		(bufMgr->getPoolMemory() == POOL_TRANSPARENT_HUGE ? "thp" : "hugetlb");
+	std::printf("io:%-8s pool:%-7s ops/sec:%10.0f  diskreads:%7d  rss:%7ld kB  page cache:%7ld kB\n",
+		file.isDirect() ? "direct" : "buffered", memoryName, ops / secs,
+		(int) bufMgr->getBufStats().diskreads, residentKb(), pageCacheKb());
+
+	delete bufMgr;
+}
+
+int main(int argc, char **argv)
+{
+	int ops = 100000;
+	std::uint32_t frames = 4096;
+	if (argc > 1)
+		ops = atoi(argv[1]);
+	if (argc > 2)
+		frames = atoi(argv[2]);
+	const int numPages = 2 * frames;
+
+	removeIfPresent(benchFileName);
+
+	{
+		PageFile file = PageFile::create(benchFileName);
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			file.allocatePage(pageNo);
+		}
+	}
+
+	std::printf("pages:%d frames:%u ops:%d\n", numPages, frames, ops);
+	run(BUFFERED_IO, POOL_DEFAULT, frames, numPages, ops);
+	run(DIRECT_IO, POOL_DEFAULT, frames, numPages, ops);
+	run(BUFFERED_IO, POOL_TRANSPARENT_HUGE, frames, numPages, ops);
+	run(DIRECT_IO, POOL_TRANSPARENT_HUGE, frames, numPages, ops);
+
+	File::remove(benchFileName);
+	return 0;
+}
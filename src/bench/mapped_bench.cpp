@@ -0,0 +1,129 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Compares the copying buffer pool with the read-only mapped one on a file sitting in the
+ * kernel page cache. The scan reads every page in order and adds up all its words; the
+ * probe reads random pages and looks at their first record, like B+tree lookups. The pool
+ * holds a quarter of the file, so the copying pool misses on most pages. The mapped manager
+ * is told the access pattern with advise(). Printed per run: time per page and the resident
+ * set of the process.
+ *
+ * Usage: ./mapped_bench [pages] [probes]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include "bench_util.h"
+#include "buffer.h"
+#include "file.h"
+#include "mapped_buffer.h"
+#include "page_iterator.h"
+
+using namespace badgerdb;
+
+const std::string benchFileName = "bench_mapped.db";
+
+/**
+ * Reads every page in order and adds up its words.
+ */
+template <class Manager>
+std::size_t scan(Manager* mgr, File* file, const int numPages)
+{
+	std::size_t sum = 0;
+	for (PageId pageNo = 1; pageNo <= (PageId) numPages; pageNo++)
+	{
+		Page* page;
+		mgr->readPage(file, pageNo, page);
+		const std::uint64_t* words = reinterpret_cast<const std::uint64_t*>(page);
+		for (std::size_t i = 0; i < Page::SIZE / sizeof(std::uint64_t); i++)
+			sum += words[i];
+		mgr->unPinPage(file, pageNo, false);
+	}
+	return sum;
+}
+
+/**
+ * Reads random pages and the first record of each.
+ */
+template <class Manager>
+std::size_t probe(Manager* mgr, File* file, const int numPages, const int probes)
+{
+	std::mt19937 rng(5);
+	std::uniform_int_distribution<PageId> pick(1, numPages);
+	std::size_t bytes = 0;
+	for (int i = 0; i < probes; i++)
+	{
+		const PageId pageNo = pick(rng);
+		Page* page;
+		mgr->readPage(file, pageNo, page);
+		bytes += (*page->begin()).size();
+		mgr->unPinPage(file, pageNo, false);
+	}
+	return bytes;
+}
+
+int main(int argc, char **argv)
+{
+	int numPages = 20000;
+	int probes = 200000;
+	if (argc > 1)
+		numPages = atoi(argv[1]);
+	if (argc > 2)
+		probes = atoi(argv[2]);
+
+	removeIfPresent(benchFileName);
+
+	{
+		BlobFile file = BlobFile::create(benchFileName);
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			Page page = file.allocatePage(pageNo);
+			while (page.hasSpaceForRecord("record of a hundred bytes or so, as a row of a table might be"
+			                              " in a small analytic replica"))
+				page.insertRecord("record of a hundred bytes or so, as a row of a table might be"
+				                  " in a small analytic replica");
+			file.writePage(pageNo, page);
+		}
+	}
+
+	{
+		BlobFile file = BlobFile::open(benchFileName);
+		std::printf("pages:%d probes:%d\n", numPages, probes);
+
+		BufMgr* bufMgr = new BufMgr(numPages / 4);
+		scan(bufMgr, &file, numPages);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::size_t bytes = scan(bufMgr, &file, numPages);
+		std::printf("copying  scan: %8.1f ns/page", nsSince(start, numPages));
+		start = std::chrono::steady_clock::now();
+		bytes += probe(bufMgr, &file, numPages, probes);
+		std::printf("  probe: %8.1f ns/page  rss:%7ld kB  (checksum %zx)\n", nsSince(start, probes), residentKb(), bytes);
+		bufMgr->flushFile(&file);
+		delete bufMgr;
+
+		MappedBufMgr* mapped = new MappedBufMgr();
+		mapped->advise(&file, MAP_ADVICE_SEQUENTIAL);
+		scan(mapped, &file, numPages);
+		start = std::chrono::steady_clock::now();
+		bytes = scan(mapped, &file, numPages);
+		std::printf("mapped   scan: %8.1f ns/page", nsSince(start, numPages));
+		mapped->advise(&file, MAP_ADVICE_RANDOM);
+		start = std::chrono::steady_clock::now();
+		bytes += probe(mapped, &file, numPages, probes);
+		std::printf("  probe: %8.1f ns/page  rss:%7ld kB  (checksum %zx)\n", nsSince(start, probes), residentKb(), bytes);
+		mapped->flushFile(&file);
+		delete mapped;
+	}
+
+	File::remove(benchFileName);
+	return 0;
+}
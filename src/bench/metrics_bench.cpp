@@ -0,0 +1,137 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Exercises the buffer pool metrics. Several threads pin random pages of two files of
+ * different sizes, dirtying some, while the metrics are exported in Prometheus format on
+ * an interval, then again with the metrics switched off; a warm-up run comes first.
+ * Printed: throughput with and without metrics, how long a snapshot takes, the size of
+ * the exported file and the final metrics as JSON.
+ *
+ * Usage: ./metrics_bench [threads] [opsPerThread]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bench_util.h"
+#include "buffer.h"
+#include "file.h"
+
+using namespace badgerdb;
+
+const std::string hotFileName = "bench_metrics_hot.db";
+const std::string coldFileName = "bench_metrics_cold.db";
+const std::string exportFileName = "bench_metrics.prom";
+const int hotPages = 200;
+const int coldPages = 2000;
+const std::uint32_t numFrames = 500;
+
+void worker(BufMgr* bufMgr, File* hot, File* cold, std::uint32_t seed, int ops)
+{
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<PageId> pickHot(1, hotPages);
+	std::uniform_int_distribution<PageId> pickCold(1, coldPages);
+	std::uniform_int_distribution<int> percent(0, 99);
+
+	for (int i = 0; i < ops; i++)
+	{
+		// four accesses out of five go to the small file
+		File* file = percent(rng) < 80 ? hot : cold;
+		PageId pageNo = file == hot ? pickHot(rng) : pickCold(rng);
+		Page* page;
+		bufMgr->readPage(file, pageNo, page);
+		bufMgr->unPinPage(file, pageNo, percent(rng) < 20);
+	}
+}
+
+void createFile(const std::string& name, const int pages)
+{
+	removeIfPresent(name);
+	PageFile file = PageFile::create(name);
+	for (int i = 0; i < pages; i++)
+	{
+		PageId pageNo;
+		file.allocatePage(pageNo);
+	}
+}
+
+/**
+ * Runs the workers to completion and returns the operations per second.
+ */
+double run(BufMgr* bufMgr, File* hot, File* cold, const int threads, const int opsPerThread)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::thread> pool;
+	for (int t = 0; t < threads; t++)
+		pool.push_back(std::thread(worker, bufMgr, hot, cold, 29 + t, opsPerThread));
+	for (int t = 0; t < threads; t++)
+		pool[t].join();
+	return threads * (double) opsPerThread / secondsSince(start);
+}
+
+int main(int argc, char **argv)
+{
+	int threads = 4;
+	int opsPerThread = 100000;
+	if (argc > 1)
+		threads = atoi(argv[1]);
+	if (argc > 2)
+		opsPerThread = atoi(argv[2]);
+
+	createFile(hotFileName, hotPages);
+	createFile(coldFileName, coldPages);
+
+	{
+		PageFile hot = PageFile::open(hotFileName);
+		PageFile cold = PageFile::open(coldFileName);
+		BufMgr* bufMgr = new BufMgr(numFrames);
+
+		// warm the pool first, so both measured runs start from the same working set
+		bufMgr->setMetricsEnabled(false);
+		run(bufMgr, &hot, &cold, threads, opsPerThread);
+		bufMgr->setMetricsEnabled(true);
+
+		bufMgr->startMetricsExport(exportFileName, METRICS_PROMETHEUS, std::chrono::milliseconds(100));
+
+		const double opsOn = run(bufMgr, &hot, &cold, threads, opsPerThread);
+		bufMgr->stopMetricsExport();
+
+		const int snapshots = 100;
+		BufMetricsSnapshot snapshot;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < snapshots; i++)
+			bufMgr->collectMetrics(snapshot);
+		double snapshotUs = nsSince(start, snapshots) / 1000;
+
+		bufMgr->setMetricsEnabled(false);
+		const double opsOff = run(bufMgr, &hot, &cold, threads, opsPerThread);
+		bufMgr->setMetricsEnabled(true);
+
+		std::ifstream exported(exportFileName.c_str());
+		int lines = 0;
+		std::string line;
+		while (std::getline(exported, line))
+			lines++;
+
+		std::printf("threads:%d ops/sec metrics on:%.0f off:%.0f (%.1f%% overhead) snapshot:%.1f us exported lines:%d\n",
+			threads, opsOn, opsOff, 100.0 * (opsOff - opsOn) / opsOff, snapshotUs, lines);
+		std::printf("%s", bufMgr->exportMetrics(METRICS_JSON).c_str());
+
+		delete bufMgr;
+	}
+
+	File::remove(hotFileName);
+	File::remove(coldFileName);
+	std::remove(exportFileName.c_str());
+	return 0;
+}
@@ -0,0 +1,139 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Measures what copying pages costs on the miss path. A file sitting in the kernel page
+ * cache is read page by page into one destination page, first by value with readPage(),
+ * which builds a zeroed temporary and copies it over, then with readPageInto(), which reads
+ * into the destination directly. Next the same is done for allocatePage() against
+ * allocatePageInto(). Finally the latency of BufMgr misses is printed, every access a miss.
+ * Besides the time per call, each line shows the bytes zeroed and copied in memory on top
+ * of the transfer from the file.
+ *
+ * Usage: ./miss_copy_bench [ops]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "bench_util.h"
+#include "buffer.h"
+#include "file.h"
+
+using namespace badgerdb;
+
+const std::string benchFileName = "bench_miss_copy.db";
+const std::string allocFileName = "bench_miss_copy_alloc.db";
+const int numPages = 2000;
+const std::uint32_t numFrames = 500;
+
+/**
+ * Bytes a by-value read or allocation moves on top of the file transfer: the temporary
+ * is zeroed by the Page constructor and then copied into the destination.
+ */
+const std::size_t copiedByValue = Page::DATA_SIZE + Page::SIZE;
+
+void fileReads(BlobFile& file, const int ops)
+{
+	// the two ways take turns, a pass over the file at a time, so neither gets a warmer cache
+	Page* frame = new Page();
+	double byValue = 0;
+	double inPlace = 0;
+	for (int done = 0; done < ops; done += numPages)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < numPages; i++)
+			*frame = file.readPage(1 + i);
+		byValue += nsSince(start, 1);
+
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < numPages; i++)
+			file.readPageInto(1 + i, *frame);
+		inPlace += nsSince(start, 1);
+	}
+	const int passes = (ops + numPages - 1) / numPages;
+	byValue /= passes * numPages;
+	inPlace /= passes * numPages;
+	delete frame;
+
+	std::printf("read      readPage:%9.1f ns  %5zu B moved   readPageInto:%9.1f ns  %zu B moved\n",
+		byValue, copiedByValue, inPlace, (std::size_t) 0);
+}
+
+void fileAllocations(const int ops)
+{
+	Page* frame = new Page();
+	removeIfPresent(allocFileName);
+	BlobFile* file = new BlobFile(allocFileName, true);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ops; i++)
+	{
+		PageId pageNo;
+		*frame = file->allocatePage(pageNo);
+	}
+	const double byValue = nsSince(start, ops);
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ops; i++)
+	{
+		PageId pageNo;
+		file->allocatePageInto(pageNo, *frame);
+	}
+	const double inPlace = nsSince(start, ops);
+	delete file;
+	delete frame;
+	File::remove(allocFileName);
+
+	// allocatePageInto() still zeroes the new page, but nothing is copied
+	std::printf("allocate  allocatePage:%5.1f ns  %5zu B moved   allocatePageInto:%5.1f ns  %zu B moved\n",
+		byValue, copiedByValue, inPlace, (std::size_t) Page::DATA_SIZE);
+}
+
+void bufferMisses(BlobFile& file, const int ops)
+{
+	BufMgr* bufMgr = new BufMgr(numFrames);
+	// a stride through a file four times the pool size makes every access a miss
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ops; i++)
+	{
+		const PageId pageNo = 1 + i % numPages;
+		Page* page;
+		bufMgr->readPage(&file, pageNo, page);
+		bufMgr->unPinPage(&file, pageNo, false);
+	}
+	const double perMiss = nsSince(start, ops);
+	const BufStats& stats = bufMgr->getBufStats();
+	std::printf("BufMgr    miss:%13.1f ns  (%d misses of %d reads)\n", perMiss, stats.misses.load(), ops);
+	delete bufMgr;
+}
+
+int main(int argc, char **argv)
+{
+	int ops = 200000;
+	if (argc > 1)
+		ops = atoi(argv[1]);
+
+	removeIfPresent(benchFileName);
+	{
+		BlobFile file = BlobFile::create(benchFileName);
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			file.allocatePage(pageNo);
+		}
+	}
+
+	{
+		BlobFile file = BlobFile::open(benchFileName);
+		fileReads(file, ops);
+		fileAllocations(ops / 10);
+		bufferMisses(file, ops);
+	}
+
+	File::remove(benchFileName);
+	return 0;
+}
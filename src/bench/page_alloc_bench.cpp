@@ -0,0 +1,127 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Measures page allocation and deletion in a PageFile as the file grows. Each size is
+ * loaded into an empty file and timed over its first and last tenth; with the tail of the
+ * used list and the free pages kept in the page directory both should cost the same, where
+ * walking the used list made every allocation slower than the one before. Then pages
+ * spread over the file are deleted and allocated again. Last, a file is written in the
+ * format without map pages and opened: the first allocation rebuilds the directory from
+ * the used list, the ones after it don't. Printed per run: microseconds per operation.
+ *
+ * Usage: ./page_alloc_bench [largest file in pages]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include "bench_util.h"
+#include "file.h"
+
+using namespace badgerdb;
+
+const std::string benchFileName = "bench_page_alloc.db";
+
+void load(const int numPages)
+{
+	removeIfPresent(benchFileName);
+	PageFile file = PageFile::create(benchFileName);
+	const int tenth = numPages / 10 > 0 ? numPages / 10 : 1;
+	double firstTenth = 0, lastTenth = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < numPages; i++)
+	{
+		PageId pageNo;
+		file.allocatePage(pageNo);
+		if (i + 1 == tenth)
+			firstTenth = 1e6 * secondsSince(start);
+		if (i == numPages - tenth)
+			start = std::chrono::steady_clock::now();
+	}
+	lastTenth = 1e6 * secondsSince(start);
+
+	// every hundredth page, so each reuse lands in the middle of the used list
+	const int deleted = numPages / 100;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < deleted; i++)
+		file.deletePage(1 + 100 * i);
+	const double deleteTime = 1e6 * secondsSince(start);
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < deleted; i++)
+	{
+		PageId pageNo;
+		file.allocatePage(pageNo);
+	}
+	const double reuseTime = 1e6 * secondsSince(start);
+
+	std::printf("pages:%8d  allocate first tenth:%6.2f us  last tenth:%6.2f us"
+		"  delete:%6.2f us  reuse free page:%6.2f us\n", numPages, firstTenth / tenth, lastTenth / tenth,
+		deleted > 0 ? deleteTime / deleted : 0.0, deleted > 0 ? reuseTime / deleted : 0.0);
+}
+
+/**
+ * Writes a file of used pages the way PageFile did before map pages: the header, then pages
+ * linked in order, with an empty free list.
+ */
+void writeListFile(const int numPages)
+{
+	removeIfPresent(benchFileName);
+	const int fd = ::open(benchFileName.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+	const FileHeader header = {static_cast<PageId>(numPages + 1), 1 /* first_used_page */,
+	                           0 /* num_free_pages */, 0 /* first_free_page */};
+	if (pwrite(fd, &header, sizeof(header), 0) != sizeof(header))
+		std::perror("pwrite");
+	char buffer[Page::SIZE];
+	std::memset(buffer, 0, sizeof(buffer));
+	for (int i = 1; i <= numPages; i++)
+	{
+		const PageHeader pageHeader = {0 /* free_space_lower_bound */,
+		                               static_cast<std::uint16_t>(Page::DATA_SIZE) /* free_space_upper_bound */,
+		                               0 /* num_slots */, 0 /* num_free_slots */, static_cast<PageId>(i),
+		                               i < numPages ? static_cast<PageId>(i + 1) : Page::INVALID_NUMBER};
+		std::memcpy(buffer, &pageHeader, sizeof(pageHeader));
+		if (pwrite(fd, buffer, Page::SIZE, sizeof(FileHeader) + static_cast<off_t>(i - 1) * Page::SIZE) != Page::SIZE)
+			std::perror("pwrite");
+	}
+	::close(fd);
+}
+
+void upgrade(const int numPages)
+{
+	writeListFile(numPages);
+	PageFile file = PageFile::open(benchFileName);
+	PageId pageNo;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	file.allocatePage(pageNo);
+	const double first = 1e6 * secondsSince(start);
+	const int more = 1000;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < more; i++)
+		file.allocatePage(pageNo);
+	const double after = 1e6 * secondsSince(start);
+	std::printf("list file pages:%8d  first allocation:%10.2f us  after:%6.2f us\n",
+		numPages, first, after / more);
+}
+
+int main(int argc, char **argv)
+{
+	int largest = 100000;
+	if (argc > 1)
+		largest = atoi(argv[1]);
+
+	for (int numPages = 10000; numPages <= largest; numPages *= 10)
+		load(numPages);
+	for (int numPages = 10000; numPages <= largest; numPages *= 10)
+		upgrade(numPages);
+	File::remove(benchFileName);
+	return 0;
+}
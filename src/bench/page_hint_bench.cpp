@@ -0,0 +1,127 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Measures what PageHint does for an index sharing the pool with table scans. An index
+ * file holds a root, a level of inner nodes and leaves; every probe reads the root, one
+ * inner node and one leaf. Between batches of probes a scan reads the next stretch of a
+ * much larger heap file. Each replacement policy runs the same workload twice: without
+ * hints, and with the root and inner nodes pinned HINT_KEEP and the scanned pages
+ * HINT_EVICT_SOON. Printed per run: the hit ratio of the index probes and of all
+ * accesses, and the hint counters of BufStats.
+ *
+ * Usage: ./page_hint_bench [rounds] [frames]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include "bench_util.h"
+#include "buffer.h"
+#include "file.h"
+
+using namespace badgerdb;
+
+const std::string indexFileName = "bench_hint_index.db";
+const std::string heapFileName = "bench_hint_heap.db";
+
+void createFile(const std::string& name, const int numPages)
+{
+	removeIfPresent(name);
+	BlobFile file = BlobFile::create(name);
+	for (int i = 0; i < numPages; i++)
+	{
+		PageId pageNo;
+		Page page = file.allocatePage(pageNo);
+		page.insertRecord("page " + std::to_string(pageNo));
+		file.writePage(pageNo, page);
+	}
+}
+
+void run(const ReplacementPolicyType policy, const bool hints, const std::uint32_t frames,
+         const int innerPages, const int leafPages, const int heapPages, const int rounds)
+{
+	BlobFile index = BlobFile::open(indexFileName);
+	BlobFile heap = BlobFile::open(heapFileName);
+	BufMgr* bufMgr = new BufMgr(frames, policy);
+	const PageHint inner = hints ? HINT_KEEP : HINT_NORMAL;
+	const PageHint scanned = hints ? HINT_EVICT_SOON : HINT_NORMAL;
+
+	// page 1 is the root, then the inner nodes, then the leaves
+	std::mt19937 rng(11);
+	std::uniform_int_distribution<PageId> pickInner(2, innerPages + 1);
+	std::uniform_int_distribution<PageId> pickLeaf(innerPages + 2, innerPages + 1 + leafPages);
+	const int probesPerRound = 100;
+	const int scanPerRound = 500;
+	PageId nextHeapPage = 1;
+
+	long probeAccesses = 0, probeMisses = 0;
+	for (int round = 0; round < rounds; round++)
+	{
+		// the first tenth of the rounds warms the pool up
+		if (round == rounds / 10)
+		{
+			bufMgr->clearBufStats();
+			probeAccesses = probeMisses = 0;
+		}
+
+		const int missesBefore = bufMgr->getBufStats().misses;
+		for (int i = 0; i < probesPerRound; i++)
+		{
+			PageHandle root = bufMgr->pinPage(&index, 1, NULL, inner);
+			PageHandle node = bufMgr->pinPage(&index, pickInner(rng), NULL, inner);
+			PageHandle leaf = bufMgr->pinPage(&index, pickLeaf(rng));
+		}
+		probeAccesses += 3 * probesPerRound;
+		probeMisses += bufMgr->getBufStats().misses - missesBefore;
+
+		for (int i = 0; i < scanPerRound; i++)
+		{
+			PageHandle page = bufMgr->pinPage(&heap, nextHeapPage, NULL, scanned);
+			nextHeapPage = nextHeapPage % heapPages + 1;
+		}
+	}
+
+	const BufStats& stats = bufMgr->getBufStats();
+	std::printf("policy:%-7s hints:%-3s  index hits:%5.3f  all hits:%5.3f  kept hits:%7d"
+		"  evict-soon victims:%7d  kept evictions:%5d\n",
+		stats.policyName, hints ? "on" : "off", 1.0 - (double) probeMisses / probeAccesses,
+		stats.hitRatio(), stats.keptHits.load(), stats.evictSoonVictims.load(), stats.keptEvictions.load());
+	bufMgr->flushFile(&index);
+	bufMgr->flushFile(&heap);
+	delete bufMgr;
+}
+
+int main(int argc, char **argv)
+{
+	int rounds = 200;
+	std::uint32_t frames = 1000;
+	if (argc > 1)
+		rounds = atoi(argv[1]);
+	if (argc > 2)
+		frames = atoi(argv[2]);
+	const int innerPages = frames / 5;
+	const int leafPages = 2 * frames;
+	const int heapPages = 20 * frames;
+
+	createFile(indexFileName, 1 + innerPages + leafPages);
+	createFile(heapFileName, heapPages);
+	std::printf("frames:%u inner nodes:%d leaves:%d heap pages:%d rounds:%d\n",
+		frames, innerPages, leafPages, heapPages, rounds);
+
+	const ReplacementPolicyType policies[] = { CLOCK, GCLOCK, LRU_K, TWO_Q, ARC };
+	for (std::size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++)
+	{
+		run(policies[p], false, frames, innerPages, leafPages, heapPages, rounds);
+		run(policies[p], true, frames, innerPages, leafPages, heapPages, rounds);
+	}
+
+	File::remove(indexFileName);
+	File::remove(heapFileName);
+	return 0;
+}
@@ -0,0 +1,222 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Replays the workloads of main.cpp under every replacement policy and reports the hit
+ * ratio each one achieves. For each relation order (forward, backward, random) and key
+ * type (integer, double, string) a fresh buffer pool builds the B+ tree index, then runs
+ * the range scans of the main tests a few times, each round followed by a full FileScan of
+ * the relation so that scan-resistant policies can show the difference.
+ *
+ * Usage: ./replacement_policy_bench [frames] [rounds]
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "bench_util.h"
+#include "btree.h"
+#include "buffer.h"
+#include "filescan.h"
+#include "page.h"
+#include "exceptions/end_of_file_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+#include "exceptions/insufficient_space_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+
+using namespace badgerdb;
+
+typedef struct tuple {
+	int i;
+	double d;
+	char s[64];
+} RECORD;
+
+const std::string relationName = "bench_policy_rel";
+const int relationSize = 5000;
+
+struct Totals {
+	long accesses, hits, misses, diskreads, diskwrites;
+};
+
+/**
+ * Writes the relation straight to disk, the way main.cpp's createRelation* functions do.
+ * order: 0 forward, 1 backward, 2 random (with a fixed seed, so every policy sees the same file).
+ */
+PageFile* createRelation(int order)
+{
+	removeIfPresent(relationName);
+	PageFile* file = new PageFile(relationName, true);
+
+	std::vector<int> keys(relationSize);
+	for (int i = 0; i < relationSize; i++)
+		keys[i] = order == 1 ? relationSize - 1 - i : i;
+	if (order == 2)
+	{
+		std::mt19937 rng(1);
+		for (int i = relationSize - 1; i > 0; i--)
+			std::swap(keys[i], keys[rng() % (i + 1)]);
+	}
+
+	RECORD record;
+	memset(record.s, ' ', sizeof(record.s));
+	PageId pageNo;
+	Page page = file->allocatePage(pageNo);
+	for (int i = 0; i < relationSize; i++)
+	{
+		sprintf(record.s, "%05d string record", keys[i]);
+		record.i = keys[i];
+		record.d = keys[i];
+		std::string data(reinterpret_cast<char*>(&record), sizeof(record));
+		while (1)
+		{
+			try
+			{
+				page.insertRecord(data);
+				break;
+			}
+			catch(InsufficientSpaceException &e)
+			{
+				file->writePage(pageNo, page);
+				page = file->allocatePage(pageNo);
+			}
+		}
+	}
+	file->writePage(pageNo, page);
+	return file;
+}
+
+/**
+ * One range scan of the index, fetching every matching record from the relation.
+ */
+int rangeScan(BTreeIndex* index, BufMgr* bufMgr, PageFile* file, Datatype type,
+							int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+	double lowDouble = lowVal, highDouble = highVal;
+	char lowString[100], highString[100];
+	sprintf(lowString, "%05d string record", lowVal);
+	sprintf(highString, "%05d string record", highVal);
+
+	try
+	{
+		if (type == INTEGER)
+			index->startScan(&lowVal, lowOp, &highVal, highOp);
+		else if (type == DOUBLE)
+			index->startScan(&lowDouble, lowOp, &highDouble, highOp);
+		else
+			index->startScan(lowString, lowOp, highString, highOp);
+	}
+	catch(NoSuchKeyFoundException &e)
+	{
+		return 0;
+	}
+
+	int numResults = 0;
+	RecordId rid;
+	Page* page;
+	while (1)
+	{
+		try
+		{
+			index->scanNext(rid);
+		}
+		catch(IndexScanCompletedException &e)
+		{
+			break;
+		}
+		bufMgr->readPage(file, rid.page_number, page);
+		page->getRecord(rid);
+		bufMgr->unPinPage(file, rid.page_number, false);
+		numResults++;
+	}
+	index->endScan();
+	return numResults;
+}
+
+void fileScan(BufMgr* bufMgr)
+{
+	FileScan scan(relationName, bufMgr);
+	RecordId rid;
+	try
+	{
+		while (1)
+		{
+			scan.scanNext(rid);
+			scan.getRecord();
+		}
+	}
+	catch(EndOfFileException &e)
+	{
+	}
+}
+
+void runWorkload(ReplacementPolicyType policy, int order, Datatype type, std::uint32_t frames, int rounds, Totals& totals)
+{
+	PageFile* file = createRelation(order);
+	BufMgr* bufMgr = new BufMgr(frames, policy);
+
+	int offset = type == INTEGER ? offsetof(tuple, i) : (type == DOUBLE ? offsetof(tuple, d) : offsetof(tuple, s));
+	std::string indexName;
+	BTreeIndex* index = new BTreeIndex(relationName, indexName, bufMgr, offset, type);
+
+	for (int r = 0; r < rounds; r++)
+	{
+		rangeScan(index, bufMgr, file, type, 25, GT, 40, LT);
+		rangeScan(index, bufMgr, file, type, 20, GTE, 35, LTE);
+		rangeScan(index, bufMgr, file, type, -3, GT, 3, LT);
+		rangeScan(index, bufMgr, file, type, 996, GT, 1001, LT);
+		rangeScan(index, bufMgr, file, type, 0, GT, 1, LT);
+		rangeScan(index, bufMgr, file, type, 300, GT, 400, LT);
+		rangeScan(index, bufMgr, file, type, 3000, GTE, 4000, LT);
+		fileScan(bufMgr);
+	}
+
+	BufStats& stats = bufMgr->getBufStats();
+	totals.accesses += stats.accesses;
+	totals.hits += stats.hits;
+	totals.misses += stats.misses;
+	totals.diskreads += stats.diskreads;
+	totals.diskwrites += stats.diskwrites;
+
+	// the index writes its pages back through the pool, so it has to go first
+	delete index;
+	delete bufMgr;
+	delete file;
+	removeIfPresent(indexName);
+	removeIfPresent(relationName);
+}
+
+int main(int argc, char **argv)
+{
+	std::uint32_t frames = 100;
+	int rounds = 3;
+	if (argc > 1)
+		frames = atoi(argv[1]);
+	if (argc > 2)
+		rounds = atoi(argv[2]);
+
+	const ReplacementPolicyType policies[] = { CLOCK, GCLOCK, LRU_K, TWO_Q, ARC };
+	const Datatype types[] = { INTEGER, DOUBLE, STRING };
+
+	std::printf("frames:%u rounds:%d\n", frames, rounds);
+	for (int p = 0; p < 5; p++)
+	{
+		Totals totals = { 0, 0, 0, 0, 0 };
+		for (int order = 0; order < 3; order++)
+			for (int t = 0; t < 3; t++)
+				runWorkload(policies[p], order, types[t], frames, rounds, totals);
+
+		BufMgr probe(1, policies[p]);
+		std::printf("%-8s accesses:%9ld hits:%9ld misses:%8ld hit ratio:%6.2f%%  diskreads:%8ld diskwrites:%7ld\n",
+			probe.getBufStats().policyName, totals.accesses, totals.hits, totals.misses,
+			totals.accesses ? 100.0 * totals.hits / totals.accesses : 0.0, totals.diskreads, totals.diskwrites);
+	}
+	return 0;
+}
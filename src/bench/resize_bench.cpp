@@ -0,0 +1,118 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Resizes the buffer pool under load. Reader threads pin random pages while the main
+ * thread swings the pool between a small and a large size. One page stays pinned the whole
+ * time and its contents are checked after every resize. Printed per step: the size asked
+ * for and obtained, the hit ratio since the last step, and the resident set of the process.
+ * Finally the cgroup memory limit is shown with the pool size auto-resize would pick.
+ *
+ * Usage: ./resize_bench [steps] [stepMillis]
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+#include "bench_util.h"
+#include "buffer.h"
+#include "file.h"
+#include "page_iterator.h"
+
+using namespace badgerdb;
+
+const std::string benchFileName = "bench_resize.db";
+const int numPages = 2000;
+const std::uint32_t smallPool = 200;
+const std::uint32_t largePool = 2000;
+
+void reader(BufMgr* bufMgr, File* file, std::uint32_t seed, std::atomic<bool>* stop)
+{
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<PageId> pick(2, numPages);
+	while (!*stop)
+	{
+		PageId pageNo = pick(rng);
+		Page* page;
+		bufMgr->readPage(file, pageNo, page);
+		bufMgr->unPinPage(file, pageNo, false);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int steps = 10;
+	int stepMillis = 200;
+	if (argc > 1)
+		steps = atoi(argv[1]);
+	if (argc > 2)
+		stepMillis = atoi(argv[2]);
+
+	removeIfPresent(benchFileName);
+
+	{
+		PageFile file = PageFile::create(benchFileName);
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			Page page = file.allocatePage(pageNo);
+			page.insertRecord("page " + std::to_string(pageNo));
+			file.writePage(pageNo, page);
+		}
+	}
+
+	{
+		PageFile file = PageFile::open(benchFileName);
+		BufMgr* bufMgr = new BufMgr(smallPool, CLOCK, POOL_DEFAULT, largePool);
+
+		// a page which stays pinned through every resize
+		Page* pinned;
+		bufMgr->readPage(&file, 1, pinned);
+		const std::string expected = *pinned->begin();
+
+		std::atomic<bool> stop(false);
+		std::vector<std::thread> readers;
+		for (int t = 0; t < 4; t++)
+			readers.push_back(std::thread(reader, bufMgr, &file, 41 + t, &stop));
+
+		std::printf("pages:%d pool:%u..%u\n", numPages, smallPool, largePool);
+		bool intact = true;
+		for (int step = 0; step < steps; step++)
+		{
+			const std::uint32_t wanted = step % 2 == 0 ? largePool : smallPool;
+			bufMgr->clearBufStats();
+			const std::uint32_t got = bufMgr->resize(wanted);
+			std::this_thread::sleep_for(std::chrono::milliseconds(stepMillis));
+
+			intact = intact && *pinned->begin() == expected;
+			std::printf("resize to %5u -> %5u frames  hit ratio:%5.3f  rss:%7ld kB\n",
+				wanted, got, bufMgr->getBufStats().hitRatio(), residentKb());
+		}
+
+		stop = true;
+		for (std::size_t t = 0; t < readers.size(); t++)
+			readers[t].join();
+		std::printf("pinned page %s\n", intact ? "intact" : "CHANGED");
+
+		const std::uint64_t limit = BufMgr::cgroupMemoryLimit();
+		if (limit == 0)
+			std::printf("cgroup memory limit: none\n");
+		else
+			std::printf("cgroup memory limit: %llu MB, auto-resize at 50%% would use %llu frames\n",
+				(unsigned long long) (limit >> 20), (unsigned long long) (limit / 2 / sizeof(Page)));
+
+		bufMgr->unPinPage(&file, 1, false);
+		delete bufMgr;
+	}
+
+	File::remove(benchFileName);
+	return 0;
+}
@@ -0,0 +1,108 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Measures the compressed victim cache. A file four times the pool size, its pages a third
+ * full of text records, is read at random, first without the victim cache and then with a
+ * budget large enough for the compressed file, both with buffered and with O_DIRECT I/O.
+ * Printed per run: time per read, the pool and victim cache hit ratios, the average
+ * decompression time, the disk reads and the memory the victim cache holds.
+ *
+ * Usage: ./victim_cache_bench [ops] [frames]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include "bench_util.h"
+#include "buffer.h"
+#include "file.h"
+#include "victim_cache.h"
+
+using namespace badgerdb;
+
+const std::string benchFileName = "bench_victim_cache.db";
+
+void run(const FileIoMode mode, const std::uint32_t frames, const int numPages, const int ops,
+         const std::size_t budget)
+{
+	PageFile file(benchFileName, false, mode);
+	BufMgr* bufMgr = new BufMgr(frames);
+	bufMgr->setVictimCacheBudget(budget);
+
+	// one pass to fill the pool and the victim cache, then the measured reads
+	std::mt19937 rng(3);
+	std::uniform_int_distribution<PageId> pick(1, numPages);
+	for (int pass = 0; pass < 2; pass++)
+	{
+		bufMgr->clearBufStats();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < ops; i++)
+		{
+			PageId pageNo = pick(rng);
+			Page* page;
+			bufMgr->readPage(&file, pageNo, page);
+			bufMgr->unPinPage(&file, pageNo, false);
+		}
+		if (pass == 0)
+			continue;
+
+		const double ns = nsSince(start, ops);
+		const BufStats& stats = bufMgr->getBufStats();
+		std::printf("io:%-8s budget:%6zu kB  read:%7.0f ns  pool hits:%5.3f  victim hits:%5.3f"
+			"  decompress:%5.2f us  diskreads:%7d\n",
+			file.isDirect() ? "direct" : "buffered", budget >> 10, ns, stats.hitRatio(),
+			stats.victimHitRatio(),
+			stats.victimHits == 0 ? 0.0 : stats.victimDecompressNanos / 1e3 / stats.victimHits,
+			stats.diskreads.load());
+	}
+	bufMgr->flushFile(&file);
+	delete bufMgr;
+}
+
+int main(int argc, char **argv)
+{
+	int ops = 100000;
+	std::uint32_t frames = 1000;
+	if (argc > 1)
+		ops = atoi(argv[1]);
+	if (argc > 2)
+		frames = atoi(argv[2]);
+	const int numPages = 4 * frames;
+
+	removeIfPresent(benchFileName);
+
+	std::size_t compressedBytes = 0;
+	{
+		PageFile file = PageFile::create(benchFileName);
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			Page page = file.allocatePage(pageNo);
+			while (page.getFreeSpace() > 2 * Page::SIZE / 3)
+				page.insertRecord("record " + std::to_string(page.getFreeSpace()) + " of page " +
+					std::to_string(pageNo) + ": name, address, balance");
+			file.writePage(pageNo, page);
+
+			std::string compressed;
+			VictimCache::compress(page, compressed);
+			compressedBytes += compressed.size() + VictimCache::ENTRY_OVERHEAD;
+		}
+	}
+
+	std::printf("pages:%d frames:%u ops:%d  compressed page:%zu B\n",
+		numPages, frames, ops, compressedBytes / numPages - VictimCache::ENTRY_OVERHEAD);
+	run(BUFFERED_IO, frames, numPages, ops, 0);
+	run(BUFFERED_IO, frames, numPages, ops, compressedBytes);
+	run(DIRECT_IO, frames, numPages, ops, 0);
+	run(DIRECT_IO, frames, numPages, ops, compressedBytes);
+
+	File::remove(benchFileName);
+	return 0;
+}
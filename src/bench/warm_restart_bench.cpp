@@ -0,0 +1,118 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Restarts the buffer pool with and without a snapshot. A skewed workload runs over a file
+ * several times the pool size until the pool holds its hot pages, and the pool is saved to
+ * a snapshot as it shuts down. Then the first reads after a restart are timed three ways: on
+ * a cold pool, after loading the snapshot, and while the snapshot loads in the background.
+ * Printed per way: the time taken by the load, the hit ratio and the time of the first reads.
+ *
+ * Usage: ./warm_restart_bench [frames] [reads]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include "bench_util.h"
+#include "buffer.h"
+#include "file.h"
+
+using namespace badgerdb;
+
+const std::string benchFileName = "bench_warm_restart.db";
+const std::string snapshotName = "bench_warm_restart.snapshot";
+
+/**
+ * Reads pages with nine in ten reads going to the first pool-sized tenth of a shuffled file,
+ * the same sequence for a given seed.
+ */
+void workload(BufMgr* bufMgr, File* file, const std::vector<PageId>& order, const std::uint32_t frames,
+              const int reads, const std::uint32_t seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<std::uint32_t> hot(0, frames - 1);
+	std::uniform_int_distribution<std::uint32_t> any(0, order.size() - 1);
+	std::uniform_int_distribution<int> coin(0, 9);
+	for (int i = 0; i < reads; i++)
+	{
+		const PageId pageNo = order[coin(rng) < 9 ? hot(rng) : any(rng)];
+		Page* page;
+		bufMgr->readPage(file, pageNo, page);
+		bufMgr->unPinPage(file, pageNo, false);
+	}
+}
+
+void restart(const char* name, BlobFile& file, const std::vector<PageId>& order,
+             const std::uint32_t frames, const int reads, const int load)
+{
+	BufMgr* bufMgr = new BufMgr(frames);
+	std::vector<File*> files(1, &file);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::size_t loaded = 0;
+	if (load != 0)
+		loaded = bufMgr->loadSnapshot(snapshotName, files, load == 2);
+	const double loadMs = 1e3 * secondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	workload(bufMgr, &file, order, frames, reads, 99);
+	const double readMs = 1e3 * secondsSince(start);
+
+	std::printf("%-10s load:%8.2f ms (%5zu pages)  first %d reads:%8.2f ms  hit ratio:%6.3f\n",
+		name, loadMs, loaded, reads, readMs, bufMgr->getBufStats().hitRatio());
+	bufMgr->cancelPrefetch(&file);
+	delete bufMgr;
+}
+
+int main(int argc, char **argv)
+{
+	std::uint32_t frames = 2000;
+	int reads = 5000;
+	if (argc > 1)
+		frames = atoi(argv[1]);
+	if (argc > 2)
+		reads = atoi(argv[2]);
+	const std::uint32_t numPages = frames * 10;
+
+	removeIfPresent(benchFileName);
+	std::remove(snapshotName.c_str());
+	{
+		BlobFile file = BlobFile::create(benchFileName);
+		for (std::uint32_t i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			file.allocatePage(pageNo);
+		}
+	}
+
+	{
+		BlobFile file = BlobFile::open(benchFileName);
+		std::vector<PageId> order;
+		for (PageId pageNo = 1; pageNo <= numPages; pageNo++)
+			order.push_back(pageNo);
+		std::shuffle(order.begin(), order.end(), std::mt19937(7));
+
+		BufMgr* bufMgr = new BufMgr(frames);
+		bufMgr->setShutdownSnapshot(snapshotName);
+		workload(bufMgr, &file, order, frames, frames * 20, 41);
+		delete bufMgr;
+
+		std::printf("pages:%u frames:%u\n", numPages, frames);
+		restart("cold", file, order, frames, reads, 0);
+		restart("snapshot", file, order, frames, reads, 1);
+		restart("background", file, order, frames, reads, 2);
+	}
+
+	File::remove(benchFileName);
+	std::remove(snapshotName.c_str());
+	return 0;
+}
@@ -15,7 +15,9 @@
 #include "exceptions/index_scan_completed_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/badgerdb_exception.h"
 
+#include <iostream>
 #include <queue>
 #include <cmath>
 
@@ -65,17 +67,19 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 	this->numOfNodes = 0;
 	this->startScanIndex = -1;
 	this->scanExecuting = false;
+	this->readAheadDepth = DEFAULT_READ_AHEAD;
+	this->scanLeafPos = 0;
+	this->scanLeavesIssued = 0;
 
 	// Construct metadata page
-	Page * metaPage = new Page();
-	this->bufMgr->allocPage(this->file, this->headerPageNum, metaPage);
-	IndexMetaInfo * metadata = new IndexMetaInfo();
-	metadata = (IndexMetaInfo*)metaPage;
+	PageHandle metaPage = this->bufMgr->pinNewPage(this->file, this->headerPageNum, HINT_KEEP);
+	IndexMetaInfo * metadata = (IndexMetaInfo*)metaPage.page();
 	metadata->attrByteOffset = attrByteOffset;
 	metadata->attrType = attrType;
 	metadata->rootPageNo = 0;
 	strcpy(metadata->relationName, relationName.c_str());
-	this->bufMgr->unPinPage(this->file, this->headerPageNum, 1);
+	metaPage.markDirty();
+	metaPage.release();
 
 	// Insert all entries in relation into index
 	FileScan fscan(relationName, this->bufMgr);
@@ -132,6 +136,22 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 
 BTreeIndex::~BTreeIndex()
 {
+	// leaves read ahead for a scan that was never ended may still be loading
+	scanPage.release();
+	if (scanExecuting)
+		bufMgr->cancelPrefetch(file);
+
+	// index pages are unpinned dirty, so they have to be written before the file goes away;
+	// a destructor can't throw, so a failure is only reported
+	try
+	{
+		if (bufMgr->tryFlushFile(file) != BUF_OK)
+			std::cerr << "Index file " << file->filename() << " not flushed: a page is still pinned\n";
+	}
+	catch (BadgerDbException &e)
+	{
+		std::cerr << "Index file " << file->filename() << " not flushed: " << e << "\n";
+	}
 	this->file->~File();
 }
 
@@ -151,21 +171,19 @@ const void BTreeIndex::insertEntry(L* leafType, NL* nonLeafType, T keyValue, con
 	}
 
 	// Read root node
-	Page * metadataPage = new Page();
-	this->bufMgr->readPage(this->file, this->headerPageNum, metadataPage);
-	IndexMetaInfo * metadata = new IndexMetaInfo();
-	metadata = (IndexMetaInfo*)metadataPage;
+	PageHandle metadataPage = this->bufMgr->pinPage(this->file, this->headerPageNum, NULL, HINT_KEEP);
+	metadataPage.markDirty();
+	IndexMetaInfo * metadata = (IndexMetaInfo*)metadataPage.page();
 
 	//  Tree is empty (first insertion) 
 	if (metadata->rootPageNo == 0) {
 		// Allocate root page
-		Page * rootPage = new Page();
-		this->bufMgr->allocPage(this->file, this->rootPageNum, rootPage);
+		PageHandle rootPage = this->bufMgr->pinNewPage(this->file, this->rootPageNum);
+		rootPage.markDirty();
 		metadata->rootPageNo = this->rootPageNum;
 		this->numOfNodes++;
 		
-		L * rootNode = new L();
-		rootNode = (L*)rootPage;
+		L * rootNode = (L*)rootPage.page();
 
 		// Initialize root page based on type
 		switch (this->attributeType) {
@@ -176,7 +194,6 @@ const void BTreeIndex::insertEntry(L* leafType, NL* nonLeafType, T keyValue, con
 		// Assign record to node
 		rootNode->keyArray[0] = keyValue;
 		rootNode->ridArray[0] = rid;
-		this->bufMgr->unPinPage(this->file, this->rootPageNum, 1);
 	}
 
 	// Tree is not empty (every cases other than first insertion) 
@@ -189,10 +206,9 @@ const void BTreeIndex::insertEntry(L* leafType, NL* nonLeafType, T keyValue, con
  		 * 2. We are not traversing through nodes. So parent node will be NULL.
  		 */
 		if (this->numOfNodes == 1)  {
-			Page * rootPage = new Page();
-			this->bufMgr->readPage(this->file, this->rootPageNum, rootPage);
-			L * rootNode = new L();
-			rootNode = (L*)rootPage;
+			PageHandle rootPage = this->bufMgr->pinPage(this->file, this->rootPageNum);
+			rootPage.markDirty();
+			L * rootNode = (L*)rootPage.page();
 
 
 			// After the insertion, call fullNodeHandler if the node is full.
@@ -214,10 +230,9 @@ const void BTreeIndex::insertEntry(L* leafType, NL* nonLeafType, T keyValue, con
 		else {	
 
 			// Read root node
-			Page * rootPage;
-			bufMgr->readPage(file, metadata->rootPageNo, rootPage);  
-			NL * rootNode = new NL();
-			rootNode = (NL*)rootPage;
+			PageHandle rootPage = bufMgr->pinPage(file, metadata->rootPageNo, NULL, HINT_KEEP);
+			rootPage.markDirty();
+			NL * rootNode = (NL*)rootPage.page();
 
 			// Find appropiate leaf node and insert. Call fullNodeHandler if the 
 			// insertion causing the node to be fully filled up
@@ -233,9 +248,8 @@ const void BTreeIndex::insertEntry(L* leafType, NL* nonLeafType, T keyValue, con
 
 	}
 
-	// Set root page number and unpin page	
+	// Set root page number; the handles unpin the pages
 	metadata->rootPageNo = this->rootPageNum;
-	this->bufMgr->unPinPage(this->file, this->headerPageNum, 0);
 }
 
 
@@ -250,28 +264,24 @@ const void BTreeIndex::insertEntryString(const void* key, const RecordId rid)
 	int leafSize;
 	leafSize = STRINGARRAYLEAFSIZE; 
 
-	Page * metadataPage = new Page();
-	this->bufMgr->readPage(this->file, this->headerPageNum, metadataPage);
-	IndexMetaInfo * metadata = new IndexMetaInfo();
-	metadata = (IndexMetaInfo*)metadataPage;
+	PageHandle metadataPage = this->bufMgr->pinPage(this->file, this->headerPageNum, NULL, HINT_KEEP);
+	metadataPage.markDirty();
+	IndexMetaInfo * metadata = (IndexMetaInfo*)metadataPage.page();
 
 	// Tree is empty (first insertion) 
 	if (metadata->rootPageNo == 0) {
 		// Allocate root page
-		Page * rootPage = new Page();
-		this->bufMgr->allocPage(this->file, this->rootPageNum, rootPage);
+		PageHandle rootPage = this->bufMgr->pinNewPage(this->file, this->rootPageNum);
+		rootPage.markDirty();
 		metadata->rootPageNo = this->rootPageNum;
 		this->numOfNodes++;
 
-		
-		LeafNodeString * rootNode = new LeafNodeString();
-		rootNode = (LeafNodeString *) rootPage;
+		LeafNodeString * rootNode = (LeafNodeString *) rootPage.page();
 
 		// Initialze root node
 		initializeString(rootNode);
 		strncpy(rootNode->keyArray[0], (char *) keyValue, 10);
 		rootNode->ridArray[0] = rid;
-		this->bufMgr->unPinPage(this->file, this->rootPageNum, 1);
 	}
 
 	// Tree is not empty (every cases other than first insertion) 
@@ -285,10 +295,9 @@ const void BTreeIndex::insertEntryString(const void* key, const RecordId rid)
  		 */
 		if (this->numOfNodes == 1)  {
 			// Read root node
-			Page * rootPage = new Page();
-			this->bufMgr->readPage(this->file, this->rootPageNum, rootPage);
-			LeafNodeString * rootNode = new LeafNodeString();
-			rootNode = (LeafNodeString*)rootPage;
+			PageHandle rootPage = this->bufMgr->pinPage(this->file, this->rootPageNum);
+			rootPage.markDirty();
+			LeafNodeString * rootNode = (LeafNodeString*)rootPage.page();
 
 			// After the insertion, call fullNodeHandler if the node is full.
 			insertToNodeString(rootNode,keyValue,rid);
@@ -301,10 +310,9 @@ const void BTreeIndex::insertEntryString(const void* key, const RecordId rid)
 		// This block is the general case where there is more than one node */
 		else {	
 			// Read root node
-			Page * rootPage;
-			bufMgr->readPage(file, metadata->rootPageNo, rootPage);  
-			NonLeafNodeString * rootNode = new NonLeafNodeString();
-			rootNode = (NonLeafNodeString *) rootPage;
+			PageHandle rootPage = bufMgr->pinPage(file, metadata->rootPageNo, NULL, HINT_KEEP);
+			rootPage.markDirty();
+			NonLeafNodeString * rootNode = (NonLeafNodeString *) rootPage.page();
 
 			// Find appropriate leaf node and insert
 			traverseAndInsertString(rootNode, key, rid);
@@ -318,9 +326,8 @@ const void BTreeIndex::insertEntryString(const void* key, const RecordId rid)
 
 	}
 	
-	// Set root page number and unpin page	
+	// Set root page number; the handles unpin the pages
 	metadata->rootPageNo = this->rootPageNum;
-	this->bufMgr->unPinPage(this->file, this->headerPageNum, 0);
 }
 
 
@@ -397,10 +404,11 @@ void BTreeIndex::fullNodeHandlerNumber(L* leafType, NL* nonLeafType, void* currN
 	}
 
 	// Check if there already exists the parent to push up
+	PageHandle newParentPage;
 	if (isRoot) {
-		Page * newParentPage = new Page();
-		this->bufMgr->allocPage(this->file, this->rootPageNum, newParentPage);
-		parentNode = (NL*)newParentPage;
+		newParentPage = this->bufMgr->pinNewPage(this->file, this->rootPageNum, HINT_KEEP);
+		newParentPage.markDirty();
+		parentNode = (NL*)newParentPage.page();
 		for (int i=0; i < nonleafSize; i++) {
 			parentNode->keyArray[i] = -1;
 		}
@@ -450,10 +458,11 @@ void BTreeIndex::fullNodeHandlerString(void* currNode, NonLeafNodeString *parent
 	int nonleafSize = STRINGARRAYNONLEAFSIZE;
 
 	// Check if there already exists the parent to push up
+	PageHandle newParentPage;
 	if (parentNode == NULL) {
-		Page * newParentPage = new Page();
-		this->bufMgr->allocPage(this->file, this->rootPageNum, newParentPage);
-		parentNode = (NonLeafNodeString*)newParentPage;
+		newParentPage = this->bufMgr->pinNewPage(this->file, this->rootPageNum, HINT_KEEP);
+		newParentPage.markDirty();
+		parentNode = (NonLeafNodeString*)newParentPage.page();
 		for (int i=0; i < nonleafSize; i++) {
 			strncpy(parentNode->keyArray[i], "\0\0\0\0\0\0\0\0\0\0", 10);
 		}
@@ -513,10 +522,9 @@ void BTreeIndex::splitLeafNode(L *& leftNode, T& middleKey, PageId &pid) {
 
 	// After splitNode, the original node will be in left, while returned node will be in right
 	// Allocate new page to be right child of root
-	Page * rightPage = new Page();
-	this->bufMgr->allocPage(this->file, pid, rightPage);
-	L * rightNode = new L();
-	rightNode = (L*)rightPage;
+	PageHandle rightPage = this->bufMgr->pinNewPage(this->file, pid);
+	rightPage.markDirty();
+	L * rightNode = (L*)rightPage.page();
 
 	// Get the middle value
 	int middlePoint = (leafSize/2);
@@ -553,10 +561,9 @@ void BTreeIndex::splitLeafNodeString(LeafNodeString *& leftNode, char* middleKey
 
 	// After splitNode, the original node will be in left, while returned node will be in right
 	// Allocate new page to be right child of root
-	Page * rightPage = new Page();
-	this->bufMgr->allocPage(this->file, pid, rightPage);
-	LeafNodeString * rightNode = new LeafNodeString();
-	rightNode = (LeafNodeString*)rightPage;
+	PageHandle rightPage = this->bufMgr->pinNewPage(this->file, pid);
+	rightPage.markDirty();
+	LeafNodeString * rightNode = (LeafNodeString*)rightPage.page();
 
 	// Get the middle value
 	int middlePoint = (leafSize/2);
@@ -602,10 +609,9 @@ void BTreeIndex::splitNonLeafNode(NL *& leftNode, T& middleKey, PageId &pid) {
 	
 	// After splitNode, the original node will be in left, while returned node will be in right
 	// Allocate new page to be right child of root
-	Page * rightPage = new Page();
-	this->bufMgr->allocPage(this->file, pid, rightPage);
-	NL * rightNode = new NL();
-	rightNode = (NL*)rightPage;
+	PageHandle rightPage = this->bufMgr->pinNewPage(this->file, pid, HINT_KEEP);
+	rightPage.markDirty();
+	NL * rightNode = (NL*)rightPage.page();
 
 	// Get the middle value
 	int middlePoint = nonleafSize/2;
@@ -636,10 +642,9 @@ void BTreeIndex::splitNonLeafNodeString(NonLeafNodeString *& leftNode, char* mid
 	int leafSize = STRINGARRAYNONLEAFSIZE;
 
 	// Allocate new page to be right child of root
-	Page * rightPage = new Page();
-	this->bufMgr->allocPage(this->file, pid, rightPage);
-	NonLeafNodeString * rightNode = new NonLeafNodeString();
-	rightNode = (NonLeafNodeString*)rightPage;
+	PageHandle rightPage = this->bufMgr->pinNewPage(this->file, pid, HINT_KEEP);
+	rightPage.markDirty();
+	NonLeafNodeString * rightNode = (NonLeafNodeString*)rightPage.page();
 
 	// Get the middle value
 	int middlePoint = (leafSize/2);
@@ -685,13 +690,15 @@ void BTreeIndex::traverseAndInsertNumber(L* leafType, NL* nonLeafType, NL* currN
 		}
 	}
 
-	Page * childPage = new Page();
-	this->bufMgr->readPage(this->file, currNode->pageNoArray[i], childPage);
+	// inner nodes are on the path of every insert; leaves only of those with nearby keys
+	PageHandle childPage = this->bufMgr->pinPage(this->file, currNode->pageNoArray[i], NULL,
+			currNode->level != 1 ? HINT_KEEP : HINT_NORMAL);
+	childPage.markDirty();
 
 	void * childNode;
 	//Recursively call traverse if the child is not the leaf's parent (level is 1)
 	if (currNode->level != 1) {		
-		childNode = (NL*)childPage;
+		childNode = (NL*)childPage.page();
 		traverseAndInsertNumber(leafType, nonLeafType, (NL*)childNode, key, rid);
 
 		// Split node if the node is full before inserting
@@ -702,7 +709,7 @@ void BTreeIndex::traverseAndInsertNumber(L* leafType, NL* nonLeafType, NL* currN
 	}
 	// Insert record to the leaf node
 	else {		
-		childNode = (L*)childPage;
+		childNode = (L*)childPage.page();
 		switch(this->attributeType) {
 			case INTEGER: insertToNodeNumber<int>((L*)childNode, key, rid); break;
 			case DOUBLE: insertToNodeNumber<double>((L*)childNode, key, rid); break;
@@ -735,14 +742,16 @@ void BTreeIndex::traverseAndInsertString(NonLeafNodeString* currNode, const void
 			break;
 		}
 	}	
-	Page * childPage = new Page();
-	this->bufMgr->readPage(this->file, currNode->pageNoArray[i], childPage);
+	// inner nodes are on the path of every insert; leaves only of those with nearby keys
+	PageHandle childPage = this->bufMgr->pinPage(this->file, currNode->pageNoArray[i], NULL,
+			currNode->level != 1 ? HINT_KEEP : HINT_NORMAL);
+	childPage.markDirty();
 
 	void * childNode;
 
 	//Recursively call traverse if the child is not the leaf's parent (level is 1)
 	if (currNode->level != 1) {		// child is non-leaf
-		childNode = (NonLeafNodeString*)childPage;
+		childNode = (NonLeafNodeString*)childPage.page();
 
 		traverseAndInsertString((NonLeafNodeString*)childNode, key, rid);
 
@@ -754,7 +763,7 @@ void BTreeIndex::traverseAndInsertString(NonLeafNodeString* currNode, const void
 	}
 	// Insert record to the leaf node
 	else {	
-		childNode = (LeafNodeString*)childPage;
+		childNode = (LeafNodeString*)childPage.page();
 		insertToNodeString((LeafNodeString*)childNode, key, rid);
 		if(strcmp(((LeafNodeString*) childNode)->keyArray[STRINGARRAYLEAFSIZE-1], "\0\0\0\0\0\0\0\0\0\0") != 0){
 	
@@ -804,6 +813,62 @@ const void BTreeIndex::initializeString(LeafNodeString* rootNode)
 	}
 }
 
+// -----------------------------------------------------------------------------
+// BTreeIndex::setReadAhead
+// -----------------------------------------------------------------------------
+void BTreeIndex::setReadAhead(const std::uint32_t depth)
+{
+	readAheadDepth = depth;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::startLeafReadAhead - remember the leaves right of the first one
+// -----------------------------------------------------------------------------
+void BTreeIndex::startLeafReadAhead(const PageId* siblings, const int count, const PageId rightSib)
+{
+	// the parent lists its children in key order; an empty slot ends the list
+	scanLeaves.clear();
+	for (int i = 0; i < count && siblings[i] != 0; i++)
+		scanLeaves.push_back(siblings[i]);
+	scanLeafPos = 0;
+	scanLeavesIssued = 0;
+	readAheadLeaves(rightSib);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::advanceLeafReadAhead - the scan moved on to the next leaf
+// -----------------------------------------------------------------------------
+void BTreeIndex::advanceLeafReadAhead(const PageId leaf, const PageId rightSib)
+{
+	if (scanLeafPos < scanLeaves.size() && scanLeaves[scanLeafPos] == leaf) {
+		scanLeafPos++;
+	}
+	else {
+		// crossed into the leaves of another parent
+		scanLeaves.clear();
+		scanLeafPos = 0;
+		scanLeavesIssued = 0;
+	}
+	readAheadLeaves(rightSib);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::readAheadLeaves - keep readAheadDepth leaves loading ahead of the scan
+// -----------------------------------------------------------------------------
+void BTreeIndex::readAheadLeaves(const PageId rightSib)
+{
+	std::vector<PageId> pages;
+	if (scanLeafPos < scanLeaves.size()) {
+		while (scanLeavesIssued < scanLeaves.size() && scanLeavesIssued < scanLeafPos + readAheadDepth)
+			pages.push_back(scanLeaves[scanLeavesIssued++]);
+	}
+	else if (rightSib != 0 && readAheadDepth > 0) {
+		// past the parent's last child only the sibling pointer tells what comes next
+		pages.push_back(rightSib);
+	}
+	bufMgr->prefetch(file, pages);
+}
+
 // --------------------------------------------------------------------------------
 // BTreeIndex::startScanNumber - helper function of startScan for int and double
 // --------------------------------------------------------------------------------
@@ -823,16 +888,17 @@ const void BTreeIndex::startScanNumber (L* leafType, NL* nonLeafType, T lowVal,
 	}
 
 	// Read root node
-	Page* metaPage; 
-	bufMgr->readPage(file, headerPageNum, metaPage); 
+	PageHandle metaPage = bufMgr->pinPage(file, headerPageNum, NULL, HINT_KEEP);
 
-	IndexMetaInfo * metadata = (IndexMetaInfo *) metaPage;
+	IndexMetaInfo * metadata = (IndexMetaInfo *) metaPage.page();
 
 	// Check if the lowval and highval are valid	
 	if(lowVal > highVal) {
 		throw BadScanrangeException();
 	}
 
+	// a scan started again without endScan drops the leaf it held
+	scanPage.release();
 	scanExecuting = true;
 
 
@@ -844,8 +910,8 @@ const void BTreeIndex::startScanNumber (L* leafType, NL* nonLeafType, T lowVal,
 	} 
 	else {
 		// Get the root node.
-		bufMgr->readPage(file, metadata->rootPageNo, currentPageData); 
-		NL * currNode  = (NL *) currentPageData;
+		PageHandle node = bufMgr->pinPage(file, metadata->rootPageNo, NULL, HINT_KEEP);
+		NL * currNode  = (NL *) node.page();
 		currentPageNum = metadata->rootPageNo;	
 	
 		int index = 0;
@@ -859,10 +925,10 @@ const void BTreeIndex::startScanNumber (L* leafType, NL* nonLeafType, T lowVal,
 				}
 			}
 
-			bufMgr->readPage(file, currNode->pageNoArray[index], currentPageData);
-			bufMgr->unPinPage(file, currentPageNum, false);
-			currNode = (NL *) currentPageData;
+			// moving the child's handle in unpins the parent
 			currentPageNum = currNode->pageNoArray[index];
+			node = bufMgr->pinPage(file, currentPageNum, NULL, HINT_KEEP);
+			currNode = (NL *) node.page();
 		}
 
 		// At the 1st level node 
@@ -873,9 +939,11 @@ const void BTreeIndex::startScanNumber (L* leafType, NL* nonLeafType, T lowVal,
 		}
 
 		// Read the correct leaf node that contains the start of the record
-		bufMgr->readPage(file, currNode->pageNoArray[index], currentPageData);
-		bufMgr->unPinPage(file, currentPageNum, false);
+		// The leaf stays pinned until the scan moves past it or ends
 		currentPageNum = currNode->pageNoArray[index];
+		scanPage = bufMgr->pinPage(file, currentPageNum, NULL, scanLeafHint());
+		startLeafReadAhead(currNode->pageNoArray + index + 1, nonleafSize - index,
+				((L*) scanPage.page())->rightSibPageNo);
 		nextEntry = 0;
 	}
 }
@@ -898,10 +966,9 @@ const void BTreeIndex::startScanString(const void* lowValParm,
 	} 
 	
 	// Read root page
-	Page* metaPage; 
-	bufMgr->readPage(file, headerPageNum, metaPage); 
+	PageHandle metaPage = bufMgr->pinPage(file, headerPageNum, NULL, HINT_KEEP);
 
-	IndexMetaInfo * metadata = (IndexMetaInfo *) metaPage;
+	IndexMetaInfo * metadata = (IndexMetaInfo *) metaPage.page();
 
 	// Set scanner variables
 	lowValString = (std::string) ((char*) lowValParm);
@@ -915,6 +982,8 @@ const void BTreeIndex::startScanString(const void* lowValParm,
 		throw BadScanrangeException();
 	}
 
+	// a scan started again without endScan drops the leaf it held
+	scanPage.release();
 	scanExecuting = true;
 
 	// Find the appropriate node to start scanning from 
@@ -925,8 +994,8 @@ const void BTreeIndex::startScanString(const void* lowValParm,
 	} 
 	else {
 		// Get the root node.
-		bufMgr->readPage(file, metadata->rootPageNo, currentPageData); 
-		NonLeafNodeString * currNode  = (NonLeafNodeString *) currentPageData;
+		PageHandle node = bufMgr->pinPage(file, metadata->rootPageNo, NULL, HINT_KEEP);
+		NonLeafNodeString * currNode  = (NonLeafNodeString *) node.page();
 		currentPageNum = metadata->rootPageNo;	
 	
 		int index = 0;
@@ -941,10 +1010,10 @@ const void BTreeIndex::startScanString(const void* lowValParm,
 				}
 			}
 
-			bufMgr->readPage(file, currNode->pageNoArray[index], currentPageData);
-			bufMgr->unPinPage(file, currentPageNum, false);
-			currNode = (NonLeafNodeString *) currentPageData;
+			// moving the child's handle in unpins the parent
 			currentPageNum = currNode->pageNoArray[index];
+			node = bufMgr->pinPage(file, currentPageNum, NULL, HINT_KEEP);
+			currNode = (NonLeafNodeString *) node.page();
 		}
 
 		// At the 1st level node 
@@ -957,9 +1026,11 @@ const void BTreeIndex::startScanString(const void* lowValParm,
 		}
 
 		// Read the leaf node that contains the first record to be scanned
-		bufMgr->readPage(file, currNode->pageNoArray[index], currentPageData);
-		bufMgr->unPinPage(file, currentPageNum, false);
+		// The leaf stays pinned until the scan moves past it or ends
 		currentPageNum = currNode->pageNoArray[index];
+		scanPage = bufMgr->pinPage(file, currentPageNum, NULL, scanLeafHint());
+		startLeafReadAhead(currNode->pageNoArray + index + 1, STRINGARRAYNONLEAFSIZE - index,
+				((LeafNodeString*) scanPage.page())->rightSibPageNo);
 		nextEntry = 0;
 	}
 }
@@ -1037,9 +1108,10 @@ const void BTreeIndex::scanNextNumber(L* leafType, RecordId& outRid, T lowVal, T
 		throw ScanNotInitializedException();
 	}
 
-	// Read root node
-	bufMgr->readPage(file, currentPageNum, currentPageData); 
-	L * currNode = (L *) currentPageData;
+	// Pin the current leaf; it stays pinned across calls until the scan leaves it
+	if (!scanPage.valid())
+		scanPage = bufMgr->pinPage(file, currentPageNum, NULL, scanLeafHint());
+	L * currNode = (L *) scanPage.page();
 
 	// Find the very first value's index that needs to be scanned from
 	if(startScanIndex == -1){
@@ -1072,7 +1144,7 @@ const void BTreeIndex::scanNextNumber(L* leafType, RecordId& outRid, T lowVal, T
 		//Case if we're at the end of the leaf node
 		if(currNode->keyArray[nextEntry] == -1){
 			PageId siblingNode = currNode->rightSibPageNo;
-			bufMgr->unPinPage(file, currentPageNum, false);	
+			scanPage.release();
 		
 			nextEntry = 0;
 			
@@ -1083,12 +1155,14 @@ const void BTreeIndex::scanNextNumber(L* leafType, RecordId& outRid, T lowVal, T
 			
 			// Set current node 
 			currentPageNum = siblingNode;
-			bufMgr->readPage(file, currentPageNum, currentPageData);
-			currNode = (L*)currentPageData;
+			scanPage = bufMgr->pinPage(file, currentPageNum, NULL, scanLeafHint());
+			currNode = (L*)scanPage.page();
+			advanceLeafReadAhead(siblingNode, currNode->rightSibPageNo);
 		}
 		
 		//If the value of the element is passing the high value, end the scan
 		else if (currNode->keyArray[nextEntry] > highVal){
+			scanPage.release();
 			throw IndexScanCompletedException();
 		}
 
@@ -1101,6 +1175,7 @@ const void BTreeIndex::scanNextNumber(L* leafType, RecordId& outRid, T lowVal, T
 				nextEntry++;
 			}
 			else if((highOp == LT) && (highVal == currNode->keyArray[nextEntry])){
+				scanPage.release();
 				throw IndexScanCompletedException();
 			}
 			else{ 
@@ -1124,9 +1199,10 @@ const void BTreeIndex::scanNextString(RecordId& outRid)
 		throw ScanNotInitializedException();
 	}
 
-	// Read root node
-	bufMgr->readPage(file, currentPageNum, currentPageData); 
-	LeafNodeString * currNode = (LeafNodeString *) currentPageData;
+	// Pin the current leaf; it stays pinned across calls until the scan leaves it
+	if (!scanPage.valid())
+		scanPage = bufMgr->pinPage(file, currentPageNum, NULL, scanLeafHint());
+	LeafNodeString * currNode = (LeafNodeString *) scanPage.page();
 
 	// Find appropriate starting element value of the node
 	if(startScanIndex == -1){
@@ -1160,7 +1236,7 @@ const void BTreeIndex::scanNextString(RecordId& outRid)
 		//Case if we're at the end of the leaf node
 		if(strcmp(currNode->keyArray[nextEntry],"\0\0\0\0\0\0\0\0\0\0") == 0){
 			PageId siblingNode = currNode->rightSibPageNo;
-			bufMgr->unPinPage(file, currentPageNum, false);	
+			scanPage.release();
 		
 			nextEntry = 0;
 	
@@ -1170,12 +1246,14 @@ const void BTreeIndex::scanNextString(RecordId& outRid)
 			}
 			// Set current node
 			currentPageNum = siblingNode;
-			bufMgr->readPage(file, currentPageNum, currentPageData);
-			currNode = (LeafNodeString*)currentPageData;
+			scanPage = bufMgr->pinPage(file, currentPageNum, NULL, scanLeafHint());
+			currNode = (LeafNodeString*)scanPage.page();
+			advanceLeafReadAhead(siblingNode, currNode->rightSibPageNo);
 		}
 
 		//If the value of the element is passing the high value, end the scan
 		else if ((std::string)currNode->keyArray[nextEntry] > highValString){
+			scanPage.release();
 			throw IndexScanCompletedException();
 		}
 
@@ -1187,6 +1265,7 @@ const void BTreeIndex::scanNextString(RecordId& outRid)
 				nextEntry++;
 			}
 			else if((highOp == LT) && (strncmp(currNode->keyArray[nextEntry],highValString.c_str(),10) == 0)){	
+				scanPage.release();
 				throw IndexScanCompletedException();
 			}
 			else{
@@ -1240,6 +1319,10 @@ const void BTreeIndex::endScan()
 	}
 	scanExecuting = false;
 	startScanIndex = -1;
+	scanPage.release();
+
+	// don't leave read-ahead of this scan running against the index file
+	bufMgr->cancelPrefetch(file);
 }
 
 
@@ -1251,17 +1334,16 @@ void BTreeIndex::printTree(){
 
 	std::queue<PageId> q;
 
-	Page* metaPage; 
-	bufMgr->readPage(file, headerPageNum, metaPage); 
-	IndexMetaInfo * metadata = (IndexMetaInfo *) metaPage;
+	PageHandle metaPage = bufMgr->pinPage(file, headerPageNum, NULL, HINT_KEEP);
+	IndexMetaInfo * metadata = (IndexMetaInfo *) metaPage.page();
 
 
 	PageId currPageNum;
 	LeafNodeString * currLeafNode;
-	Page* currPageData;
+	PageHandle currPageData;
 	if(numOfNodes == 1){
-		bufMgr->readPage(file, metadata->rootPageNo, currPageData); 
-		currLeafNode  = (LeafNodeString *) currPageData;
+		currPageData = bufMgr->pinPage(file, metadata->rootPageNo);
+		currLeafNode  = (LeafNodeString *) currPageData.page();
 		int i = 0;
 		for(i = 0; i < STRINGARRAYNONLEAFSIZE; i++){
 			if(strcmp(currLeafNode->keyArray[i], "\0\0\0\0\0\0\0\0\0\0") != 0){
@@ -1275,8 +1357,8 @@ void BTreeIndex::printTree(){
 	}
 
 
-	bufMgr->readPage(file, metadata->rootPageNo, currPageData); 
-	NonLeafNodeString * currNode  = (NonLeafNodeString *) currPageData;
+	PageHandle rootPage = bufMgr->pinPage(file, metadata->rootPageNo);
+	NonLeafNodeString * currNode  = (NonLeafNodeString *) rootPage.page();
 		
 	//Only works for one level tree as for now	
 	while(currNode->level >=1){
@@ -1294,8 +1376,8 @@ void BTreeIndex::printTree(){
 		while(!q.empty()){
 			currPageNum = q.front();
 			q.pop();
-			bufMgr->readPage(file, currPageNum, currPageData);
-			currLeafNode = (LeafNodeString *) currPageData;
+			currPageData = bufMgr->pinPage(file, currPageNum);
+			currLeafNode = (LeafNodeString *) currPageData.page();
 		
 			for(i = 0; i < STRINGARRAYLEAFSIZE; i++){
 				if(strcmp(currLeafNode->keyArray[i], "\0\0\0\0\0\0\0\0\0\0") != 0){
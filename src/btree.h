@@ -360,9 +360,9 @@ class BTreeIndex {
 	PageId	currentPageNum;
 
   /**
-   * Current Page being scanned.
+   * Pin on the leaf being scanned, held from one scanNext() call to the next.
    */
-	Page		*currentPageData;
+	PageHandle	scanPage;
 
   /**
    * Low INTEGER value for scan.
@@ -409,6 +409,52 @@ class BTreeIndex {
    */
 	int startScanIndex;
 
+  /**
+   * Leaves to the right of the first leaf of the scan, taken from their common parent
+   */
+	std::vector<PageId> scanLeaves;
+
+  /**
+   * Number of scanLeaves the scan has moved past, and number handed to the prefetcher
+   */
+	std::size_t scanLeafPos;
+	std::size_t scanLeavesIssued;
+
+  /**
+   * Number of leaves to keep loading ahead of an index scan
+   */
+	std::uint32_t readAheadDepth;
+
+  /**
+   * Sets up leaf read-ahead when a scan reaches its first leaf.
+   * @param siblings	Children of the parent after the first leaf
+   * @param count	Number of entries in siblings
+   * @param rightSib	Right sibling of the first leaf
+   */
+	void startLeafReadAhead(const PageId* siblings, const int count, const PageId rightSib);
+
+  /**
+   * Moves leaf read-ahead along when a scan follows a sibling pointer.
+   * @param leaf	Leaf the scan moved to
+   * @param rightSib	Right sibling of that leaf
+   */
+	void advanceLeafReadAhead(const PageId leaf, const PageId rightSib);
+
+  /**
+   * Hands the next leaves of the scan to the buffer manager's prefetcher.
+   * @param rightSib	Right sibling of the current leaf
+   */
+	void readAheadLeaves(const PageId rightSib);
+
+  /**
+   * Hint for the leaves a scan pins: nothing reads them again soon, except the single
+   * node of a one-node tree, which every insert goes to as well.
+   */
+	PageHint scanLeafHint() const
+	{
+		return numOfNodes == 1 ? HINT_NORMAL : HINT_EVICT_SOON;
+	}
+
   /**	
    * String default value for string insertion (\0\0\0\0\0\0\0\0\0\0)
    */
@@ -432,6 +478,17 @@ class BTreeIndex {
 						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
 	
 
+	/**
+	 * Number of leaves an index scan loads ahead by default
+	 */
+	static const std::uint32_t DEFAULT_READ_AHEAD = 4;
+
+	/**
+	 * Sets how many leaves an index scan keeps loading ahead of the one it is on. 0 turns read-ahead off.
+	 * @param depth	Number of leaves
+	 */
+	void setReadAhead(const std::uint32_t depth);
+
   	/**
    	* BTreeIndex Destructor. 
 	 * End any initialized scan, flush index file, after unpinning any pinned pages, from the buffer manager
@@ -15,100 +15,154 @@
 
 namespace badgerdb {
 
-int BufHashTbl::hash(const File* file, const PageId pageNo)
+BufHashTbl::BufHashTbl(const std::uint32_t numBufs)
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
-  return value;
+  // each partition gets room for twice its share of the frames, rounded up to a power of two
+  std::uint32_t perPartition = (numBufs * 2) / NUM_PARTITIONS + 1;
+  std::uint32_t size = 16;
+  while (size < perPartition)
+    size <<= 1;
+
+  for (int i = 0; i < NUM_PARTITIONS; i++)
+  {
+    partitions[i].slots = new hashSlot[size];
+    partitions[i].mask = size - 1;
+    partitions[i].count = 0;
+    for (std::uint32_t j = 0; j < size; j++)
+      partitions[i].slots[j].fileId = File::INVALID_ID;
+  }
 }
 
-BufHashTbl::BufHashTbl(int htSize)
-	: HTSIZE(htSize)
+BufHashTbl::~BufHashTbl()
 {
-  // allocate an array of pointers to hashBuckets
-  ht = new hashBucket* [htSize];
-  for(int i=0; i < HTSIZE; i++)
-    ht[i] = NULL;
+  for (int i = 0; i < NUM_PARTITIONS; i++)
+    delete [] partitions[i].slots;
 }
 
-BufHashTbl::~BufHashTbl()
+long BufHashTbl::find(const hashPartition& part, const std::uint64_t h, const FileId fileId, const PageId pageNo) const
 {
-  for(int i = 0; i < HTSIZE; i++) {
-    hashBucket* tmpBuf = ht[i];
-    while (ht[i]) {
-      tmpBuf = ht[i];
-      ht[i] = ht[i]->next;
-      delete tmpBuf;
-    }
+  std::uint32_t index = (std::uint32_t) h & part.mask;
+  for (std::uint32_t dist = 0; ; dist++)
+  {
+    const hashSlot& slot = part.slots[index];
+    // an empty slot or a richer entry ends the probe: Robin Hood keeps runs sorted by distance
+    if (slot.fileId == File::INVALID_ID || slot.dist < dist)
+      return -1;
+    if (slot.fileId == fileId && slot.pageNo == pageNo)
+      return index;
+    index = (index + 1) & part.mask;
   }
-  delete [] ht;
 }
 
-void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
+void BufHashTbl::grow(hashPartition& part)
 {
-  int index = hash(file, pageNo);
-
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-  		throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
-    tmpBuc = tmpBuc->next;
+  hashSlot* old = part.slots;
+  std::uint32_t oldSize = part.mask + 1;
+
+  part.slots = new hashSlot[oldSize * 2];
+  if (!part.slots)
+    throw HashTableException();
+  part.mask = oldSize * 2 - 1;
+  part.count = 0;
+  for (std::uint32_t j = 0; j <= part.mask; j++)
+    part.slots[j].fileId = File::INVALID_ID;
+
+  for (std::uint32_t j = 0; j < oldSize; j++)
+  {
+    if (old[j].fileId != File::INVALID_ID)
+      place(part, hash(old[j].fileId, old[j].pageNo), old[j].fileId, old[j].pageNo, old[j].frameNo);
   }
+  delete [] old;
+}
 
-  tmpBuc = new hashBucket;
-  if (!tmpBuc)
-  	throw HashTableException();
+void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
+{
+  const std::uint64_t h = hash(file->id(), pageNo);
+  hashPartition& part = partitions[partitionOf(h)];
 
-  tmpBuc->file = (File*) file;
-  tmpBuc->pageNo = pageNo;
-  tmpBuc->frameNo = frameNo;
-  tmpBuc->next = ht[index];
-  ht[index] = tmpBuc;
+  long existing = find(part, h, file->id(), pageNo);
+  if (existing >= 0)
+    throw HashAlreadyPresentException(file->filename(), pageNo, part.slots[existing].frameNo);
+  place(part, h, file->id(), pageNo, frameNo);
 }
 
-void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
+void BufHashTbl::place(hashPartition& part, const std::uint64_t h, const FileId fileId, const PageId pageNo,
+                       const FrameId frameNo)
 {
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+  // keep the load factor under 7/8
+  if ((part.count + 1) * 8 > (part.mask + 1) * 7)
+    grow(part);
+
+  hashSlot entry;
+  entry.fileId = fileId;
+  entry.pageNo = pageNo;
+  entry.frameNo = frameNo;
+  entry.dist = 0;
+
+  std::uint32_t index = (std::uint32_t) h & part.mask;
+  for (;;)
+  {
+    hashSlot& slot = part.slots[index];
+    if (slot.fileId == File::INVALID_ID)
     {
-      frameNo = tmpBuc->frameNo; // return frameNo by reference
+      slot = entry;
+      part.count++;
       return;
     }
-    tmpBuc = tmpBuc->next;
+    // steal the slot from an entry closer to its home and carry that one on
+    if (slot.dist < entry.dist)
+    {
+      hashSlot tmp = slot;
+      slot = entry;
+      entry = tmp;
+    }
+    entry.dist++;
+    index = (index + 1) & part.mask;
   }
-
-  throw HashNotFoundException(file->filename(), pageNo);
 }
 
-void BufHashTbl::remove(const File* file, const PageId pageNo) {
+bool BufHashTbl::tryLookup(const File* file, const PageId pageNo, FrameId &frameNo) const
+{
+  const std::uint64_t h = hash(file->id(), pageNo);
+  const hashPartition& part = partitions[partitionOf(h)];
 
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  hashBucket* prevBuc = NULL;
+  long index = find(part, h, file->id(), pageNo);
+  if (index < 0)
+    return false;
 
-  while (tmpBuc)
-	{
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-		{
-      if(prevBuc) 
-				prevBuc->next = tmpBuc->next;
-      else
-				ht[index] = tmpBuc->next;
+  frameNo = part.slots[index].frameNo; // return frameNo by reference
+  return true;
+}
 
-      delete tmpBuc;
-      return;
-    }
-		else
-		{
-      prevBuc = tmpBuc;
-      tmpBuc = tmpBuc->next;
-    }
-  }
+void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo)
+{
+  if (!tryLookup(file, pageNo, frameNo))
+    throw HashNotFoundException(file->filename(), pageNo);
+}
 
-  throw HashNotFoundException(file->filename(), pageNo);
+void BufHashTbl::remove(const File* file, const PageId pageNo) {
+
+  const std::uint64_t h = hash(file->id(), pageNo);
+  hashPartition& part = partitions[partitionOf(h)];
+
+  long found = find(part, h, file->id(), pageNo);
+  if (found < 0)
+    throw HashNotFoundException(file->filename(), pageNo);
+
+  // backward-shift the following entries of the run instead of leaving a tombstone
+  std::uint32_t index = (std::uint32_t) found;
+  for (;;)
+  {
+    std::uint32_t next = (index + 1) & part.mask;
+    hashSlot& nextSlot = part.slots[next];
+    if (nextSlot.fileId == File::INVALID_ID || nextSlot.dist == 0)
+      break;
+    part.slots[index] = nextSlot;
+    part.slots[index].dist--;
+    index = next;
+  }
+  part.slots[index].fileId = File::INVALID_ID;
+  part.count--;
 }
 
 }
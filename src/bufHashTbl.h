@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <cstdint>
+#include <mutex>
 #include "file.h"
 
 namespace badgerdb {
@@ -14,11 +16,11 @@ namespace badgerdb {
 /**
 * @brief Declarations for buffer pool hash table
 */
-struct hashBucket {
+struct hashSlot {
 	/**
-	 * pointer a file object (more on this below)
+	 * id of the file; File::INVALID_ID if the slot is empty
 	 */
-	File *file;
+	FileId fileId;
 
 	/**
 	 * page number within a file
@@ -31,49 +33,135 @@ struct hashBucket {
 	FrameId frameNo;
 
 	/**
-	 * Next node in the hash table
+	 * Distance of the entry from its home slot (Robin Hood probe length)
 	 */
-	hashBucket*   next;
+	std::uint32_t dist;
+};
+
+/**
+* @brief One latch partition of the hash table: an open-addressing array of slots
+*/
+struct hashPartition {
+	/**
+	 * Slot array, a power of two in size
+	 */
+	hashSlot* slots;
+
+	/**
+	 * Number of slots minus one
+	 */
+	std::uint32_t mask;
+
+	/**
+	 * Number of occupied slots
+	 */
+	std::uint32_t count;
 };
 
 
 /**
 * @brief Hash table class to keep track of pages in the buffer pool
 *
-* @warning This class is not threadsafe.
+* Entries live in flat open-addressing arrays using Robin Hood probing with backward-shift
+* deletion, so inserting and removing a page never allocates. The key is mixed with a
+* 64-bit finalizer; its top bits pick one of NUM_PARTITIONS partitions and its low bits
+* the home slot inside that partition.
+*
+* Pages are keyed by the id() of their file, so all File objects of one file find the same
+* entries; the File objects passed in only give the id and the name for error messages.
+*
+* Each partition is guarded by its own latch. insert(), lookup() and remove() do not take
+* the latch themselves: callers must hold the latch returned by latch() for the
+* (file, pageNo) they operate on, so that a lookup and the pin that follows it happen
+* atomically with respect to eviction.
 */
 class BufHashTbl
 {
- private:
-	/**
-	 *	Size of Hash Table
-	 */
-  int HTSIZE;
+ public:
 	/**
-	 * Actual Hash table object
+	 * Number of latch partitions the slots are split into
 	 */
-  hashBucket**  ht;
+	static const int NUM_PARTITIONS = 16;
 
 	/**
-	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
+	 * returns a well mixed 64-bit hash of (file, pageNo)
 	 *
-	 * @param file   	File object
+	 * @param fileId 	Id of the file
 	 * @param pageNo  Page number in the file
 	 * @return  			Hash value.
 	 */
-  int	 hash(const File* file, const PageId pageNo);
+	static std::uint64_t hash(const FileId fileId, const PageId pageNo)
+	{
+		std::uint64_t h = ((std::uint64_t) fileId * 0x9e3779b97f4a7c15ULL) ^ ((std::uint64_t) pageNo << 32 | pageNo);
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		return h;
+	}
+
+ private:
+	/**
+	 * Partitions of the table
+	 */
+	hashPartition partitions[NUM_PARTITIONS];
+
+	/**
+	 * Latches guarding the partitions
+	 */
+	std::mutex latches[NUM_PARTITIONS];
+
+	/**
+	 * Returns the partition index for a hash value
+	 */
+	static int partitionOf(const std::uint64_t h)
+	{
+		return (int) (h >> 60) % NUM_PARTITIONS;
+	}
+
+	/**
+	 * Returns the slot holding (file, pageNo) in the partition, or -1 if absent
+	 */
+	long find(const hashPartition& part, const std::uint64_t h, const FileId fileId, const PageId pageNo) const;
+
+	/**
+	 * Doubles the size of a partition. Only happens when the pages in the pool are badly
+	 * skewed towards one partition.
+	 */
+	void grow(hashPartition& part);
+
+	/**
+	 * Inserts an entry known to be absent from a partition, growing it if needed.
+	 */
+	void place(hashPartition& part, const std::uint64_t h, const FileId fileId, const PageId pageNo,
+	           const FrameId frameNo);
 
  public:
 	/**
    * Constructor of BufHashTbl class
+	 *
+	 * @param numBufs	Number of frames in the buffer pool; the table is sized to keep the load under one half
 	 */
-	BufHashTbl(const int htSize);  // constructor
+	BufHashTbl(const std::uint32_t numBufs);  // constructor
 
 	/**
    * Destructor of BufHashTbl class
 	 */
   ~BufHashTbl(); // destructor
-	
+
+	/**
+	 * Returns the latch of the partition holding (file, pageNo).
+	 *
+	 * @param file   	File object
+	 * @param pageNo 	Page number in the file
+	 * @return  			Partition latch which must be held while operating on that entry.
+	 */
+	std::mutex& latch(const File* file, const PageId pageNo)
+	{
+		return latches[partitionOf(hash(file->id(), pageNo))];
+	}
+
 	/**
    * Insert entry into hash table mapping (file, pageNo) to frameNo.
 	 *
@@ -81,7 +169,6 @@ class BufHashTbl
 	 * @param pageNo 	Page number in the file
 	 * @param frameNo Frame number assigned to that page of the file
    * @throws  HashAlreadyPresentException	if the corresponding page already exists in the hash table
-   * @throws  HashTableException (optional) if could not create a new bucket as running of memory
 	 */
   void insert(const File* file, const PageId pageNo, const FrameId frameNo);
 
@@ -92,18 +179,28 @@ class BufHashTbl
 	 * @param file  	File object
 	 * @param pageNo	Page number in the file
 	 * @param frameNo Frame number reference
-   * @throws HashNotFoundException if the page entry is not found in the hash table 
+   * @throws HashNotFoundException if the page entry is not found in the hash table
 	 */
   void lookup(const File* file, const PageId pageNo, FrameId &frameNo);
 
+	/**
+   * Check if (file, pageNo) is currently in the buffer pool, without throwing on a miss.
+	 *
+	 * @param file  	File object
+	 * @param pageNo	Page number in the file
+	 * @param frameNo Frame number reference, only set if the page is found
+	 * @return  			True if the page is in the hash table.
+	 */
+  bool tryLookup(const File* file, const PageId pageNo, FrameId &frameNo) const;
+
 	/**
    * Delete entry (file,pageNo) from hash table.
 	 *
 	 * @param file   	File object
 	 * @param pageNo  Page number in the file
-   * @throws HashNotFoundException if the page entry is not found in the hash table 
+   * @throws HashNotFoundException if the page entry is not found in the hash table
 	 */
-  void remove(const File* file, const PageId pageNo);  
+  void remove(const File* file, const PageId pageNo);
 };
 
 }
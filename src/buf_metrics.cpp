@@ -0,0 +1,291 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstdio>
+#include <map>
+#include <sstream>
+#include "buf_metrics.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Largest value counted in a Log2Histogram bucket
+ */
+std::uint64_t bucketBound(const int bucket)
+{
+  return bucket == 0 ? 0 : (((std::uint64_t) 1 << bucket) - 1);
+}
+
+std::string escapeJson(const std::string& in)
+{
+  std::string out;
+  for (std::size_t i = 0; i < in.size(); i++)
+  {
+    const char c = in[i];
+    if (c == '"' || c == '\\')
+    {
+      out += '\\';
+      out += c;
+    }
+    else if ((unsigned char) c < 0x20)
+    {
+      char code[8];
+      std::snprintf(code, sizeof(code), "\\u%04x", c);
+      out += code;
+    }
+    else
+      out += c;
+  }
+  return out;
+}
+
+std::string escapeLabel(const std::string& in)
+{
+  std::string out;
+  for (std::size_t i = 0; i < in.size(); i++)
+  {
+    if (in[i] == '"' || in[i] == '\\')
+      out += '\\';
+    if (in[i] == '\n')
+      out += "\\n";
+    else
+      out += in[i];
+  }
+  return out;
+}
+
+void jsonHistogram(std::ostringstream& out, const char* name, const HistogramSnapshot& hist)
+{
+  out << "  \"" << name << "\": {\"count\": " << hist.count() << ", \"sum\": " << hist.sum
+      << ", \"p50\": " << hist.quantile(0.5) << ", \"p99\": " << hist.quantile(0.99)
+      << ", \"buckets\": [";
+  // only buckets in use, as [largest value, count] pairs
+  bool first = true;
+  for (int i = 0; i < Log2Histogram::NUM_BUCKETS; i++)
+  {
+    if (hist.buckets[i] == 0)
+      continue;
+    out << (first ? "" : ", ") << "[" << bucketBound(i) << ", " << hist.buckets[i] << "]";
+    first = false;
+  }
+  out << "]}";
+}
+
+void promHeader(std::ostringstream& out, const char* name, const char* type, const char* help)
+{
+  out << "# HELP " << name << " " << help << "\n";
+  out << "# TYPE " << name << " " << type << "\n";
+}
+
+void promValue(std::ostringstream& out, const char* name, const char* type, const char* help, const double value)
+{
+  promHeader(out, name, type, help);
+  out << name << " " << value << "\n";
+}
+
+void promHistogram(std::ostringstream& out, const char* name, const char* help,
+                   const HistogramSnapshot& hist, const double scale)
+{
+  promHeader(out, name, "histogram", help);
+  std::uint64_t cumulative = 0;
+  for (int i = 0; i < Log2Histogram::NUM_BUCKETS - 1; i++)
+  {
+    cumulative += hist.buckets[i];
+    out << name << "_bucket{le=\"" << bucketBound(i) * scale << "\"} " << cumulative << "\n";
+  }
+  out << name << "_bucket{le=\"+Inf\"} " << hist.count() << "\n";
+  out << name << "_sum " << hist.sum * scale << "\n";
+  out << name << "_count " << hist.count() << "\n";
+}
+
+}
+
+std::uint64_t HistogramSnapshot::count() const
+{
+  std::uint64_t total = 0;
+  for (std::size_t i = 0; i < buckets.size(); i++)
+    total += buckets[i];
+  return total;
+}
+
+std::uint64_t HistogramSnapshot::quantile(const double q) const
+{
+  const std::uint64_t total = count();
+  if (total == 0)
+    return 0;
+
+  std::uint64_t cumulative = 0;
+  for (std::size_t i = 0; i < buckets.size(); i++)
+  {
+    cumulative += buckets[i];
+    if (cumulative >= q * total)
+      return bucketBound(i);
+  }
+  return bucketBound(buckets.size() - 1);
+}
+
+std::string BufMetricsSnapshot::format(const MetricsFormat fmt) const
+{
+  std::ostringstream out;
+  out.precision(12);
+  const std::uint64_t accesses = hits + misses;
+  const double hitRatio = accesses == 0 ? 0.0 : (double) hits / accesses;
+
+  if (fmt == METRICS_JSON)
+  {
+    out << "{\n";
+    out << "  \"policy\": \"" << escapeJson(policyName) << "\",\n";
+    out << "  \"frames\": " << frames << ",\n";
+    out << "  \"valid_frames\": " << validFrames << ",\n";
+    out << "  \"dirty_frames\": " << dirtyFrames << ",\n";
+    out << "  \"dirty_ratio\": " << dirtyRatio() << ",\n";
+    out << "  \"pinned_frames\": " << pinnedFrames << ",\n";
+    out << "  \"pinned_high_water\": " << pinnedHighWater << ",\n";
+    out << "  \"hits\": " << hits << ",\n";
+    out << "  \"misses\": " << misses << ",\n";
+    out << "  \"hit_ratio\": " << hitRatio << ",\n";
+    out << "  \"clean_evictions\": " << cleanEvictions << ",\n";
+    out << "  \"dirty_evictions\": " << dirtyEvictions << ",\n";
+    out << "  \"buffer_exceeded\": " << bufferExceeded << ",\n";
+    jsonHistogram(out, "read_latency_ns", readLatency);
+    out << ",\n";
+    jsonHistogram(out, "write_latency_ns", writeLatency);
+    out << ",\n";
+    jsonHistogram(out, "eviction_sweep_frames", sweepLength);
+    out << ",\n";
+    out << "  \"files\": [";
+    for (std::size_t i = 0; i < files.size(); i++)
+    {
+      out << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << escapeJson(files[i].filename)
+          << "\", \"hits\": " << files[i].hits << ", \"misses\": " << files[i].misses << "}";
+    }
+    out << (files.empty() ? "]\n" : "\n  ]\n");
+    out << "}\n";
+    return out.str();
+  }
+
+  promValue(out, "badgerdb_buffer_frames", "gauge", "Frames in the buffer pool.", frames);
+  promValue(out, "badgerdb_buffer_valid_frames", "gauge", "Frames holding a page.", validFrames);
+  promValue(out, "badgerdb_buffer_dirty_frames", "gauge", "Frames holding a dirty page.", dirtyFrames);
+  promValue(out, "badgerdb_buffer_dirty_ratio", "gauge", "Fraction of frames holding a dirty page.", dirtyRatio());
+  promValue(out, "badgerdb_buffer_pinned_frames", "gauge", "Frames pinned.", pinnedFrames);
+  promValue(out, "badgerdb_buffer_pinned_high_water", "gauge", "Most frames pinned at once.", pinnedHighWater);
+  promValue(out, "badgerdb_buffer_hits_total", "counter", "Accesses served from the pool.", hits);
+  promValue(out, "badgerdb_buffer_misses_total", "counter", "Accesses which brought the page into a frame.", misses);
+  promHeader(out, "badgerdb_buffer_evictions_total", "counter", "Pages evicted, by whether they had to be written first.");
+  out << "badgerdb_buffer_evictions_total{state=\"clean\"} " << cleanEvictions << "\n";
+  out << "badgerdb_buffer_evictions_total{state=\"dirty\"} " << dirtyEvictions << "\n";
+  promValue(out, "badgerdb_buffer_exceeded_total", "counter", "Accesses refused because every frame stayed pinned.", bufferExceeded);
+  promHistogram(out, "badgerdb_buffer_read_latency_seconds", "Page read latency.", readLatency, 1e-9);
+  promHistogram(out, "badgerdb_buffer_write_latency_seconds", "Page write latency.", writeLatency, 1e-9);
+  promHistogram(out, "badgerdb_buffer_eviction_sweep_frames", "Frames examined to find each victim.", sweepLength, 1);
+  promHeader(out, "badgerdb_buffer_file_hits_total", "counter", "Accesses served from the pool, per file.");
+  for (std::size_t i = 0; i < files.size(); i++)
+    out << "badgerdb_buffer_file_hits_total{file=\"" << escapeLabel(files[i].filename) << "\"} " << files[i].hits << "\n";
+  promHeader(out, "badgerdb_buffer_file_misses_total", "counter", "Accesses which brought the page into a frame, per file.");
+  for (std::size_t i = 0; i < files.size(); i++)
+    out << "badgerdb_buffer_file_misses_total{file=\"" << escapeLabel(files[i].filename) << "\"} " << files[i].misses << "\n";
+  return out.str();
+}
+
+BufMetrics::BufMetrics()
+  : enabled(true), pinnedFrames(0), pinnedHighWater(0)
+{
+  clear();
+}
+
+BufMetrics::~BufMetrics()
+{
+  for (std::map<std::string, FileCounts*>::iterator it = files.begin(); it != files.end(); ++it)
+    delete it->second;
+}
+
+int BufMetrics::threadShard()
+{
+  static std::atomic<int> nextShard(0);
+  static thread_local int index = nextShard.fetch_add(1) % NUM_SHARDS;
+  return index;
+}
+
+BufMetrics::FileCounts* BufMetrics::fileCounts(const File* file)
+{
+  std::lock_guard<std::mutex> guard(filesLatch);
+  FileCounts*& counts = files[file->filename()];
+  if (counts == NULL)
+  {
+    counts = new FileCounts();
+    counts->filename = file->filename();
+    for (int i = 0; i < NUM_SHARDS; i++)
+      counts->stripes[i].hits = counts->stripes[i].misses = 0;
+  }
+  return counts;
+}
+
+void BufMetrics::collect(BufMetricsSnapshot& out) const
+{
+  out.hits = out.misses = 0;
+  out.cleanEvictions = out.dirtyEvictions = 0;
+  out.bufferExceeded = 0;
+  out.readLatency.buckets.assign(Log2Histogram::NUM_BUCKETS, 0);
+  out.writeLatency.buckets.assign(Log2Histogram::NUM_BUCKETS, 0);
+  out.sweepLength.buckets.assign(Log2Histogram::NUM_BUCKETS, 0);
+  out.readLatency.sum = out.writeLatency.sum = out.sweepLength.sum = 0;
+  out.pinnedHighWater = pinnedHighWater.load();
+
+  for (int i = 0; i < NUM_SHARDS; i++)
+  {
+    const Shard& s = shards[i];
+    out.hits += s.hits.load(std::memory_order_relaxed);
+    out.misses += s.misses.load(std::memory_order_relaxed);
+    out.cleanEvictions += s.cleanEvictions.load(std::memory_order_relaxed);
+    out.dirtyEvictions += s.dirtyEvictions.load(std::memory_order_relaxed);
+    out.bufferExceeded += s.bufferExceeded.load(std::memory_order_relaxed);
+    s.readLatency.addTo(out.readLatency.buckets, out.readLatency.sum);
+    s.writeLatency.addTo(out.writeLatency.buckets, out.writeLatency.sum);
+    s.sweepLength.addTo(out.sweepLength.buckets, out.sweepLength.sum);
+  }
+
+  // files come sorted by name
+  out.files.clear();
+  std::lock_guard<std::mutex> guard(filesLatch);
+  for (std::map<std::string, FileCounts*>::const_iterator it = files.begin(); it != files.end(); ++it)
+  {
+    FileMetrics merged = { it->first, 0, 0 };
+    for (int i = 0; i < NUM_SHARDS; i++)
+    {
+      merged.hits += it->second->stripes[i].hits.load(std::memory_order_relaxed);
+      merged.misses += it->second->stripes[i].misses.load(std::memory_order_relaxed);
+    }
+    out.files.push_back(merged);
+  }
+}
+
+void BufMetrics::clear()
+{
+  for (int i = 0; i < NUM_SHARDS; i++)
+  {
+    Shard& s = shards[i];
+    s.hits = s.misses = 0;
+    s.cleanEvictions = s.dirtyEvictions = 0;
+    s.bufferExceeded = 0;
+    s.readLatency.clear();
+    s.writeLatency.clear();
+    s.sweepLength.clear();
+  }
+  // the slots stay, BufMgr holds on to them
+  std::lock_guard<std::mutex> guard(filesLatch);
+  for (std::map<std::string, FileCounts*>::iterator it = files.begin(); it != files.end(); ++it)
+  {
+    for (int i = 0; i < NUM_SHARDS; i++)
+      it->second->stripes[i].hits = it->second->stripes[i].misses = 0;
+  }
+  pinnedHighWater = pinnedFrames.load();
+}
+
+}
@@ -0,0 +1,416 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "file.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Text formats the buffer pool metrics can be exported in.
+ */
+enum MetricsFormat
+{
+	METRICS_JSON = 0,	/* one JSON object */
+	METRICS_PROMETHEUS = 1	/* Prometheus text exposition format */
+};
+
+/**
+ * @brief Histogram with power-of-two buckets. Bucket i counts values v with
+ * 2^(i-1) <= v < 2^i; bucket 0 counts zeros and the last bucket everything above.
+ */
+class Log2Histogram
+{
+ public:
+	/**
+	 * Number of buckets
+	 */
+	static const int NUM_BUCKETS = 40;
+
+	Log2Histogram()
+	{
+		clear();
+	}
+
+	/**
+	 * Counts one value.
+	 */
+	void record(const std::uint64_t value)
+	{
+		int bucket = 0;
+		for (std::uint64_t v = value; v != 0 && bucket < NUM_BUCKETS - 1; v >>= 1)
+			bucket++;
+		buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+		sum.fetch_add(value, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Adds the counts of this histogram to a plain array of NUM_BUCKETS counts.
+	 */
+	void addTo(std::vector<std::uint64_t>& counts, std::uint64_t& total) const
+	{
+		for (int i = 0; i < NUM_BUCKETS; i++)
+			counts[i] += buckets[i].load(std::memory_order_relaxed);
+		total += sum.load(std::memory_order_relaxed);
+	}
+
+	void clear()
+	{
+		for (int i = 0; i < NUM_BUCKETS; i++)
+			buckets[i] = 0;
+		sum = 0;
+	}
+
+ private:
+	std::atomic<std::uint64_t> buckets[NUM_BUCKETS];
+	std::atomic<std::uint64_t> sum;
+};
+
+/**
+ * @brief Point-in-time copy of a histogram.
+ */
+struct HistogramSnapshot
+{
+	/**
+	 * Count per bucket, Log2Histogram::NUM_BUCKETS of them
+	 */
+	std::vector<std::uint64_t> buckets;
+
+	/**
+	 * Sum of all recorded values
+	 */
+	std::uint64_t sum;
+
+	/**
+	 * Number of recorded values
+	 */
+	std::uint64_t count() const;
+
+	/**
+	 * Upper bound of the bucket holding the given quantile (0..1), 0 if empty
+	 */
+	std::uint64_t quantile(const double q) const;
+};
+
+/**
+ * @brief Hit and miss counts of one file.
+ */
+struct FileMetrics
+{
+	std::string filename;
+	std::uint64_t hits;
+	std::uint64_t misses;
+};
+
+/**
+ * @brief Point-in-time copy of all buffer pool metrics, as collected by BufMgr::collectMetrics().
+ */
+struct BufMetricsSnapshot
+{
+	/**
+	 * Replacement policy of the pool
+	 */
+	std::string policyName;
+
+	/**
+	 * Number of frames in the pool
+	 */
+	std::uint32_t frames;
+
+	/**
+	 * Frames holding a page, dirty ones and pinned ones at the time of the snapshot
+	 */
+	std::uint32_t validFrames;
+	std::uint32_t dirtyFrames;
+	std::uint32_t pinnedFrames;
+
+	/**
+	 * Most frames ever pinned at once
+	 */
+	std::uint32_t pinnedHighWater;
+
+	/**
+	 * Accesses served from the pool and accesses which brought the page in
+	 */
+	std::uint64_t hits;
+	std::uint64_t misses;
+
+	/**
+	 * Pages evicted to make room, split by whether they had to be written first
+	 */
+	std::uint64_t cleanEvictions;
+	std::uint64_t dirtyEvictions;
+
+	/**
+	 * Misses which gave up because every frame stayed pinned
+	 */
+	std::uint64_t bufferExceeded;
+
+	/**
+	 * Page read and write latency in nanoseconds
+	 */
+	HistogramSnapshot readLatency;
+	HistogramSnapshot writeLatency;
+
+	/**
+	 * Frames the replacement policy looked at to find each victim
+	 */
+	HistogramSnapshot sweepLength;
+
+	/**
+	 * Per file hits and misses, sorted by file name
+	 */
+	std::vector<FileMetrics> files;
+
+	/**
+	 * Fraction of the frames holding a dirty page
+	 */
+	double dirtyRatio() const
+	{
+		return frames == 0 ? 0.0 : (double) dirtyFrames / frames;
+	}
+
+	/**
+	 * Renders the snapshot in the given format.
+	 */
+	std::string format(const MetricsFormat fmt) const;
+};
+
+/**
+ * @brief Counters behind BufMgr's metrics.
+ *
+ * Counters are striped over NUM_SHARDS padded shards and every thread updates
+ * the shard it was assigned on first use, so the hot path only touches memory no other
+ * thread writes to in the common case. Reading the metrics adds up the shards. The only
+ * shared counter is the pinned-frame gauge behind the high-water mark, which changes
+ * when a frame goes from unpinned to pinned and back.
+ *
+ * Per file counts are kept in one slot per file name, so reopened files count together.
+ * BufMgr looks the slot up once, when a partition opens its File object for the file, and
+ * keeps it with the file's frames, so a hit or miss counts without a lookup or a latch.
+ *
+ * Recording can be switched off, e.g. to measure what it costs; the pinned-frame gauge
+ * is kept up either way so that it is right when recording is switched back on.
+ */
+class BufMetrics
+{
+ public:
+	/**
+	 * Number of counter shards
+	 */
+	static const int NUM_SHARDS = 16;
+
+	/**
+	 * Hit and miss counts of one file, striped over the shards like the pool counters
+	 */
+	struct FileCounts
+	{
+		struct Stripe
+		{
+			std::atomic<std::uint64_t> hits;
+			std::atomic<std::uint64_t> misses;
+			char padding[64 - 2 * sizeof(std::atomic<std::uint64_t>)];
+		};
+
+		std::string filename;
+		Stripe stripes[NUM_SHARDS];
+	};
+
+	BufMetrics();
+
+	~BufMetrics();
+
+	/**
+	 * Counts of the given file, created the first time a file of that name is seen. The
+	 * slot stays valid for the lifetime of the metrics, clear() included.
+	 *
+	 * @param file	File object of the file
+	 */
+	FileCounts* fileCounts(const File* file);
+
+	/**
+	 * Switches recording on or off. Counts so far are kept.
+	 */
+	void setEnabled(const bool on)
+	{
+		enabled.store(on, std::memory_order_relaxed);
+	}
+
+	/**
+	 * An access found its page in the pool.
+	 *
+	 * @param counts	Slot of the page's file, from fileCounts()
+	 */
+	void recordHit(FileCounts* counts)
+	{
+		if (!enabled.load(std::memory_order_relaxed))
+			return;
+		const int i = threadShard();
+		shards[i].hits.fetch_add(1, std::memory_order_relaxed);
+		counts->stripes[i].hits.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/**
+	 * An access brought its page into a frame.
+	 *
+	 * @param counts	Slot of the page's file, from fileCounts()
+	 */
+	void recordMiss(FileCounts* counts)
+	{
+		if (!enabled.load(std::memory_order_relaxed))
+			return;
+		const int i = threadShard();
+		shards[i].misses.fetch_add(1, std::memory_order_relaxed);
+		counts->stripes[i].misses.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/**
+	 * A resident page was evicted.
+	 *
+	 * @param dirty	True if it was written out first
+	 */
+	void recordEviction(const bool dirty)
+	{
+		if (!enabled.load(std::memory_order_relaxed))
+			return;
+		Shard& s = shard();
+		(dirty ? s.dirtyEvictions : s.cleanEvictions).fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/**
+	 * The replacement policy looked at this many frames to find a victim.
+	 */
+	void recordSweep(const std::uint32_t examined)
+	{
+		if (!enabled.load(std::memory_order_relaxed))
+			return;
+		shard().sweepLength.record(examined);
+	}
+
+	/**
+	 * A caller gave up waiting for a frame.
+	 */
+	void recordBufferExceeded()
+	{
+		if (!enabled.load(std::memory_order_relaxed))
+			return;
+		shard().bufferExceeded.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/**
+	 * A page read of the given duration.
+	 */
+	void recordRead(const std::chrono::steady_clock::duration elapsed)
+	{
+		if (!enabled.load(std::memory_order_relaxed))
+			return;
+		shard().readLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+	}
+
+	/**
+	 * A page write of the given duration.
+	 */
+	void recordWrite(const std::chrono::steady_clock::duration elapsed)
+	{
+		if (!enabled.load(std::memory_order_relaxed))
+			return;
+		shard().writeLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+	}
+
+	/**
+	 * A frame went from unpinned to pinned.
+	 */
+	void notePinned()
+	{
+		const std::uint32_t now = pinnedFrames.fetch_add(1, std::memory_order_relaxed) + 1;
+		std::uint32_t high = pinnedHighWater.load(std::memory_order_relaxed);
+		while (now > high && !pinnedHighWater.compare_exchange_weak(high, now, std::memory_order_relaxed))
+			;
+	}
+
+	/**
+	 * A frame went from pinned to unpinned.
+	 */
+	void noteUnpinned()
+	{
+		pinnedFrames.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Adds up the shards into the counter fields of a snapshot.
+	 */
+	void collect(BufMetricsSnapshot& out) const;
+
+	/**
+	 * Resets every counter. The high-water mark restarts from the frames pinned right now.
+	 */
+	void clear();
+
+ private:
+	/**
+	 * Counters updated by the threads assigned to one shard
+	 */
+	struct Shard
+	{
+		std::atomic<std::uint64_t> hits;
+		std::atomic<std::uint64_t> misses;
+		std::atomic<std::uint64_t> cleanEvictions;
+		std::atomic<std::uint64_t> dirtyEvictions;
+		std::atomic<std::uint64_t> bufferExceeded;
+		Log2Histogram readLatency;
+		Log2Histogram writeLatency;
+		Log2Histogram sweepLength;
+
+		/**
+		 * Keeps the counters of neighbouring shards off each other's cache lines
+		 */
+		char padding[64];
+	};
+
+	/**
+	 * Shard of the calling thread
+	 */
+	Shard& shard()
+	{
+		return shards[threadShard()];
+	}
+
+	/**
+	 * Index of the calling thread's shard, assigned round robin on first use
+	 */
+	static int threadShard();
+
+	Shard shards[NUM_SHARDS];
+
+	/**
+	 * Slots of the files seen so far, by file name. Only taken when a slot is looked up and
+	 * while the metrics are read or cleared.
+	 */
+	mutable std::mutex filesLatch;
+	std::map<std::string, FileCounts*> files;
+
+	/**
+	 * False while recording is switched off
+	 */
+	std::atomic<bool> enabled;
+
+	/**
+	 * Frames pinned right now, and the most ever pinned at once
+	 */
+	std::atomic<std::uint32_t> pinnedFrames;
+	std::atomic<std::uint32_t> pinnedHighWater;
+};
+
+}
@@ -5,246 +5,1982 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <map>
 #include <memory>
 #include <iostream>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
 #include "buffer.h"
+#include "exceptions/badgerdb_exception.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
 #include "exceptions/hash_not_found_exception.h"
 
-namespace badgerdb { 
+namespace badgerdb {
+
+namespace {
+
+/**
+ * First line of a buffer pool snapshot file, naming the format and its version
+ */
+const char* const SNAPSHOT_HEADER = "badgerdb buffer snapshot 1";
+
+/**
+ * Reads the first number in a file; returns 0 if the file is missing or holds no number
+ * (such as the "max" of an unlimited cgroup v2 memory.max).
+ */
+std::uint64_t readLimitFile(const std::string& path)
+{
+  std::ifstream in(path.c_str());
+  std::uint64_t value = 0;
+  if (!(in >> value))
+    return 0;
+  return value;
+}
+
+/**
+ * Number of frames partition i of n gets when total frames are shared out evenly
+ */
+std::uint32_t partitionShare(const std::uint32_t total, const std::uint32_t n, const std::uint32_t i)
+{
+  return total / n + (i < total % n ? 1 : 0);
+}
+
+}
+
+const int BufMgr::SHRINK_PIN_WAIT_MS;
+const int BufMgr::COMMIT_PIN_WAIT_MS;
+const std::uint32_t BufMgr::MAX_KEPT_PERCENT;
+const std::uint32_t FrameStateTable::WORD_BITS;
+
+FrameStateTable::FrameStateTable(const std::uint32_t frames)
+{
+  // each array starts on a cache line of its own
+  const std::size_t words = ((std::size_t) frames + WORD_BITS - 1) / WORD_BITS;
+  const std::size_t bitmapBytes = (words * sizeof(std::uint64_t) + 63) / 64 * 64;
+  regionSize = 4 * bitmapBytes + (std::size_t) frames * sizeof(std::atomic<int>);
+  region = mmap(NULL, regionSize, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (region == MAP_FAILED)
+    throw std::bad_alloc();
+  // the mapping comes zeroed, which is all five arrays' initial state
+  validBits = (std::atomic<std::uint64_t>*) region;
+  refBits = (std::atomic<std::uint64_t>*) ((char*) region + bitmapBytes);
+  keepBits = (std::atomic<std::uint64_t>*) ((char*) region + 2 * bitmapBytes);
+  soonBits = (std::atomic<std::uint64_t>*) ((char*) region + 3 * bitmapBytes);
+  pins = (std::atomic<int>*) ((char*) region + 4 * bitmapBytes);
+  keptFrames = 0;
+}
+
+FrameStateTable::~FrameStateTable()
+{
+  munmap(region, regionSize);
+}
 
 //----------------------------------------
 // Constructor of the class BufMgr
 //----------------------------------------
 
-BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
-	bufDescTable = new BufDesc[bufs];
+BufMgr::BufMgr(std::uint32_t bufs, ReplacementPolicyType policyType, PoolMemory memory,
+               std::uint32_t maxFrames, std::uint32_t numPartitions)
+	: numBufs(bufs), nextAllocPartition(0), unpinEpoch(0), frameWaiters(0), pinWaitTimeout(10000),
+	  writerStop(false), durability(DURABILITY_NONE), writerLookahead(0), writerInterval(20),
+	  exportStop(false), exportFormat(METRICS_JSON), exportInterval(10000),
+	  autoResizeStop(false), autoResizeFraction(0.5), autoResizeInterval(5000),
+	  prefetchStop(false), numPrefetchWorkers(DEFAULT_PREFETCH_WORKERS) {
+  // every partition needs a frame
+  if (numPartitions < 1)
+    numPartitions = 1;
+  if (numPartitions > bufs)
+    numPartitions = bufs;
+
+  // by default leave room to grow to all of physical memory; it is only address space
+  // until frames are used
+  if (maxFrames == 0)
+  {
+    const std::uint64_t physical = (std::uint64_t) sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+    const std::uint64_t frames = physical / sizeof(Page);
+    maxFrames = frames > 0xffffffffULL ? 0xffffffffU : (std::uint32_t) frames;
+  }
+  if (maxFrames < bufs)
+    maxFrames = bufs;
+  partitionStride = (std::uint32_t) (((std::uint64_t) maxFrames + numPartitions - 1) / numPartitions);
+  maxBufs = partitionStride * numPartitions;
+
+  allocPool(memory, numPartitions);
+
+  descRegionSize = (std::size_t) maxBufs * sizeof(BufDesc);
+  descRegion = mmap(NULL, descRegionSize, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (descRegion == MAP_FAILED)
+    throw std::bad_alloc();
+	bufDescTable = (BufDesc*) descRegion;
+  frameStates = new FrameStateTable(maxBufs);
 
-  for (FrameId i = 0; i < bufs; i++) 
+  // partition p holds frames p * partitionStride onwards; frames past its share stay unused
+  for (std::uint32_t p = 0; p < numPartitions; p++)
   {
-  	bufDescTable[i].frameNo = i;
-  	bufDescTable[i].valid = false;
+    const FrameId first = p * partitionStride;
+    const std::uint32_t share = partitionShare(bufs, numPartitions, p);
+    for (FrameId i = first; i < first + share; i++)
+    {
+      new (&bufDescTable[i]) BufDesc();
+      bufDescTable[i].frameNo = i;
+      new (&bufPool[i]) Page();
+    }
+    partitions.push_back(new BufPartition(first, share, partitionStride, frameStates, policyType));
   }
+  bufStats.policyName = partitions[0]->policy->name();
+  File::addCloseListener(this);
+}
+
 
-  bufPool = new Page[bufs];
+void BufMgr::allocPool(const PoolMemory requested, const std::uint32_t numPartitions)
+{
+  const std::size_t hugePage = 2 * 1024 * 1024;
+
+  poolRegion = MAP_FAILED;
+  poolMemory = requested;
+  if (poolMemory == POOL_EXPLICIT_HUGE)
+  {
+    // hugetlb pages are reserved when mapped, so this pool can't grow past its initial size
+    const std::uint32_t stride = (numBufs + numPartitions - 1) / numPartitions;
+    poolRegionSize = ((std::size_t) stride * numPartitions * sizeof(Page) + hugePage - 1) / hugePage * hugePage;
+    poolRegion = mmap(NULL, poolRegionSize, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (poolRegion == MAP_FAILED)
+      poolMemory = POOL_TRANSPARENT_HUGE;
+    else
+    {
+      partitionStride = stride;
+      maxBufs = stride * numPartitions;
+    }
+  }
 
-  int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
-  hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
+  // the mapping covers maxBufs frames; memory is only committed for frames in use
+  const std::size_t bytes = (std::size_t) maxBufs * sizeof(Page);
+  if (poolMemory == POOL_TRANSPARENT_HUGE)
+  {
+    // over-map by one huge page so the pool can start on a 2 MB boundary, then trim
+    const std::size_t rounded = (bytes + hugePage - 1) / hugePage * hugePage;
+    char* raw = (char*) mmap(NULL, rounded + hugePage, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (raw == MAP_FAILED)
+      throw std::bad_alloc();
+    char* aligned = (char*) (((std::uintptr_t) raw + hugePage - 1) / hugePage * hugePage);
+    if (aligned > raw)
+      munmap(raw, aligned - raw);
+    if (raw + rounded + hugePage > aligned + rounded)
+      munmap(aligned + rounded, raw + rounded + hugePage - (aligned + rounded));
+    poolRegion = aligned;
+    poolRegionSize = rounded;
+    madvise(poolRegion, poolRegionSize, MADV_HUGEPAGE);
+  }
+  else if (poolMemory == POOL_DEFAULT)
+  {
+    // page aligned, so frames can take O_DIRECT transfers directly
+    poolRegionSize = bytes;
+    poolRegion = mmap(NULL, poolRegionSize, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (poolRegion == MAP_FAILED)
+      throw std::bad_alloc();
+  }
 
-  clockHand = bufs - 1;
+  bufPool = (Page*) poolRegion;
 }
 
 
 BufMgr::~BufMgr() {
+  File::removeCloseListener(this);
+  stopAutoResize();
+  stopMetricsExport();
+  stopBackgroundWriter();
+  stopPrefetchWorkers();
+
   //Flush out all unwritten pages
-  for (std::uint32_t i = 0; i < numBufs; i++) 
+  for (std::size_t p = 0; p < partitions.size(); p++)
   {
-  	BufDesc* tmpbuf = &bufDescTable[i];
-  	if (tmpbuf->valid == true && tmpbuf->dirty == true)
-		{
-			tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-  	}
+    const BufPartition& part = *partitions[p];
+    for (FrameId i = part.firstFrame; i < part.firstFrame + part.numBufs; i++)
+    {
+      BufDesc* tmpbuf = &bufDescTable[i];
+      if (frameStates->isValid(i) && tmpbuf->dirty == true)
+      {
+        // nobody to report a failed write to from here; write the rest anyway
+        try
+        {
+          writeFrame(i);
+        }
+        catch (BadgerDbException&)
+        {
+        }
+      }
+    }
   }
 
-  delete [] bufDescTable;
-  delete [] bufPool;
+  if (!shutdownSnapshot.empty())
+    saveSnapshot(shutdownSnapshot);
+
+  for (std::size_t p = 0; p < partitions.size(); p++)
+  {
+    BufPartition* part = partitions[p];
+    for (FrameId i = part->firstFrame; i < part->firstFrame + part->constructedBufs; i++)
+      bufDescTable[i].~BufDesc();
+    for (FrameId i = part->firstFrame; i < part->firstFrame + part->numBufs; i++)
+      bufPool[i].~Page();
+    delete part;
+  }
+  munmap(descRegion, descRegionSize);
+  delete frameStates;
+  munmap(poolRegion, poolRegionSize);
 }
 
-void BufMgr::allocBuf(FrameId & frame) 
+
+std::uint32_t BufMgr::resize(std::uint32_t newFrames)
 {
-  // perform first part of clock algorithm to search for 
-  // open buffer frame
-  // Assumes non-concurrent access to buffer manager
-  std::uint32_t numScanned = 0;
-  bool found = 0;
+  std::lock_guard<std::mutex> guard(resizeMutex);
+  const std::uint32_t n = partitions.size();
+  if (newFrames < n)
+    newFrames = n;
+  if (newFrames > maxBufs)
+    newFrames = maxBufs;
 
-  while (numScanned < 2*numBufs)	//Need to scn twice
+  std::uint32_t total = 0;
+  for (std::uint32_t p = 0; p < n; p++)
+    total += resizePartition(*partitions[p], partitionShare(newFrames, n, p));
+  numBufs = total;
+  return total;
+}
+
+
+std::uint32_t BufMgr::resizePartition(BufPartition& part, const std::uint32_t newFrames)
+{
+  const FrameId first = part.firstFrame;
+  const std::uint32_t oldFrames = part.numBufs;
+  if (newFrames > oldFrames)
   {
-    // advance the clock
-    advanceClock();
-    numScanned++;
+    // set up the new frames; frames removed by an earlier shrink are still claimed
+    // by it, so nobody can take them before the policy knows about them
+    for (FrameId i = first + oldFrames; i < first + newFrames; i++)
+    {
+      if (i >= first + part.constructedBufs)
+      {
+        new (&bufDescTable[i]) BufDesc();
+        bufDescTable[i].frameNo = i;
+        frameStates->pinCnt(i) = 1;
+      }
+      new (&bufPool[i]) Page();
+    }
+    if (newFrames > part.constructedBufs)
+      part.constructedBufs = newFrames;
 
-    // if invalid, use frame
-    if (! bufDescTable[clockHand].valid)
+    part.policy->resize(newFrames);
+    part.numBufs = newFrames;
+    for (FrameId i = first + oldFrames; i < first + newFrames; i++)
+      frameStates->pinCnt(i) = 0;
+
+    // wake up anyone waiting for a frame
+    unpinEpoch++;
+    if (frameWaiters.load() > 0)
     {
-      break;
+      std::lock_guard<std::mutex> lock(waitMutex);
+      frameFreed.notify_all();
     }
+    return newFrames;
+  }
 
-    // is valid, check referenced bit
-    if (! bufDescTable[clockHand].refbit)
+  // empty the frames from the top down. Short pins are waited out, but a page pinned for
+  // longer stops the shrink there: it must stay where its user's pointer says. The
+  // background writer is kept out so its pins don't get in the way.
+  std::uint32_t cut = oldFrames;
+  {
+    std::lock_guard<std::mutex> writeBack(writeBackMutex);
+    while (cut > newFrames)
     {
-      // check to see if someone has it pinned
-      if (bufDescTable[clockHand].pinCnt == 0)
+      const FrameId frameNo = first + cut - 1;
+      const std::chrono::steady_clock::time_point deadline =
+          std::chrono::steady_clock::now() + std::chrono::milliseconds(SHRINK_PIN_WAIT_MS);
+      bool evicted = false;
+      while (!evicted && std::chrono::steady_clock::now() < deadline)
       {
-        // hasn't been referenced and is not pinned, use it
-        // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-        found = true;
-        break;
+        if (claimPin(frameNo))
+        {
+          evicted = evictFrame(frameNo);
+          if (!evicted)
+            dropPin(frameNo);
+        }
+        if (!evicted)
+          std::this_thread::yield();
       }
+      if (!evicted)
+        break;
+      cut--;
     }
-    else
+  }
+  if (cut == oldFrames)
+    return oldFrames;
+
+  // the removed frames keep their pin for good, which keeps every other path off them
+  part.policy->resize(cut);
+  part.numBufs = cut;
+  for (FrameId i = first + cut; i < first + oldFrames; i++)
+  {
+    bufPool[i].~Page();
+    metrics.noteUnpinned();
+  }
+
+  // give the memory of the removed frames back
+  const std::size_t osPage = sysconf(_SC_PAGESIZE);
+  const std::uintptr_t from = ((std::uintptr_t) &bufPool[first + cut] + osPage - 1) / osPage * osPage;
+  const std::uintptr_t to = (std::uintptr_t) &bufPool[first + oldFrames] / osPage * osPage;
+  if (to > from)
+    madvise((void*) from, to - from, MADV_DONTNEED);
+  return cut;
+}
+
+
+std::uint64_t BufMgr::cgroupMemoryLimit()
+{
+  // cgroup v2: memory.max of the cgroup this process is in
+  std::ifstream self("/proc/self/cgroup");
+  std::string line;
+  while (std::getline(self, line))
+  {
+    if (line.compare(0, 3, "0::") == 0)
+    {
+      const std::uint64_t limit = readLimitFile("/sys/fs/cgroup" + line.substr(3) + "/memory.max");
+      if (limit > 0)
+        return limit;
+    }
+  }
+  const std::uint64_t v2 = readLimitFile("/sys/fs/cgroup/memory.max");
+  if (v2 > 0)
+    return v2;
+
+  // cgroup v1 reports no limit as a huge number
+  const std::uint64_t v1 = readLimitFile("/sys/fs/cgroup/memory/memory.limit_in_bytes");
+  return v1 >= ((std::uint64_t) 1 << 62) ? 0 : v1;
+}
+
+
+void BufMgr::startAutoResize(const double memoryFraction, const std::chrono::milliseconds interval)
+{
+  if (autoResizeThread.joinable())
+    return;
+
+  autoResizeFraction = memoryFraction;
+  autoResizeInterval = interval;
+  autoResizeStop = false;
+  autoResizeThread = std::thread(&BufMgr::autoResizeLoop, this);
+}
+
+
+void BufMgr::stopAutoResize()
+{
+  if (!autoResizeThread.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(waitMutex);
+    autoResizeStop = true;
+  }
+  autoResizeWake.notify_one();
+  autoResizeThread.join();
+}
+
+
+void BufMgr::autoResizeLoop()
+{
+  std::unique_lock<std::mutex> lock(waitMutex);
+  while (!autoResizeStop)
+  {
+    lock.unlock();
+    const std::uint64_t limit = cgroupMemoryLimit();
+    if (limit > 0)
+    {
+      const std::uint64_t target = (std::uint64_t) (limit * autoResizeFraction) / sizeof(Page);
+      resize(target > maxBufs ? maxBufs : (std::uint32_t) target);
+    }
+    lock.lock();
+    if (!autoResizeStop)
+      autoResizeWake.wait_for(lock, autoResizeInterval);
+  }
+}
+
+bool BufMgr::claimFrame(BufPartition& part, FrameId & frame)
+{
+  // pages nobody wants again go before the policy is asked
+  if (part.evictSoonCount.load() > 0 && claimEvictSoon(part, frame))
+    return true;
+
+  // the policy works in frame numbers within the partition
+  const FrameId first = part.firstFrame;
+
+  // claiming a frame fails if someone pinned it since the policy looked. Kept pages are
+  // refused like pinned ones until every other frame turns out to be pinned.
+  bool passKept = frameStates->numKept() > 0;
+  const ReplacementPolicy::ClaimFn tryClaim = [this, first, &passKept](FrameId candidate) {
+    if (passKept && frameStates->isKept(first + candidate))
+      return false;
+    return claimPin(first + candidate);
+  };
+
+  // the policy offers candidates until one can be claimed; a claimed victim can
+  // still be lost to a concurrent pin while its dirty contents are written out
+  FrameId victim = 0;
+  std::uint32_t examined = 0;
+  for (;;)
+  {
+    if (!part.policy->pickVictim(victim, tryClaim, examined))
+    {
+      if (!passKept)
+        return false;
+      passKept = false;
+      continue;
+    }
+    const bool kept = frameStates->isKept(first + victim);
+    if (evictFrame(first + victim))
+    {
+      if (kept)
+        part.bufStats.keptEvictions++;
+      metrics.recordSweep(examined);
+      // return new frame number
+      frame = first + victim;
+      return true;
+    }
+    dropPin(first + victim);
+  }
+}
+
+
+bool BufMgr::claimEvictSoon(BufPartition& part, FrameId & frame)
+{
+  for (;;)
+  {
+    FrameId candidate;
+    {
+      std::lock_guard<std::mutex> latch(part.evictSoonLatch);
+      if (part.evictSoon.empty())
+        return false;
+      candidate = part.evictSoon.front();
+      part.evictSoon.pop_front();
+      part.evictSoonCount--;
+    }
+
+    // the page may have been pinned again, or replaced, since it was queued; a page
+    // pinned now is queued again when it is unpinned
+    if (!frameStates->isEvictSoon(candidate) || !claimPin(candidate))
+      continue;
+    if (frameStates->isEvictSoon(candidate) && evictFrame(candidate))
     {
-      // has been referenced, clear the bit
-      bufStats.accesses++;
-      bufDescTable[clockHand].refbit = false;
+      part.bufStats.evictSoonVictims++;
+      frame = candidate;
+      return true;
     }
+    dropPin(candidate);
+  }
+}
+
+
+void BufMgr::applyHint(const FrameId frameNo, const PageHint hint)
+{
+  switch (hint)
+  {
+    case HINT_KEEP:
+      frameStates->clearEvictSoon(frameNo);
+      // beyond the limit the pool would mostly hold pages which can't be evicted
+      if (!frameStates->isKept(frameNo) &&
+          (std::uint64_t) frameStates->numKept() * 100 < (std::uint64_t) numBufs.load() * MAX_KEPT_PERCENT)
+        frameStates->setKeep(frameNo);
+      break;
+    case HINT_EVICT_SOON:
+      frameStates->clearKeep(frameNo);
+      frameStates->setEvictSoon(frameNo);
+      break;
+    default:
+      // a page used again is no longer on its way out
+      frameStates->clearEvictSoon(frameNo);
+      break;
+  }
+}
+
+
+void BufMgr::queueEvictSoon(const FrameId frameNo)
+{
+  if (!frameStates->isEvictSoon(frameNo) || frameStates->pinCnt(frameNo).load() != 0)
+    return;
+  BufPartition& owner = framePartition(frameNo);
+  std::lock_guard<std::mutex> latch(owner.evictSoonLatch);
+  // a page queued twice is only evicted once; stale entries can't pile up past this
+  if (owner.evictSoon.size() >= owner.numBufs.load())
+    return;
+  owner.evictSoon.push_back(frameNo);
+  owner.evictSoonCount++;
+}
+
+
+bool BufMgr::claimAnyFrame(const std::uint32_t firstChoice, FrameId & frame)
+{
+  // a partition with every frame pinned borrows from the next one; the page stays
+  // routed to its own partition's hash table wherever its frame is
+  const std::uint32_t n = partitions.size();
+  for (std::uint32_t k = 0; k < n; k++)
+  {
+    if (claimFrame(*partitions[(firstChoice + k) % n], frame))
+      return true;
   }
-  
-  // check for full buffer pool
-  if (!found && numScanned >= 2*numBufs)
+  return false;
+}
+
+
+BufStatus BufMgr::tryAllocBuf(const std::uint32_t firstChoice, FrameId & frame)
+{
+  if (claimAnyFrame(firstChoice, frame))
+    return BUF_OK;
+
+  // every frame is pinned: wait for an unpin instead of failing. The waiter is counted
+  // before looking again, so dropPin only has to signal when someone is waiting.
+  frameWaiters++;
+  for (;;)
   {
+    const std::uint32_t epoch = unpinEpoch.load();
+    if (claimAnyFrame(firstChoice, frame))
+    {
+      frameWaiters--;
+      return BUF_OK;
+    }
+
+    std::unique_lock<std::mutex> lock(waitMutex);
+    const bool unpinned = frameFreed.wait_for(lock, pinWaitTimeout,
+        [this, epoch] { return unpinEpoch.load() != epoch; });
+    if (!unpinned)
+    {
+      frameWaiters--;
+      metrics.recordBufferExceeded();
+      return BUF_EXCEEDED;
+    }
+  }
+} // end tryAllocBuf
+
+
+void BufMgr::allocBuf(const std::uint32_t firstChoice, FrameId & frame)
+{
+  if (tryAllocBuf(firstChoice, frame) != BUF_OK)
     throw BufferExceededException();
+}
+
+
+bool BufMgr::evictFrame(FrameId frameNo, const bool keepCompressed)
+{
+  BufDesc* tmpbuf = &bufDescTable[frameNo];
+  BufPartition& owner = framePartition(frameNo);
+
+  // if invalid, use frame
+  if (!frameStates->isValid(frameNo))
+  {
+    clearFrame(frameNo);
+    return true;
   }
-  
-  // flush any existing changes to disk if necessary
-  if (bufDescTable[clockHand].dirty)
+
+  // flush any existing changes to disk if necessary. This happens before the page leaves
+  // the hash table so that a concurrent miss never reads stale contents from disk.
+  // commit() finds the page clean from here on, so it must see the write under way
+  tmpbuf->writeInProgress = true;
+  const bool wasDirty = tmpbuf->dirty.exchange(false);
+  if (wasDirty)
   {
-    bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
+    owner.bufStats.diskwrites++;
+    owner.bufStats.evictionWrites++;
+    if (writerThread.joinable())
+      writerWake.notify_one();
+    try
+    {
+      writeFrame(frameNo);
+    }
+    catch (...)
+    {
+      tmpbuf->dirty = true;
+      tmpbuf->writeInProgress = false;
+      dropPin(frameNo);
+      throw;
+    }
   }
+  tmpbuf->writeInProgress = false;
+
+  // remove previous entry from hash table, unless someone pinned or dirtied it meanwhile
+  BufHashTbl* hashTable = homePartition(tmpbuf->file, tmpbuf->pageNo).hashTable;
+  std::lock_guard<std::mutex> latch(hashTable->latch(tmpbuf->file, tmpbuf->pageNo));
+  if (frameStates->pinCnt(frameNo).load() != 1 || tmpbuf->dirty.load())
+    return false;
+
+  // compressed under the latch, where nobody can pin the page and change it, and kept
+  // before the page leaves the hash table, so a miss which finds it gone finds the copy
+  std::string compressed;
+  if (keepCompressed && victimCache.enabled() && VictimCache::compress(bufPool[frameNo], compressed))
+    victimCache.put(tmpbuf->fileId, tmpbuf->pageNo, compressed);
+  hashTable->remove(tmpbuf->file, tmpbuf->pageNo);
+  owner.policy->recordEvict(frameNo - owner.firstFrame, tmpbuf->fileId, tmpbuf->pageNo);
+  metrics.recordEviction(wasDirty);
 
 	//Reset all the BufDesc entry for the frame before returning the frame
-  bufDescTable[clockHand].Clear();
+  clearFrame(frameNo);
+  return true;
+}
 
-  // return new frame number
-  frame = clockHand;
-} // end allocBuf
 
-	
-void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
+void BufMgr::startBackgroundWriter(const double cleanFraction, const std::chrono::milliseconds interval)
 {
-  // check to see if it is already in the buffer pool
-  // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
-  FrameId frameNo = 0;
-	try
-	{
-  	hashTable->lookup(file, pageNo, frameNo);
+  if (writerThread.joinable())
+    return;
+
+  writerLookahead = (std::uint32_t) (cleanFraction * numBufs);
+  if (writerLookahead < 1)
+    writerLookahead = 1;
+  writerInterval = interval;
+  writerStop = false;
+  writerThread = std::thread(&BufMgr::writerLoop, this);
+}
+
 
-    // set the referenced bit
-    bufDescTable[frameNo].refbit = true;
-    bufDescTable[frameNo].pinCnt++;
-    page = &bufPool[frameNo];
+void BufMgr::stopBackgroundWriter()
+{
+  if (!writerThread.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(waitMutex);
+    writerStop = true;
   }
-  catch(HashNotFoundException e) //not in the buffer pool, must allocate a new page
+  writerWake.notify_one();
+  writerThread.join();
+}
+
+
+void BufMgr::writerLoop()
+{
+  std::unique_lock<std::mutex> lock(waitMutex);
+  while (!writerStop)
   {
-    // alloc a new frame
-    allocBuf(frameNo);
+    lock.unlock();
+    writeBehind();
+    lock.lock();
+    if (!writerStop)
+      writerWake.wait_for(lock, writerInterval);
+  }
+}
 
-    // read the page into the new frame
-    bufStats.diskreads++;
-    //status = file->readPage(pageNo, &bufPool[frameNo]);
-    bufPool[frameNo] = file->readPage(pageNo);
 
-    // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
-    page = &bufPool[frameNo];
+void BufMgr::writeBehind()
+{
+  // every partition has its own next victims; the lookahead is shared out between them
+  const std::uint32_t n = partitions.size();
+  const std::uint32_t lookahead = (writerLookahead + n - 1) / n;
 
-    // insert in the hash table
-    hashTable->insert(file, pageNo, frameNo);
+  std::lock_guard<std::mutex> guard(writeBackMutex);
 
+  // only the dirty ones need work. Pin each so it can't be evicted while we write it,
+  // skipping it if someone uses it; its file and page can only be read under the pin.
+  std::vector<std::pair<std::pair<FileId, PageId>, FrameId> > dirty;
+  std::vector<FrameId> upcoming;
+  for (std::uint32_t p = 0; p < n; p++)
+  {
+    const BufPartition& part = *partitions[p];
+    upcoming.clear();
+    part.policy->upcomingVictims(upcoming, lookahead);
+    for (std::size_t i = 0; i < upcoming.size(); i++)
+    {
+      const FrameId frameNo = part.firstFrame + upcoming[i];
+      BufDesc* tmpbuf = &bufDescTable[frameNo];
+      if (!frameStates->isValid(frameNo) || !tmpbuf->dirty.load() || !claimPin(frameNo))
+        continue;
+      if (frameStates->isValid(frameNo))
+        dirty.push_back(std::make_pair(std::make_pair(tmpbuf->fileId, tmpbuf->pageNo), frameNo));
+      else
+        dropPin(frameNo);
+    }
+  }
+
+  // write them in file and page number order
+  std::sort(dirty.begin(), dirty.end());
+  for (std::size_t i = 0; i < dirty.size(); i++)
+  {
+    const FrameId frameNo = dirty[i].second;
+    BufDesc* tmpbuf = &bufDescTable[frameNo];
+
+    // a writer who pins the page after this point sets the dirty bit again on unpin
+    if (tmpbuf->dirty.exchange(false))
+    {
+      try
+      {
+        writeFrame(frameNo);
+        framePartition(frameNo).bufStats.diskwrites++;
+        framePartition(frameNo).bufStats.writerWrites++;
+      }
+      catch (...)
+      {
+        // leave the page for eviction to write, which reports the error to a caller
+        tmpbuf->dirty = true;
+      }
+    }
+    dropPin(frameNo);
   }
 }
 
 
-void BufMgr::unPinPage(File* file, const PageId pageNo, 
-			     const bool dirty) 
+bool BufMgr::claimRingFrame(BufferRing& ring, FrameId& frame, long& slot)
 {
-  // lookup in hashtable
-  FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  std::lock_guard<std::mutex> guard(ring.latch);
 
-  if (dirty == true) bufDescTable[frameNo].dirty = dirty;
+  // the ring fills up from the shared pool first
+  if (ring.slots.size() < ring.size)
+    return false;
 
-  // make sure the page is actually pinned
-  if (bufDescTable[frameNo].pinCnt == 0)
+  for (std::size_t tries = 0; tries < ring.slots.size(); tries++)
   {
-  	throw PageNotPinnedException(file->filename(), pageNo, frameNo);
+    const std::size_t i = ring.next;
+    ring.next = (ring.next + 1) % ring.slots.size();
+    BufferRing::Slot& entry = ring.slots[i];
+
+    // the page of this slot is gone, or its frame was removed by a resize; refill the
+    // slot from the shared pool
+    const BufPartition& owner = framePartition(entry.frameNo);
+    if (entry.file == File::INVALID_ID || entry.frameNo - owner.firstFrame >= owner.numBufs)
+    {
+      entry.file = File::INVALID_ID;
+      return false;
+    }
+
+    // someone else is using the page; try the next slot
+    BufDesc* tmpbuf = &bufDescTable[entry.frameNo];
+    if (!claimPin(entry.frameNo))
+      continue;
+
+    // the policy may have given the frame to another page since the ring loaded it
+    if (frameStates->isValid(entry.frameNo) && (tmpbuf->fileId != entry.file || tmpbuf->pageNo != entry.pageNo))
+    {
+      dropPin(entry.frameNo);
+      entry.file = File::INVALID_ID;
+      return false;
+    }
+
+    if (!evictFrame(entry.frameNo, false))
+    {
+      dropPin(entry.frameNo);
+      continue;
+    }
+
+    frame = entry.frameNo;
+    slot = i;
+    return true;
   }
-  else bufDescTable[frameNo].pinCnt--;
+  return false;
 }
 
-void BufMgr::flushFile(const File* file) 
+
+void BufMgr::releaseFrame(FrameId frameNo)
 {
-  for (std::uint32_t i = 0; i < numBufs; i++)
-	{
-  	BufDesc* tmpbuf = &(bufDescTable[i]);
-  	if(tmpbuf->valid == true && tmpbuf->file == file)
-		{
-	    if (tmpbuf->pinCnt > 0)
-  			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
+  clearFrame(frameNo);
+  dropPin(frameNo);
+}
 
-	    if (tmpbuf->dirty == true)
-			{
-				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-				tmpbuf->dirty = false;
-    	}
 
-    	hashTable->remove(file,tmpbuf->pageNo);
-    	tmpbuf->Clear();
-  	}
-		else if (tmpbuf->valid == false && tmpbuf->file == file)
-  		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+void BufMgr::trackFrame(FrameId frameNo)
+{
+  BufDesc& desc = bufDescTable[frameNo];
+  BufPartition& owner = framePartition(frameNo);
+  std::lock_guard<std::mutex> latch(owner.fileFramesLatch);
+  std::pair<std::unordered_map<FileId, BufPartition::FileFrames>::iterator, bool> added =
+    owner.fileFrames.insert(std::make_pair(desc.fileId, BufPartition::FileFrames()));
+  BufPartition::FileFrames& tracked = added.first->second;
+  if (added.second)
+  {
+    try
+    {
+      tracked.counts = metrics.fileCounts(desc.file);
+      tracked.handle = desc.file->poolHandle();
+    }
+    catch (...)
+    {
+      // leave the frame empty, for the caller to release
+      owner.fileFrames.erase(desc.fileId);
+      desc.Clear();
+      frameStates->clear(frameNo);
+      throw;
+    }
   }
+  // the frame writes through the partition's File object from now on
+  desc.file = tracked.handle;
+  desc.counts = tracked.counts;
+  desc.fileSlot = tracked.frames.size();
+  tracked.frames.push_back(frameNo);
 }
 
-void BufMgr::disposePage(File* file, const PageId pageNo) 
+
+void BufMgr::clearFrame(FrameId frameNo)
 {
-	//Deallocate from file altogether
-  //See if it is in the buffer pool
-  FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  BufDesc& desc = bufDescTable[frameNo];
+  if (desc.file != NULL)
+  {
+    BufPartition& owner = framePartition(frameNo);
+    std::lock_guard<std::mutex> latch(owner.fileFramesLatch);
+    std::unordered_map<FileId, BufPartition::FileFrames>::iterator it = owner.fileFrames.find(desc.fileId);
+    std::vector<FrameId>& frames = it->second.frames;
+    // the file's last frame takes over the slot
+    const FrameId last = frames.back();
+    frames[desc.fileSlot] = last;
+    bufDescTable[last].fileSlot = desc.fileSlot;
+    frames.pop_back();
+  }
+  desc.Clear();
+  frameStates->clear(frameNo);
+}
 
-	// clear the page
-	bufDescTable[frameNo].Clear();
 
-	hashTable->remove(file, pageNo);
+void BufMgr::fileClosed(const FileId id)
+{
+  const File* handle = NULL;
+  for (std::size_t p = 0; p < partitions.size() && handle == NULL; p++)
+  {
+    std::lock_guard<std::mutex> latch(partitions[p]->fileFramesLatch);
+    std::unordered_map<FileId, BufPartition::FileFrames>::const_iterator it = partitions[p]->fileFrames.find(id);
+    if (it != partitions[p]->fileFrames.end())
+      handle = it->second.handle;
+  }
+  if (handle == NULL)
+    return;
 
-  // deallocate it in the file	
-  file->deletePage(pageNo);
+  // the handle stays open until the frames using it are gone, which this makes sure of
+  try
+  {
+    FrameId pinnedFrame = 0;
+    if (flushPages(handle, pinnedFrame) != BUF_OK)
+      return;
+  }
+  catch (BadgerDbException&)
+  {
+    // the pages stay, and with them the handles; flushFile() reports the error
+    return;
+  }
+
+  std::vector<File*> closed;
+  for (std::size_t p = 0; p < partitions.size(); p++)
+  {
+    std::lock_guard<std::mutex> latch(partitions[p]->fileFramesLatch);
+    std::unordered_map<FileId, BufPartition::FileFrames>::iterator it = partitions[p]->fileFrames.find(id);
+    // a frame read in since the flush keeps its handle until the next close
+    if (it != partitions[p]->fileFrames.end() && it->second.frames.empty())
+    {
+      closed.push_back(it->second.handle);
+      partitions[p]->fileFrames.erase(it);
+    }
+  }
+  // the pool's handles are the last File objects of the file, so this closes it
+  for (std::size_t i = 0; i < closed.size(); i++)
+    delete closed[i];
 }
 
 
-void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
+bool BufMgr::claimPin(FrameId frameNo)
 {
-  FrameId frameNo;
+  int unpinned = 0;
+  if (!frameStates->pinCnt(frameNo).compare_exchange_strong(unpinned, 1))
+    return false;
+  metrics.notePinned();
+  return true;
+}
 
-  // alloc a new frame
-  allocBuf(frameNo);
-  // allocate a new page in the file
-	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
-  page = &bufPool[frameNo];
 
-  // set up the entry properly
-  bufDescTable[frameNo].Set(file, pageNo);
+void BufMgr::addPin(FrameId frameNo)
+{
+  if (frameStates->pinCnt(frameNo).fetch_add(1) == 0)
+    metrics.notePinned();
+}
+
 
-  // insert in the hash table
-  hashTable->insert(file, pageNo, frameNo);
+void BufMgr::dropPin(FrameId frameNo)
+{
+  if (frameStates->pinCnt(frameNo).fetch_sub(1) == 1)
+    frameUnpinned();
 }
 
-void BufMgr::printSelf(void) 
+
+bool BufMgr::tryDropPin(FrameId frameNo)
 {
-  BufDesc* tmpbuf;
-	int validFrames = 0;
-  
-  for (std::uint32_t i = 0; i < numBufs; i++)
-	{
-  	tmpbuf = &(bufDescTable[i]);
-		std::cout << "FrameNo:" << i << " ";
-		tmpbuf->Print();
+  std::atomic<int>& pins = frameStates->pinCnt(frameNo);
+  int count = pins.load();
+  do
+  {
+    if (count <= 0)
+      return false;
+  } while (!pins.compare_exchange_weak(count, count - 1));
+  if (count == 1)
+    frameUnpinned();
+  return true;
+}
+
 
-  	if (tmpbuf->valid == true)
-    	validFrames++;
+void BufMgr::frameUnpinned()
+{
+  metrics.noteUnpinned();
+  if (frameWaiters.load() > 0)
+  {
+    unpinEpoch++;
+    std::lock_guard<std::mutex> lock(waitMutex);
+    frameFreed.notify_all();
   }
+}
 
-	std::cout << "Total Number of Valid Frames:" << validFrames << "\n";
+
+void BufMgr::unpinFrame(const FrameId frameNo, const bool dirty, const PageHint hint)
+{
+  if (dirty)
+    bufDescTable[frameNo].dirty = true;
+  if (hint != HINT_NORMAL)
+    applyHint(frameNo, hint);
+  dropPin(frameNo);
+  queueEvictSoon(frameNo);
+}
+
+
+void BufMgr::writeFrame(FrameId frameNo)
+{
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  bufDescTable[frameNo].file->writePage(bufDescTable[frameNo].pageNo, bufPool[frameNo]);
+  metrics.recordWrite(std::chrono::steady_clock::now() - start);
+}
+
+
+void BufMgr::writeFrames(const FrameId* frames, const std::size_t count)
+{
+  std::vector<const Page*> pages(count);
+  for (std::size_t i = 0; i < count; i++)
+    pages[i] = &bufPool[frames[i]];
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  bufDescTable[frames[0]].file->writePages(bufDescTable[frames[0]].pageNo, &pages[0], count);
+  metrics.recordWrite(std::chrono::steady_clock::now() - start);
+}
+
+
+void BufMgr::waitForIo(FrameId frameNo)
+{
+  if (!bufDescTable[frameNo].ioInProgress.load())
+    return;
+
+  std::unique_lock<std::mutex> lock(waitMutex);
+  ioDone.wait(lock, [this, frameNo] { return !bufDescTable[frameNo].ioInProgress.load(); });
+}
+
+
+void BufMgr::finishIo(FrameId frameNo)
+{
+  std::lock_guard<std::mutex> lock(waitMutex);
+  bufDescTable[frameNo].ioInProgress = false;
+  ioDone.notify_all();
+}
+
+
+bool BufMgr::installPage(File* file, const PageId pageNo, const FrameId newFrame,
+                         BufferRing* ring, const long ringSlot, FrameId& frameNo)
+{
+  BufHashTbl* hashTable = homePartition(file, pageNo).hashTable;
+  BufPartition& owner = framePartition(newFrame);
+  std::exception_ptr failure;
+  {
+    std::lock_guard<std::mutex> latch(hashTable->latch(file, pageNo));
+    // another thread may have read the page in while we were looking for a frame
+    if (hashTable->tryLookup(file, pageNo, frameNo))
+      addPin(frameNo);
+    else
+    {
+      // set up the entry properly; readers arriving before the I/O finishes will wait
+      bufDescTable[newFrame].Set(file, pageNo);
+      frameStates->assign(newFrame);
+      bufDescTable[newFrame].ioInProgress = true;
+      try
+      {
+        trackFrame(newFrame);
+
+        // insert in the hash table
+        hashTable->insert(file, pageNo, newFrame);
+        frameNo = newFrame;
+      }
+      catch (...)
+      {
+        failure = std::current_exception();
+      }
+    }
+  }
+
+  // the ring latch is taken before hash table latches, so this waits until here
+  if (failure)
+  {
+    dropPin(newFrame);
+    if (ringSlot >= 0)
+      ring->forget(ringSlot);
+    std::rethrow_exception(failure);
+  }
+
+  if (frameNo != newFrame)
+  {
+    releaseFrame(newFrame);
+    if (ringSlot >= 0)
+      ring->forget(ringSlot);
+    return false;
+  }
+
+  // read the page into the new frame, from the victim cache if it holds the page
+  bool decompressed = false;
+  if (victimCache.enabled())
+  {
+    owner.bufStats.victimLookups++;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    decompressed = victimCache.take(file->id(), pageNo, bufPool[newFrame]);
+    if (decompressed)
+    {
+      owner.bufStats.victimHits++;
+      owner.bufStats.victimDecompressNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start).count();
+    }
+  }
+  try
+  {
+    if (!decompressed)
+    {
+      owner.bufStats.diskreads++;
+      const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      file->readPageInto(pageNo, bufPool[newFrame]);
+      metrics.recordRead(std::chrono::steady_clock::now() - start);
+    }
+  }
+  catch (...)
+  {
+    {
+      std::lock_guard<std::mutex> latch(hashTable->latch(file, pageNo));
+      hashTable->remove(file, pageNo);
+      clearFrame(newFrame);
+    }
+    finishIo(newFrame);
+    dropPin(newFrame);
+    if (ringSlot >= 0)
+      ring->forget(ringSlot);
+    throw;
+  }
+  finishIo(newFrame);
+  owner.policy->recordLoad(newFrame - owner.firstFrame, file->id(), pageNo);
+  if (ring != NULL)
+    ring->assign(ringSlot, newFrame, file->id(), pageNo);
+  return true;
+}
+
+
+void BufMgr::readPage(File* file, const PageId pageNo, Page*& page, BufferRing* ring, const PageHint hint)
+{
+  if (tryReadPage(file, pageNo, page, ring, hint) != BUF_OK)
+    throw BufferExceededException();
+}
+
+
+BufStatus BufMgr::tryReadPage(File* file, const PageId pageNo, Page*& page, BufferRing* ring,
+                              const PageHint hint)
+{
+  const std::uint32_t home = homeIndex(file, pageNo);
+  BufHashTbl* hashTable = partitions[home]->hashTable;
+  for (;;)
+  {
+    // check to see if it is already in the buffer pool
+    FrameId frameNo = 0;
+    bool found;
+    {
+      std::lock_guard<std::mutex> latch(hashTable->latch(file, pageNo));
+      found = hashTable->tryLookup(file, pageNo, frameNo);
+      if (found)
+        addPin(frameNo);
+    }
+
+    //not in the buffer pool, must allocate a new page
+    if (!found)
+    {
+      // alloc a new frame, recycling one from the ring if the reader has one
+      FrameId newFrame = 0;
+      long ringSlot = -1;
+      if ((ring == NULL || !claimRingFrame(*ring, newFrame, ringSlot)) && tryAllocBuf(home, newFrame) != BUF_OK)
+        return BUF_EXCEEDED;
+
+      // a scan which outran its read-ahead reads the page itself
+      if (ring != NULL)
+        dropPrefetch(file, pageNo);
+
+      if (installPage(file, pageNo, newFrame, ring, ringSlot, frameNo))
+      {
+        BufStats& stats = framePartition(frameNo).bufStats;
+        stats.accesses++;
+        stats.misses++;
+        metrics.recordMiss(bufDescTable[frameNo].counts);
+        applyHint(frameNo, hint);
+        page = &bufPool[frameNo];
+        return BUF_OK;
+      }
+    }
+
+    waitForIo(frameNo);
+
+    // the read may have failed, in which case the frame no longer holds our page
+    if (frameStates->isValid(frameNo) && bufDescTable[frameNo].fileId == file->id() &&
+        bufDescTable[frameNo].pageNo == pageNo)
+    {
+      BufPartition& owner = framePartition(frameNo);
+      owner.bufStats.accesses++;
+      owner.bufStats.hits++;
+      if (frameStates->isKept(frameNo))
+        owner.bufStats.keptHits++;
+      metrics.recordHit(bufDescTable[frameNo].counts);
+      owner.policy->recordAccess(frameNo - owner.firstFrame);
+      applyHint(frameNo, hint);
+      page = &bufPool[frameNo];
+      return BUF_OK;
+    }
+    dropPin(frameNo);
+  }
+}
+
+
+PageHandle BufMgr::pinPage(File* file, const PageId pageNo, BufferRing* ring, const PageHint hint)
+{
+  Page* page;
+  readPage(file, pageNo, page, ring, hint);
+  return PageHandle(this, file, pageNo, page - bufPool, page);
+}
+
+
+PageHandle BufMgr::pinNewPage(File* file, PageId& pageNo, const PageHint hint)
+{
+  Page* page;
+  allocPage(file, pageNo, page, hint);
+  return PageHandle(this, file, pageNo, page - bufPool, page);
+}
+
+
+void BufMgr::readPages(File* file, const std::vector<PageId>& pageIds, std::vector<Page*>& outPages)
+{
+  // the first page is read right away; the rest load in the background meanwhile
+  std::vector<PageId> rest;
+  if (pageIds.size() > 1)
+  {
+    rest.assign(pageIds.begin() + 1, pageIds.end());
+    prefetch(file, rest);
+  }
+
+  outPages.assign(pageIds.size(), NULL);
+  for (std::size_t i = 0; i < pageIds.size(); i++)
+  {
+    try
+    {
+      readPage(file, pageIds[i], outPages[i]);
+    }
+    catch (...)
+    {
+      dropPrefetches(file, rest);
+      for (std::size_t j = 0; j < i; j++)
+        unPinPage(file, pageIds[j], false);
+      outPages.assign(pageIds.size(), NULL);
+      throw;
+    }
+  }
+  // the caller may close the file as soon as this returns
+  dropPrefetches(file, rest);
+}
+
+
+void BufMgr::prefetch(File* file, const std::vector<PageId>& pageIds, BufferRing* ring)
+{
+  if (pageIds.empty())
+    return;
+
+  std::lock_guard<std::mutex> lock(prefetchMutex);
+  if (prefetchWorkers.empty())
+  {
+    prefetchInFlight.assign(numPrefetchWorkers, NULL);
+    for (std::uint32_t i = 0; i < numPrefetchWorkers; i++)
+      prefetchWorkers.push_back(std::thread(&BufMgr::prefetchLoop, this, i));
+  }
+
+  for (std::size_t i = 0; i < pageIds.size(); i++)
+  {
+    PrefetchRequest request = { file, pageIds[i], ring };
+    prefetchQueue.push_back(request);
+  }
+  prefetchReady.notify_all();
+}
+
+
+void BufMgr::cancelPrefetch(const File* file)
+{
+  std::unique_lock<std::mutex> lock(prefetchMutex);
+  for (std::deque<PrefetchRequest>::iterator it = prefetchQueue.begin(); it != prefetchQueue.end(); )
+  {
+    if (it->file == file)
+      it = prefetchQueue.erase(it);
+    else
+      ++it;
+  }
+  prefetchIdle.wait(lock, [this, file] {
+    return std::find(prefetchInFlight.begin(), prefetchInFlight.end(), file) == prefetchInFlight.end();
+  });
+}
+
+
+void BufMgr::dropPrefetch(const File* file, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> lock(prefetchMutex);
+  for (std::deque<PrefetchRequest>::iterator it = prefetchQueue.begin(); it != prefetchQueue.end(); ++it)
+  {
+    if (it->file == file && it->pageNo == pageNo)
+    {
+      prefetchQueue.erase(it);
+      return;
+    }
+  }
+}
+
+
+void BufMgr::dropPrefetches(const File* file, const std::vector<PageId>& pageIds)
+{
+  if (pageIds.empty())
+    return;
+
+  std::unique_lock<std::mutex> lock(prefetchMutex);
+  for (std::deque<PrefetchRequest>::iterator it = prefetchQueue.begin(); it != prefetchQueue.end(); )
+  {
+    if (it->file == file && it->ring == NULL &&
+        std::find(pageIds.begin(), pageIds.end(), it->pageNo) != pageIds.end())
+      it = prefetchQueue.erase(it);
+    else
+      ++it;
+  }
+  prefetchIdle.wait(lock, [this, file] {
+    return std::find(prefetchInFlight.begin(), prefetchInFlight.end(), file) == prefetchInFlight.end();
+  });
+}
+
+
+void BufMgr::stopPrefetchWorkers()
+{
+  {
+    std::lock_guard<std::mutex> lock(prefetchMutex);
+    prefetchStop = true;
+    prefetchQueue.clear();
+  }
+  prefetchReady.notify_all();
+  for (std::size_t i = 0; i < prefetchWorkers.size(); i++)
+    prefetchWorkers[i].join();
+  prefetchWorkers.clear();
+}
+
+
+void BufMgr::prefetchLoop(const std::uint32_t worker)
+{
+  std::unique_lock<std::mutex> lock(prefetchMutex);
+  for (;;)
+  {
+    prefetchReady.wait(lock, [this] { return prefetchStop || !prefetchQueue.empty(); });
+    if (prefetchStop)
+      return;
+
+    const PrefetchRequest request = prefetchQueue.front();
+    prefetchQueue.pop_front();
+    prefetchInFlight[worker] = request.file;
+    lock.unlock();
+
+    try
+    {
+      prefetchPage(request);
+    }
+    catch (...)
+    {
+      // the page is simply read on demand later, where the error reaches a caller
+    }
+
+    lock.lock();
+    prefetchInFlight[worker] = NULL;
+    prefetchIdle.notify_all();
+  }
+}
+
+
+bool BufMgr::prefetchPage(const PrefetchRequest& request)
+{
+  const std::uint32_t home = homeIndex(request.file, request.pageNo);
+  BufHashTbl* hashTable = partitions[home]->hashTable;
+  FrameId frameNo = 0;
+  {
+    std::lock_guard<std::mutex> latch(hashTable->latch(request.file, request.pageNo));
+    if (hashTable->tryLookup(request.file, request.pageNo, frameNo))
+      return false;
+  }
+
+  // never wait for a frame: if the pool is fully pinned the prefetch is dropped
+  FrameId newFrame = 0;
+  long ringSlot = -1;
+  if ((request.ring == NULL || !claimRingFrame(*request.ring, newFrame, ringSlot)) && !claimAnyFrame(home, newFrame))
+    return false;
+
+  const bool loaded = installPage(request.file, request.pageNo, newFrame, request.ring, ringSlot, frameNo);
+  if (loaded)
+    framePartition(frameNo).bufStats.prefetchReads++;
+  dropPin(frameNo);
+  return loaded;
+}
+
+
+void BufMgr::unPinPage(File* file, const PageId pageNo,
+			     const bool dirty, const PageHint hint)
+{
+  const BufStatus status = tryUnPinPage(file, pageNo, dirty, hint);
+  if (status == BUF_NOT_RESIDENT)
+    throw HashNotFoundException(file->filename(), pageNo);
+  if (status == BUF_NOT_PINNED)
+  {
+    FrameId frameNo = 0;
+    BufHashTbl* hashTable = homePartition(file, pageNo).hashTable;
+    std::lock_guard<std::mutex> latch(hashTable->latch(file, pageNo));
+    hashTable->tryLookup(file, pageNo, frameNo);
+    throw PageNotPinnedException(file->filename(), pageNo, frameNo);
+  }
+}
+
+BufStatus BufMgr::tryUnPinPage(File* file, const PageId pageNo,
+			     const bool dirty, const PageHint hint)
+{
+  // lookup in hashtable
+  FrameId frameNo = 0;
+  BufHashTbl* hashTable = homePartition(file, pageNo).hashTable;
+  {
+    std::lock_guard<std::mutex> latch(hashTable->latch(file, pageNo));
+    if (!hashTable->tryLookup(file, pageNo, frameNo))
+      return BUF_NOT_RESIDENT;
+
+    if (dirty == true) bufDescTable[frameNo].dirty = dirty;
+    // the hint goes on while the page is still pinned, so it can't land on the next page
+    if (hint != HINT_NORMAL)
+      applyHint(frameNo, hint);
+
+    // make sure the page is actually pinned; two unpins can't both take the last pin
+    if (!tryDropPin(frameNo))
+      return BUF_NOT_PINNED;
+  }
+  queueEvictSoon(frameNo);
+  return BUF_OK;
+}
+
+void BufMgr::flushFile(const File* file)
+{
+  FrameId pinnedFrame = 0;
+  if (flushPages(file, pinnedFrame) != BUF_OK)
+    throw PagePinnedException(file->filename(), bufDescTable[pinnedFrame].pageNo, pinnedFrame);
+}
+
+BufStatus BufMgr::tryFlushFile(const File* file)
+{
+  FrameId pinnedFrame = 0;
+  return flushPages(file, pinnedFrame);
+}
+
+BufStatus BufMgr::flushPages(const File* file, FrameId& pinnedFrame)
+{
+  cancelPrefetch(file);
+  std::lock_guard<std::mutex> guard(writeBackMutex);
+
+  // claim every frame so none can be pinned or evicted while the file is written out
+  std::vector<FrameId> claimed;
+  if (claimFileFrames(file, false, claimed, pinnedFrame) != BUF_OK)
+    return BUF_PAGE_PINNED;
+  writeClaimed(claimed);
+
+  for (std::size_t i = 0; i < claimed.size(); i++)
+  {
+    const FrameId frameNo = claimed[i];
+    BufDesc* tmpbuf = &(bufDescTable[frameNo]);
+    BufPartition& part = framePartition(frameNo);
+    {
+      BufHashTbl* hashTable = homePartition(file, tmpbuf->pageNo).hashTable;
+      std::lock_guard<std::mutex> latch(hashTable->latch(file, tmpbuf->pageNo));
+      hashTable->remove(file, tmpbuf->pageNo);
+      part.policy->recordEvict(frameNo - part.firstFrame, file->id(), tmpbuf->pageNo);
+      clearFrame(frameNo);
+    }
+    dropPin(frameNo);
+  }
+  victimCache.eraseFile(file->id());
+
+  if (durability == SYNC_ON_FLUSHFILE)
+    file->sync();
+  else
+    file->flushHeader();
+  return BUF_OK;
+}
+
+void BufMgr::commit(const File* file)
+{
+  FrameId pinnedFrame = 0;
+  if (commitPages(file, pinnedFrame) != BUF_OK)
+    throw PagePinnedException(file->filename(), bufDescTable[pinnedFrame].pageNo, pinnedFrame);
+}
+
+BufStatus BufMgr::tryCommit(const File* file)
+{
+  FrameId pinnedFrame = 0;
+  return commitPages(file, pinnedFrame);
+}
+
+BufStatus BufMgr::commitPages(const File* file, FrameId& pinnedFrame)
+{
+  {
+    std::lock_guard<std::mutex> guard(writeBackMutex);
+    // a page pinned while clean is changed after the commit, if at all
+    std::vector<FrameId> claimed;
+    if (claimFileFrames(file, true, claimed, pinnedFrame) != BUF_OK)
+      return BUF_PAGE_PINNED;
+    writeClaimed(claimed);
+    for (std::size_t i = 0; i < claimed.size(); i++)
+      dropPin(claimed[i]);
+  }
+
+  // pages evictions wrote back are on the file by now, so the sync covers them too
+  if (durability == SYNC_ON_COMMIT)
+    file->sync();
+  else
+    file->flushHeader();
+  return BUF_OK;
+}
+
+BufStatus BufMgr::claimFileFrames(const File* file, const bool skipClean, std::vector<FrameId>& claimed,
+                                  FrameId& pinnedFrame)
+{
+  // only the frames listed for the file are looked at, not the whole pool
+  std::vector<FrameId> listed;
+  for (std::size_t p = 0; p < partitions.size(); p++)
+  {
+    BufPartition& part = *partitions[p];
+    std::lock_guard<std::mutex> latch(part.fileFramesLatch);
+    std::unordered_map<FileId, BufPartition::FileFrames>::const_iterator it = part.fileFrames.find(file->id());
+    if (it != part.fileFrames.end())
+      listed.insert(listed.end(), it->second.frames.begin(), it->second.frames.end());
+  }
+
+  claimed.clear();
+  claimed.reserve(listed.size());
+  for (std::size_t i = 0; i < listed.size(); i++)
+  {
+    const FrameId frameNo = listed[i];
+    BufDesc* tmpbuf = &(bufDescTable[frameNo]);
+    bool claimedFrame = claimPin(frameNo);
+    if (!claimedFrame && (!skipClean || claimForCommit(file, frameNo, claimedFrame) != BUF_OK))
+    {
+      for (std::size_t j = 0; j < claimed.size(); j++)
+        dropPin(claimed[j]);
+      claimed.clear();
+      pinnedFrame = frameNo;
+      return BUF_PAGE_PINNED;
+    }
+    if (!claimedFrame)
+      continue;
+
+    // the frame may have been evicted and reused between the listing and the claim
+    if (tmpbuf->fileId != file->id())
+    {
+      dropPin(frameNo);
+      continue;
+    }
+    if (!frameStates->isValid(frameNo))
+    {
+      dropPin(frameNo);
+      for (std::size_t j = 0; j < claimed.size(); j++)
+        dropPin(claimed[j]);
+      claimed.clear();
+      throw BadBufferException(frameNo, tmpbuf->dirty, frameStates->isValid(frameNo), frameStates->isReferenced(frameNo));
+    }
+    claimed.push_back(frameNo);
+  }
+  return BUF_OK;
+}
+
+BufStatus BufMgr::claimForCommit(const File* file, const FrameId frameNo, bool& claimed)
+{
+  const BufDesc* tmpbuf = &(bufDescTable[frameNo]);
+  BufPartition& part = framePartition(frameNo);
+  const std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(COMMIT_PIN_WAIT_MS);
+  claimed = false;
+  while (!(claimed = claimPin(frameNo)))
+  {
+    // the dirty flag first: an eviction announces its write before it clears the flag
+    const bool dirty = tmpbuf->dirty.load();
+    const bool writing = tmpbuf->writeInProgress.load();
+    if (!dirty && !writing)
+      return BUF_OK;
+
+    // a frame no longer listed for the file had its page written out before it left the list
+    {
+      std::lock_guard<std::mutex> latch(part.fileFramesLatch);
+      std::unordered_map<FileId, BufPartition::FileFrames>::const_iterator it = part.fileFrames.find(file->id());
+      if (it == part.fileFrames.end() || tmpbuf->fileSlot >= it->second.frames.size() ||
+          it->second.frames[tmpbuf->fileSlot] != frameNo)
+        return BUF_OK;
+    }
+    if (!writing && std::chrono::steady_clock::now() > deadline)
+      return BUF_PAGE_PINNED;
+    std::this_thread::yield();
+  }
+  return BUF_OK;
+}
+
+void BufMgr::writeClaimed(std::vector<FrameId>& claimed)
+{
+  // write the dirty pages in page number order, merging runs of adjacent pages
+  std::sort(claimed.begin(), claimed.end(), [this](const FrameId a, const FrameId b) {
+    return bufDescTable[a].pageNo < bufDescTable[b].pageNo;
+  });
+  std::vector<FrameId> run;
+  for (std::size_t i = 0; i <= claimed.size(); i++)
+  {
+    const bool extends = i < claimed.size() && !run.empty() &&
+      bufDescTable[claimed[i]].pageNo == bufDescTable[run.back()].pageNo + 1;
+    if (!run.empty() && !extends)
+    {
+      try
+      {
+        writeFrames(&run[0], run.size());
+      }
+      catch (...)
+      {
+        // leave the file as it was: everything not yet on disk stays dirty and resident
+        for (std::size_t j = 0; j < run.size(); j++)
+          bufDescTable[run[j]].dirty = true;
+        for (std::size_t j = 0; j < claimed.size(); j++)
+          dropPin(claimed[j]);
+        throw;
+      }
+      for (std::size_t j = 0; j < run.size(); j++)
+        framePartition(run[j]).bufStats.diskwrites++;
+      run.clear();
+    }
+    if (i < claimed.size() && bufDescTable[claimed[i]].dirty.exchange(false))
+      run.push_back(claimed[i]);
+  }
+}
+
+void BufMgr::disposePage(File* file, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> guard(writeBackMutex);
+  //See if it is in the buffer pool
+  FrameId frameNo = 0;
+  BufHashTbl* hashTable = homePartition(file, pageNo).hashTable;
+  {
+    std::lock_guard<std::mutex> latch(hashTable->latch(file, pageNo));
+    if (!hashTable->tryLookup(file, pageNo, frameNo))
+      throw HashNotFoundException(file->filename(), pageNo);
+
+    // take the frame over, pins and all; whoever held them has lost the page
+    if (frameStates->pinCnt(frameNo).exchange(1) == 0)
+      metrics.notePinned();
+
+    hashTable->remove(file, pageNo);
+    BufPartition& owner = framePartition(frameNo);
+    owner.policy->recordEvict(frameNo - owner.firstFrame, file->id(), pageNo);
+
+    // clear the page
+    clearFrame(frameNo);
+  }
+  dropPin(frameNo);
+  victimCache.erase(file->id(), pageNo);
+
+	//Deallocate from file altogether
+  file->deletePage(pageNo);
+}
+
+
+void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page, const PageHint hint)
+{
+  if (tryAllocPage(file, pageNo, page, hint) != BUF_OK)
+    throw BufferExceededException();
+}
+
+
+BufStatus BufMgr::tryAllocPage(File* file, PageId &pageNo, Page*& page, const PageHint hint)
+{
+  FrameId frameNo;
+
+  // alloc a new frame. The page number is only known once the file has allocated the
+  // page, so the partitions take turns providing the frame.
+  if (tryAllocBuf(nextAllocPartition++ % partitions.size(), frameNo) != BUF_OK)
+    return BUF_EXCEEDED;
+  // allocate a new page in the file
+  try
+  {
+    file->allocatePageInto(pageNo, bufPool[frameNo]);
+  }
+  catch (...)
+  {
+    releaseFrame(frameNo);
+    throw;
+  }
+  page = &bufPool[frameNo];
+  // a page number can come back after its page was deleted
+  victimCache.erase(file->id(), pageNo);
+
+  // set up the entry properly and insert in the hash table; nobody else can know
+  // about this page number yet
+  {
+    BufHashTbl* hashTable = homePartition(file, pageNo).hashTable;
+    std::lock_guard<std::mutex> latch(hashTable->latch(file, pageNo));
+    bufDescTable[frameNo].Set(file, pageNo);
+    frameStates->assign(frameNo);
+    try
+    {
+      trackFrame(frameNo);
+    }
+    catch (...)
+    {
+      dropPin(frameNo);
+      // the caller never learns the page number, so nobody else would free the page
+      try
+      {
+        file->deletePage(pageNo);
+      }
+      catch (...)
+      {
+      }
+      throw;
+    }
+    hashTable->insert(file, pageNo, frameNo);
+  }
+  BufPartition& owner = framePartition(frameNo);
+  owner.bufStats.accesses++;
+  owner.bufStats.misses++;
+  metrics.recordMiss(bufDescTable[frameNo].counts);
+  owner.policy->recordLoad(frameNo - owner.firstFrame, file->id(), pageNo);
+  applyHint(frameNo, hint);
+  return BUF_OK;
+}
+
+void BufMgr::printSelf(void)
+{
+  BufDesc* tmpbuf;
+	int validFrames = 0;
+
+  for (std::size_t p = 0; p < partitions.size(); p++)
+  {
+    const BufPartition& part = *partitions[p];
+    for (FrameId i = part.firstFrame; i < part.firstFrame + part.numBufs; i++)
+    {
+      tmpbuf = &(bufDescTable[i]);
+      std::cout << "FrameNo:" << i << " ";
+      tmpbuf->Print(*frameStates);
+
+      if (frameStates->isValid(i))
+        validFrames++;
+    }
+  }
+
+	std::cout << "Total Number of Valid Frames:" << validFrames << "\n";
+}
+
+BufStats& BufMgr::getBufStats()
+{
+  int accesses = 0, diskreads = 0, diskwrites = 0, writerWrites = 0;
+  int evictionWrites = 0, prefetchReads = 0, hits = 0, misses = 0;
+  int victimLookups = 0, victimHits = 0;
+  int keptHits = 0, keptEvictions = 0, evictSoonVictims = 0;
+  std::uint64_t victimDecompressNanos = 0;
+  for (std::size_t p = 0; p < partitions.size(); p++)
+  {
+    const BufStats& stats = partitions[p]->bufStats;
+    accesses += stats.accesses;
+    diskreads += stats.diskreads;
+    diskwrites += stats.diskwrites;
+    writerWrites += stats.writerWrites;
+    evictionWrites += stats.evictionWrites;
+    prefetchReads += stats.prefetchReads;
+    hits += stats.hits;
+    misses += stats.misses;
+    victimLookups += stats.victimLookups;
+    victimHits += stats.victimHits;
+    victimDecompressNanos += stats.victimDecompressNanos;
+    keptHits += stats.keptHits;
+    keptEvictions += stats.keptEvictions;
+    evictSoonVictims += stats.evictSoonVictims;
+  }
+  bufStats.accesses = accesses;
+  bufStats.diskreads = diskreads;
+  bufStats.diskwrites = diskwrites;
+  bufStats.writerWrites = writerWrites;
+  bufStats.evictionWrites = evictionWrites;
+  bufStats.prefetchReads = prefetchReads;
+  bufStats.hits = hits;
+  bufStats.misses = misses;
+  bufStats.victimLookups = victimLookups;
+  bufStats.victimHits = victimHits;
+  bufStats.victimDecompressNanos = victimDecompressNanos;
+  bufStats.keptHits = keptHits;
+  bufStats.keptEvictions = keptEvictions;
+  bufStats.evictSoonVictims = evictSoonVictims;
+  return bufStats;
+}
+
+void BufMgr::clearBufStats()
+{
+  for (std::size_t p = 0; p < partitions.size(); p++)
+    partitions[p]->bufStats.clear();
+  bufStats.clear();
+}
+
+void BufMgr::collectMetrics(BufMetricsSnapshot& out)
+{
+  metrics.collect(out);
+  out.policyName = partitions[0]->policy->name();
+  out.frames = numBufs;
+  out.validFrames = out.dirtyFrames = out.pinnedFrames = 0;
+  for (std::size_t p = 0; p < partitions.size(); p++)
+  {
+    const BufPartition& part = *partitions[p];
+    for (FrameId i = part.firstFrame; i < part.firstFrame + part.numBufs; i++)
+    {
+      const BufDesc* tmpbuf = &bufDescTable[i];
+      const bool valid = frameStates->isValid(i);
+      if (valid)
+        out.validFrames++;
+      if (valid && tmpbuf->dirty.load())
+        out.dirtyFrames++;
+      if (frameStates->pinCnt(i).load() > 0)
+        out.pinnedFrames++;
+    }
+  }
+}
+
+std::string BufMgr::exportMetrics(const MetricsFormat fmt)
+{
+  BufMetricsSnapshot snapshot;
+  collectMetrics(snapshot);
+  return snapshot.format(fmt);
+}
+
+bool BufMgr::writeMetrics(const std::string& path, const MetricsFormat fmt)
+{
+  const std::string text = exportMetrics(fmt);
+  const std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream out(tmpPath.c_str(), std::ios::out | std::ios::trunc);
+    out << text;
+    out.close();
+    if (out.fail())
+      return false;
+  }
+  return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+bool BufMgr::saveSnapshot(const std::string& path)
+{
+  // pages by file name, with whether each was referenced recently
+  std::map<std::string, std::vector<std::pair<PageId, bool> > > pages;
+  for (std::size_t p = 0; p < partitions.size(); p++)
+  {
+    BufPartition& part = *partitions[p];
+    // a frame stays in its file's list, with its file and page, while fileFramesLatch is held
+    std::lock_guard<std::mutex> lock(part.fileFramesLatch);
+    for (std::unordered_map<FileId, BufPartition::FileFrames>::const_iterator it = part.fileFrames.begin();
+         it != part.fileFrames.end(); ++it)
+    {
+      const std::vector<FrameId>& frames = it->second.frames;
+      if (frames.empty())
+        continue;
+      std::vector<std::pair<PageId, bool> >& filePages = pages[it->second.handle->filename()];
+      for (std::size_t i = 0; i < frames.size(); i++)
+        filePages.push_back(std::make_pair(bufDescTable[frames[i]].pageNo, frameStates->isReferenced(frames[i])));
+    }
+  }
+
+  const std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream out(tmpPath.c_str(), std::ios::out | std::ios::trunc);
+    out << SNAPSHOT_HEADER << "\n";
+    for (std::map<std::string, std::vector<std::pair<PageId, bool> > >::iterator it = pages.begin();
+         it != pages.end(); ++it)
+    {
+      std::sort(it->second.begin(), it->second.end());
+      out << "file " << it->first << "\n";
+      for (std::size_t i = 0; i < it->second.size(); i++)
+      {
+        // two File objects on one file may both have had the page
+        if (i > 0 && it->second[i].first == it->second[i - 1].first)
+          continue;
+        out << it->second[i].first << " " << it->second[i].second << "\n";
+      }
+    }
+    out.close();
+    if (out.fail())
+      return false;
+  }
+  return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+std::size_t BufMgr::loadSnapshot(const std::string& path, const std::vector<File*>& files,
+                                 const bool background)
+{
+  std::ifstream in(path.c_str());
+  std::string line;
+  if (!std::getline(in, line) || line != SNAPSHOT_HEADER)
+    return 0;
+
+  // entries of the files asked for, in snapshot order: a file name line, then its pages
+  struct Entry
+  {
+    File* file;
+    PageId pageNo;
+    bool hot;
+  };
+  std::vector<Entry> entries;
+  File* current = NULL;
+  while (std::getline(in, line))
+  {
+    if (line.compare(0, 5, "file ") == 0)
+    {
+      current = NULL;
+      for (std::size_t i = 0; i < files.size(); i++)
+      {
+        if (files[i]->filename() == line.substr(5))
+          current = files[i];
+      }
+      continue;
+    }
+    unsigned long pageNo = 0;
+    int hot = 0;
+    if (current == NULL || std::sscanf(line.c_str(), "%lu %d", &pageNo, &hot) != 2)
+      continue;
+    Entry entry = { current, (PageId) pageNo, hot != 0 };
+    entries.push_back(entry);
+  }
+
+  // if the pool got smaller, keep the recently referenced pages
+  std::stable_partition(entries.begin(), entries.end(), [](const Entry& e) { return e.hot; });
+  if (entries.size() > numBufs)
+    entries.resize(numBufs);
+
+  std::map<File*, std::vector<PageId> > byFile;
+  for (std::size_t i = 0; i < entries.size(); i++)
+    byFile[entries[i].file].push_back(entries[i].pageNo);
+
+  std::size_t loaded = 0;
+  for (std::map<File*, std::vector<PageId> >::iterator it = byFile.begin(); it != byFile.end(); ++it)
+  {
+    std::vector<PageId>& pageIds = it->second;
+    std::sort(pageIds.begin(), pageIds.end());
+    if (background)
+    {
+      prefetch(it->first, pageIds);
+      loaded += pageIds.size();
+      continue;
+    }
+    for (std::size_t i = 0; i < pageIds.size(); i++)
+    {
+      PrefetchRequest request = { it->first, pageIds[i], NULL };
+      try
+      {
+        if (prefetchPage(request))
+          loaded++;
+      }
+      catch (BadgerDbException&)
+      {
+        // the page was deleted or the file shrank since the snapshot was taken
+      }
+    }
+  }
+  return loaded;
+}
+
+void BufMgr::startMetricsExport(const std::string& path, const MetricsFormat fmt,
+                                const std::chrono::milliseconds interval)
+{
+  if (exportThread.joinable())
+    return;
+
+  exportPath = path;
+  exportFormat = fmt;
+  exportInterval = interval;
+  exportStop = false;
+  exportThread = std::thread(&BufMgr::exportLoop, this);
+}
+
+void BufMgr::stopMetricsExport()
+{
+  if (!exportThread.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(waitMutex);
+    exportStop = true;
+  }
+  exportWake.notify_one();
+  exportThread.join();
+  writeMetrics(exportPath, exportFormat);
+}
+
+void BufMgr::exportLoop()
+{
+  std::unique_lock<std::mutex> lock(waitMutex);
+  while (!exportStop)
+  {
+    lock.unlock();
+    writeMetrics(exportPath, exportFormat);
+    lock.lock();
+    if (!exportStop)
+      exportWake.wait_for(lock, exportInterval);
+  }
+}
+
+//----------------------------------------
+// PageHandle
+//----------------------------------------
+
+PageHandle::PageHandle(PageHandle&& other)
+	: bufMgr(other.bufMgr), file_(other.file_), pageNo_(other.pageNo_), frameNo_(other.frameNo_),
+	  page_(other.page_), dirty(other.dirty)
+{
+  other.page_ = NULL;
+  other.dirty = false;
+}
+
+PageHandle& PageHandle::operator=(PageHandle&& other)
+{
+  if (this != &other)
+  {
+    release();
+    bufMgr = other.bufMgr;
+    file_ = other.file_;
+    pageNo_ = other.pageNo_;
+    frameNo_ = other.frameNo_;
+    page_ = other.page_;
+    dirty = other.dirty;
+    other.page_ = NULL;
+    other.dirty = false;
+  }
+  return *this;
+}
+
+void PageHandle::release()
+{
+  if (page_ == NULL)
+    return;
+  bufMgr->unpinFrame(frameNo_, dirty);
+  page_ = NULL;
+  dirty = false;
 }
 
 }
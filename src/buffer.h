@@ -9,17 +9,303 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include "buf_metrics.h"
+#include "replacement_policy.h"
+#include "victim_cache.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace badgerdb {
 
+/**
+* @brief Kinds of memory the buffer pool can be allocated from
+*/
+enum PoolMemory
+{
+	POOL_DEFAULT = 0,	/* one anonymous mapping in normal pages */
+	POOL_TRANSPARENT_HUGE = 1,	/* 2 MB aligned, with madvise(MADV_HUGEPAGE) */
+	POOL_EXPLICIT_HUGE = 2	/* MAP_HUGETLB; falls back to transparent huge pages without a hugetlb reserve */
+};
+
+/**
+* @brief Outcome of the non-throwing BufMgr calls. The throwing calls turn anything but
+* BUF_OK into the matching exception.
+*/
+enum BufStatus
+{
+	BUF_OK = 0,	/* the call did its work */
+	BUF_EXCEEDED = 1,	/* every frame stayed pinned for the pin wait timeout (BufferExceededException) */
+	BUF_PAGE_PINNED = 2,	/* a page the call had to write out or drop is pinned (PagePinnedException) */
+	BUF_NOT_RESIDENT = 3,	/* the page is not in the buffer pool (HashNotFoundException) */
+	BUF_NOT_PINNED = 4	/* the page is in the buffer pool but not pinned (PageNotPinnedException) */
+};
+
+/**
+* @brief How long the caller expects a page to be wanted, passed to BufMgr when pinning or
+* unpinning it. The last KEEP or EVICT_SOON given for a page holds until it leaves the pool.
+*/
+enum PageHint
+{
+	HINT_NORMAL = 0,	/* no opinion; a page marked EVICT_SOON which is pinned again loses the mark */
+	HINT_KEEP = 1,	/* used all the time, such as B+tree inner nodes: evicted only if every other frame is pinned */
+	HINT_EVICT_SOON = 2	/* not wanted again, such as pages of a scan: the next victim once unpinned */
+};
+
+/**
+* @brief When BufMgr waits for written pages to reach stable storage. Page writes themselves
+* only hand the pages to the operating system.
+*/
+enum Durability
+{
+	DURABILITY_NONE = 0,	/* never; the operating system writes pages back when it sees fit */
+	SYNC_ON_FLUSHFILE = 1,	/* at the end of every flushFile() */
+	SYNC_ON_COMMIT = 2	/* at the end of every commit(), the sync points of the caller */
+};
+
 /**
 * forward declaration of BufMgr class 
 */
 class BufMgr;
 
+/**
+* @brief Eviction state of every frame in the buffer pool: pin counts, valid and reference bits
+* and the PageHint marks
+*
+* Kept apart from the descriptors, as a dense array of pin counts and bitmaps with one
+* bit per frame, so that the clock sweep reads a few cache lines for thousands of frames and
+* can test 64 frames with one AND of a valid and a reference word. Everything is atomic: the
+* replacement policy inspects frames without taking any latch. Indexed by frame number in
+* the whole pool; the memory is mapped for the largest pool and zero, i.e. unpinned, invalid,
+* unreferenced and unhinted, until used.
+*/
+class FrameStateTable
+{
+ public:
+	/**
+	 * Frames covered by one bitmap word
+	 */
+	static const std::uint32_t WORD_BITS = 64;
+
+	/**
+	 * Constructor of FrameStateTable class
+	 *
+	 * @param frames	Most frames the pool can be resized to
+	 */
+	explicit FrameStateTable(const std::uint32_t frames);
+
+	~FrameStateTable();
+
+	FrameStateTable(const FrameStateTable&) = delete;
+	FrameStateTable& operator=(const FrameStateTable&) = delete;
+
+	/**
+	 * Number of times the frame's page has been pinned
+	 */
+	std::atomic<int>& pinCnt(const FrameId frame)
+	{
+		return pins[frame];
+	}
+
+	/**
+	 * True if the frame holds a page
+	 */
+	bool isValid(const FrameId frame) const
+	{
+		return (validBits[frame / WORD_BITS].load() & bit(frame)) != 0;
+	}
+
+	void setValid(const FrameId frame, const bool valid)
+	{
+		if (valid)
+			validBits[frame / WORD_BITS].fetch_or(bit(frame));
+		else
+			validBits[frame / WORD_BITS].fetch_and(~bit(frame));
+	}
+
+	/**
+	 * True if the frame has been referenced since the clock hand last passed it
+	 */
+	bool isReferenced(const FrameId frame) const
+	{
+		return (refBits[frame / WORD_BITS].load() & bit(frame)) != 0;
+	}
+
+	void setRef(const FrameId frame)
+	{
+		// hits on a hot page find the bit set; don't bounce its cache line around
+		std::atomic<std::uint64_t>& word = refBits[frame / WORD_BITS];
+		if ((word.load(std::memory_order_relaxed) & bit(frame)) == 0)
+			word.fetch_or(bit(frame));
+	}
+
+	/**
+	 * Clears the reference bit of the frame, returning its previous value.
+	 */
+	bool testAndClearRef(const FrameId frame)
+	{
+		return (refBits[frame / WORD_BITS].fetch_and(~bit(frame)) & bit(frame)) != 0;
+	}
+
+	/**
+	 * True if the frame's page was last hinted HINT_KEEP
+	 */
+	bool isKept(const FrameId frame) const
+	{
+		return (keepBits[frame / WORD_BITS].load() & bit(frame)) != 0;
+	}
+
+	/**
+	 * Marks the frame's page HINT_KEEP; returns false if it was marked already.
+	 */
+	bool setKeep(const FrameId frame)
+	{
+		if ((keepBits[frame / WORD_BITS].fetch_or(bit(frame)) & bit(frame)) != 0)
+			return false;
+		keptFrames++;
+		return true;
+	}
+
+	void clearKeep(const FrameId frame)
+	{
+		if ((keepBits[frame / WORD_BITS].fetch_and(~bit(frame)) & bit(frame)) != 0)
+			keptFrames--;
+	}
+
+	/**
+	 * True if the frame's page was last hinted HINT_EVICT_SOON
+	 */
+	bool isEvictSoon(const FrameId frame) const
+	{
+		return (soonBits[frame / WORD_BITS].load() & bit(frame)) != 0;
+	}
+
+	void setEvictSoon(const FrameId frame)
+	{
+		soonBits[frame / WORD_BITS].fetch_or(bit(frame));
+	}
+
+	void clearEvictSoon(const FrameId frame)
+	{
+		// most pins find the bit clear; don't bounce its cache line around
+		std::atomic<std::uint64_t>& word = soonBits[frame / WORD_BITS];
+		if ((word.load(std::memory_order_relaxed) & bit(frame)) != 0)
+			word.fetch_and(~bit(frame));
+	}
+
+	/**
+	 * Number of frames marked HINT_KEEP
+	 */
+	std::uint32_t numKept() const
+	{
+		return keptFrames.load();
+	}
+
+	/**
+	 * Valid bits of frames word * WORD_BITS to word * WORD_BITS + 63
+	 */
+	std::uint64_t validWord(const std::uint32_t word) const
+	{
+		return validBits[word].load();
+	}
+
+	/**
+	 * Reference bits of frames word * WORD_BITS to word * WORD_BITS + 63
+	 */
+	std::uint64_t refWord(const std::uint32_t word) const
+	{
+		return refBits[word].load();
+	}
+
+	/**
+	 * Clears the reference bits of the frames of one word selected by mask.
+	 */
+	void clearRefs(const std::uint32_t word, const std::uint64_t mask)
+	{
+		refBits[word].fetch_and(~mask);
+	}
+
+	/**
+	 * Marks a frame as newly assigned to a page: pinned once, valid and referenced, with
+	 * no hint.
+	 */
+	void assign(const FrameId frame)
+	{
+		pins[frame] = 1;
+		clearKeep(frame);
+		clearEvictSoon(frame);
+		setValid(frame, true);
+		setRef(frame);
+	}
+
+	/**
+	 * Marks a frame as holding no page. The pin count is left alone.
+	 */
+	void clear(const FrameId frame)
+	{
+		refBits[frame / WORD_BITS].fetch_and(~bit(frame));
+		clearKeep(frame);
+		clearEvictSoon(frame);
+		setValid(frame, false);
+	}
+
+	/**
+	 * Mask of count bits starting at bit first of a word
+	 */
+	static std::uint64_t bitRange(const std::uint32_t first, const std::uint32_t count)
+	{
+		return (count >= WORD_BITS ? ~(std::uint64_t) 0 : (((std::uint64_t) 1 << count) - 1)) << first;
+	}
+
+ private:
+	static std::uint64_t bit(const FrameId frame)
+	{
+		return (std::uint64_t) 1 << (frame % WORD_BITS);
+	}
+
+	/**
+	 * Pin count of every frame
+	 */
+	std::atomic<int>* pins;
+
+	/**
+	 * One bit per frame: holds a page, and referenced recently
+	 */
+	std::atomic<std::uint64_t>* validBits;
+	std::atomic<std::uint64_t>* refBits;
+
+	/**
+	 * One bit per frame: hinted HINT_KEEP, and hinted HINT_EVICT_SOON
+	 */
+	std::atomic<std::uint64_t>* keepBits;
+	std::atomic<std::uint64_t>* soonBits;
+
+	/**
+	 * Number of bits set in keepBits
+	 */
+	std::atomic<std::uint32_t> keptFrames;
+
+	/**
+	 * Memory mapping holding the five arrays, and its length
+	 */
+	void* region;
+	std::size_t regionSize;
+};
+
+
 /**
 * @brief Class for maintaining information about buffer pool frames
+*
+* Holds which page a frame has; the state the replacement policy sweeps over (pin count,
+* valid and reference bits) is in the FrameStateTable. dirty, ioInProgress and writeInProgress are atomics,
+* as they are tested without a latch. file, fileId and pageNo only change while the frame
+* is exclusively claimed (see BufMgr::allocBuf) and under the hash table partition latch.
 */
 class BufDesc {
 
@@ -27,10 +313,21 @@ class BufDesc {
 
  private:
 	/**
-   * Pointer to file to which corresponding frame is assigned
+   * Id of the file to which corresponding frame is assigned
+	 */
+  FileId fileId;
+
+	/**
+   * File object the page is written back through: the owning partition's own one for the
+	 * file, so it outlives whichever File object the page was read with
 	 */
   File* file;
 
+	/**
+   * Hit and miss counters of the file, taken over from the partition with file
+	 */
+  BufMetrics::FileCounts* counts;
+
 	/**
    * Page within file to which corresponding frame is assigned
 	 */
@@ -42,41 +339,44 @@ class BufDesc {
   FrameId	frameNo;
 
 	/**
-   * Number of times this page has been pinned
+   * True if page is dirty;  false otherwise
 	 */
-  int pinCnt;
+  std::atomic<bool> dirty;
 
 	/**
-   * True if page is dirty;  false otherwise
+   * True while the page is being read from disk into the frame
 	 */
-  bool dirty;
+  std::atomic<bool> ioInProgress;
 
 	/**
-   * True if page is valid
+   * True while an eviction writes the page out; set before the dirty flag is cleared
 	 */
-  bool valid;
+  std::atomic<bool> writeInProgress;
 
 	/**
-   * Has this buffer frame been reference recently
+   * Position of the frame in its partition's list of frames of the same file
 	 */
-  bool refbit;
+  std::uint32_t fileSlot;
 
 	/**
-   * Initialize buffer frame for a new user
+   * Initialize buffer frame for a new user.
+	 * The frame's state in the FrameStateTable is cleared by the caller.
 	 */
   void Clear()
 	{
-    pinCnt = 0;
 		file = NULL;
+		counts = NULL;
+		fileId = File::INVALID_ID;
 		pageNo = Page::INVALID_NUMBER;
     dirty = false;
-    refbit = false;
-		valid = false;
+		ioInProgress = false;
+		writeInProgress = false;
   };
 
 	/**
 	 * Set values of member variables corresponding to assignment of frame to a page in the file. Called when a frame 
 	 * in buffer pool is allocated to any page in the file through readPage() or allocPage()
+	 * The caller marks the frame as assigned in the FrameStateTable afterwards.
 	 *
 	 * @param filePtr	File object
 	 * @param pageNum	Page number in the file
@@ -84,14 +384,17 @@ class BufDesc {
   void Set(File* filePtr, PageId pageNum)
 	{ 
 		file = filePtr;
+		fileId = filePtr->id();
     pageNo = pageNum;
-    pinCnt = 1;
     dirty = false;
-    valid = true;
-    refbit = true;
   }
 
-  void Print()
+	/**
+	 * Print the frame
+	 *
+	 * @param states	Eviction state of the pool
+	 */
+  void Print(FrameStateTable& states)
 	{
 		if(file != NULL)
 		{
@@ -101,10 +404,10 @@ class BufDesc {
 		else
 			std::cout << "file:NULL ";
 
-		std::cout << "valid:" << valid << " ";
-		std::cout << "pinCnt:" << pinCnt << " ";
+		std::cout << "valid:" << states.isValid(frameNo) << " ";
+		std::cout << "pinCnt:" << states.pinCnt(frameNo) << " ";
 		std::cout << "dirty:" << dirty << " ";
-		std::cout << "refbit:" << refbit << "\n";
+		std::cout << "refbit:" << states.isReferenced(frameNo) << "\n";
   }
 
 	/**
@@ -112,6 +415,7 @@ class BufDesc {
 	 */
   BufDesc()
 	{
+		fileSlot = 0;
   	Clear();
   }
 };
@@ -125,17 +429,77 @@ struct BufStats
 	/**
    * Total number of accesses to buffer pool
 	 */
-  int accesses;
+  std::atomic<int> accesses;
 
 	/**
    * Number of pages read from disk (including allocs)
 	 */
-  int diskreads;
+  std::atomic<int> diskreads;
 
 	/**
    * Number of pages written back to disk
 	 */
-  int diskwrites;
+  std::atomic<int> diskwrites;
+
+	/**
+   * Number of dirty pages written back by the background writer
+	 */
+  std::atomic<int> writerWrites;
+
+	/**
+   * Number of dirty pages an eviction still had to write back itself
+	 */
+  std::atomic<int> evictionWrites;
+
+	/**
+   * Number of pages read ahead by the prefetch workers
+	 */
+  std::atomic<int> prefetchReads;
+
+	/**
+   * Number of accesses which found the page in the buffer pool
+	 */
+  std::atomic<int> hits;
+
+	/**
+   * Number of accesses which had to bring the page into a frame (reads and allocs)
+	 */
+  std::atomic<int> misses;
+
+	/**
+   * Number of misses which looked in the compressed victim cache before the file
+	 */
+  std::atomic<int> victimLookups;
+
+	/**
+   * Number of misses served from the compressed victim cache instead of the file
+	 */
+  std::atomic<int> victimHits;
+
+	/**
+   * Nanoseconds spent decompressing pages taken from the victim cache
+	 */
+  std::atomic<std::uint64_t> victimDecompressNanos;
+
+	/**
+   * Number of hits on pages marked HINT_KEEP
+	 */
+  std::atomic<int> keptHits;
+
+	/**
+   * Number of pages marked HINT_KEEP evicted anyway, as every other frame was pinned
+	 */
+  std::atomic<int> keptEvictions;
+
+	/**
+   * Number of victims taken from the pages unpinned with HINT_EVICT_SOON, ahead of the policy
+	 */
+  std::atomic<int> evictSoonVictims;
+
+	/**
+   * Name of the replacement policy the numbers were collected under
+	 */
+  const char* policyName;
 
 	/**
    * Clear all values 
@@ -143,12 +507,35 @@ struct BufStats
   void clear()
   {
 		accesses = diskreads = diskwrites = 0;
+		writerWrites = evictionWrites = 0;
+		prefetchReads = 0;
+		hits = misses = 0;
+		victimLookups = victimHits = 0;
+		victimDecompressNanos = 0;
+		keptHits = keptEvictions = evictSoonVictims = 0;
+  }
+
+	/**
+   * Fraction of accesses served from the buffer pool
+	 */
+  double hitRatio() const
+  {
+		return accesses == 0 ? 0.0 : (double) hits / accesses;
+  }
+
+	/**
+   * Fraction of victim cache lookups which found the page
+	 */
+  double victimHitRatio() const
+  {
+		return victimLookups == 0 ? 0.0 : (double) victimHits / victimLookups;
   }
       
 	/**
    * Constructor of BufStats class 
 	 */
   BufStats()
+		: policyName("")
   {
 		clear();
   }
@@ -156,139 +543,1484 @@ struct BufStats
 
 
 /**
-* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+* @brief A small private set of frames recycled by a bulk reader such as FileScan
+*
+* Once the ring holds its full number of pages, a miss reuses the frame of the oldest page
+* in the ring instead of taking a victim from the shared pool, so a sweep over a large
+* relation displaces at most the ring's worth of other pages. Pages the reader finds in
+* the pool are used in place and don't enter the ring. If every ring frame is pinned the
+* miss falls back to the replacement policy and the ring grows by one frame.
+*
+* A ring belongs to a single reader. BufMgr's prefetch workers may load pages into it on
+* the reader's behalf, so the slots are guarded by a latch.
 */
-class BufMgr 
+class BufferRing
 {
- private:
-	/**
-   * Current position of clockhand in our buffer pool
-	 */
-  FrameId clockHand;
+	friend class BufMgr;
 
+ public:
 	/**
-   * Number of frames in the buffer pool
+	 * Number of frames a ring keeps by default
 	 */
-  std::uint32_t numBufs;
-	
+	static const std::uint32_t DEFAULT_SIZE = 16;
+
 	/**
-   * Hash table mapping (File, page) to frame
+	 * Constructor of BufferRing class
+	 *
+	 * @param sizeIn	Number of frames to fill before frames are recycled
 	 */
-  BufHashTbl *hashTable;
+	BufferRing(const std::uint32_t sizeIn = DEFAULT_SIZE)
+		: size(sizeIn > 0 ? sizeIn : 1), next(0)
+	{
+	}
 
+ private:
 	/**
-   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+	 * A frame of the ring and the page it was loaded with; file is File::INVALID_ID once
+	 * that page is gone
 	 */
-  BufDesc *bufDescTable;
+	struct Slot
+	{
+		FrameId frameNo;
+		FileId file;
+		PageId pageNo;
+	};
 
 	/**
-   * Maintains Buffer pool usage statistics 
+	 * Records that a page was loaded into a frame of the ring.
+	 *
+	 * @param slot   	Slot whose frame was reused, or -1 for a frame from the shared pool
+	 * @param frameNo	Frame now holding the page
+	 * @param file   	Id of the file of the page
+	 * @param pageNo 	Page number in the file
 	 */
-  BufStats bufStats;
+	void assign(const long slot, const FrameId frameNo, const FileId file, const PageId pageNo)
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		Slot entry = { frameNo, file, pageNo };
+		if (slot >= 0)
+		{
+			slots[slot] = entry;
+			return;
+		}
+		for (std::size_t i = 0; i < slots.size(); i++)
+		{
+			if (slots[i].file == File::INVALID_ID)
+			{
+				slots[i] = entry;
+				return;
+			}
+		}
+		slots.push_back(entry);
+	}
 
 	/**
-	 * Allocate a free frame.  
+	 * Records that the page of a slot is gone without the slot's frame being reused.
 	 *
-	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
-	 * @throws BufferExceededException If no such buffer is found which can be allocated
+	 * @param slot	Slot to empty
 	 */
-  void allocBuf(FrameId & frame);
+	void forget(const long slot)
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		slots[slot].file = File::INVALID_ID;
+	}
 
 	/**
-   * Advance clock to next frame in the buffer pool
+	 * Guards slots and next
 	 */
-  void advanceClock()
-  {
-		clockHand = (clockHand + 1) % numBufs;
-  }
-
+	std::mutex latch;
 
- public:
 	/**
-   * Actual buffer pool from which frames are allocated
+	 * Slots of the ring
 	 */
-  Page* bufPool;
+	std::vector<Slot> slots;
 
 	/**
-   * Constructor of BufMgr class
+	 * Number of slots to fill before frames are recycled
 	 */
-  BufMgr(std::uint32_t bufs);
-	
+	std::uint32_t size;
+
 	/**
-   * Destructor of BufMgr class
+	 * Next slot to recycle
 	 */
-  ~BufMgr();
+	std::size_t next;
+};
+
+
+/**
+* @brief A pin on a page in the buffer pool, dropped when the handle goes away
+*
+* Returned by BufMgr::pinPage() and BufMgr::pinNewPage(). The handle remembers the frame
+* holding the page, so unpinning needs no hash table lookup. Handles can be moved but not
+* copied; moving one hands the pin over. A handle must be released or destroyed before the
+* BufMgr it came from.
+*/
+class PageHandle
+{
+	friend class BufMgr;
 
+ public:
 	/**
-	 * Reads the given page from the file into a frame and returns the pointer to page.
-	 * If the requested page is already present in the buffer pool pointer to that frame is returned
-	 * otherwise a new frame is allocated from the buffer pool for reading the page.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number in the file to be read
-	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * Constructs a handle holding no page
 	 */
-  void readPage(File* file, const PageId PageNo, Page*& page);
+	PageHandle()
+		: bufMgr(NULL), file_(NULL), pageNo_(Page::INVALID_NUMBER), frameNo_(0), page_(NULL), dirty(false)
+	{
+	}
 
 	/**
-	 * Unpin a page from memory since it is no longer required for it to remain in memory.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number
-	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
-   * @throws  PageNotPinnedException If the page is not already pinned
+	 * Takes over the pin of another handle, which is left empty
 	 */
-  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+	PageHandle(PageHandle&& other);
 
 	/**
-	 * Allocates a new, empty page in the file and returns the Page object.
-	 * The newly allocated page is also assigned a frame in the buffer pool.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
-	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+	 * Drops the pin held, if any, and takes over the pin of another handle
 	 */
-  void allocPage(File* file, PageId &PageNo, Page*& page); 
+	PageHandle& operator=(PageHandle&& other);
+
+	PageHandle(const PageHandle&) = delete;
+	PageHandle& operator=(const PageHandle&) = delete;
 
 	/**
-	 * Writes out all dirty pages of the file to disk.
-	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
-	 * Otherwise Error returned.
-	 *
-	 * @param file   	File object
-   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
-   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+	 * Drops the pin held, if any
 	 */
-  void flushFile(const File* file);
+	~PageHandle()
+	{
+		release();
+	}
 
 	/**
-	 * Delete page from file and also from buffer pool if present.
-	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number
+	 * Unpins the page now, writing it back later if it was marked dirty. The handle is
+	 * left empty.
 	 */
-  void disposePage(File* file, const PageId PageNo);
+	void release();
 
 	/**
-   * Print member variable values. 
+	 * Records that the page was changed, so it is written back before it leaves the pool
 	 */
-  void  printSelf();
+	void markDirty()
+	{
+		dirty = true;
+	}
 
 	/**
-   * Get buffer pool usage statistics
+	 * True if the handle holds a pinned page
 	 */
-  BufStats & getBufStats()
-  {
-		return bufStats;
+	bool valid() const
+	{
+		return page_ != NULL;
+	}
+
+	/**
+	 * The pinned page, or NULL for an empty handle
+	 */
+	Page* page() const
+	{
+		return page_;
+	}
+
+	Page* operator->() const
+	{
+		return page_;
+	}
+
+	Page& operator*() const
+	{
+		return *page_;
+	}
+
+	/**
+	 * File and number of the pinned page
+	 */
+	File* file() const
+	{
+		return file_;
+	}
+
+	PageId pageNo() const
+	{
+		return pageNo_;
+	}
+
+ private:
+	/**
+	 * Constructor used by BufMgr for a page it has just pinned
+	 */
+	PageHandle(BufMgr* mgr, File* file, const PageId pageNo, const FrameId frameNo, Page* page)
+		: bufMgr(mgr), file_(file), pageNo_(pageNo), frameNo_(frameNo), page_(page), dirty(false)
+	{
+	}
+
+	BufMgr* bufMgr;
+	File* file_;
+	PageId pageNo_;
+	FrameId frameNo_;
+	Page* page_;
+
+	/**
+	 * True if markDirty() was called
+	 */
+	bool dirty;
+};
+
+
+/**
+* @brief One independent slice of the buffer pool
+*
+* A partition owns a contiguous range of frames, starting at firstFrame in bufPool and
+* bufDescTable, with its own hash table, replacement policy and usage statistics. Threads
+* working on pages of different partitions share no latch and no clock hand.
+*/
+class BufPartition
+{
+	friend class BufMgr;
+
+ private:
+	/**
+	 * Frame number of the partition's first frame
+	 */
+	FrameId firstFrame;
+
+	/**
+	 * Number of frames in use, from firstFrame on; changes when the pool is resized
+	 */
+	std::atomic<std::uint32_t> numBufs;
+
+	/**
+	 * Frames reserved for the partition; the next partition starts this far on
+	 */
+	std::uint32_t maxBufs;
+
+	/**
+	 * Number of descriptors ever constructed, at least numBufs
+	 */
+	std::uint32_t constructedBufs;
+
+	/**
+	 * Hash table mapping the (File, page) pairs routed to this partition to frames
+	 */
+	BufHashTbl* hashTable;
+
+	/**
+	 * Chooses victims among the partition's frames; works in frame numbers relative to firstFrame
+	 */
+	ReplacementPolicy* policy;
+
+	/**
+	 * Usage statistics of the partition's frames
+	 */
+	BufStats bufStats;
+
+	/**
+	 * Frames of the partition holding a page of one file, and the File object the partition
+	 * opened to write them back through. It is opened with the first frame and kept, even
+	 * while no frame holds a page of the file, until every other File object of the file is
+	 * closed (see BufMgr::fileClosed()), so the pages never depend on the File objects of
+	 * their readers staying open and the file keeps its id for as long as it has pages here.
+	 */
+	struct FileFrames
+	{
+		File* handle;
+		BufMetrics::FileCounts* counts;
+		std::vector<FrameId> frames;
+	};
+
+	/**
+	 * Frames of the partition holding a page, by file id, so that the pages of one file can
+	 * be found without sweeping the pool. BufDesc::fileSlot is a frame's position in its list.
+	 */
+	std::unordered_map<FileId, FileFrames> fileFrames;
+
+	/**
+	 * Guards fileFrames. Taken after a hash table latch, never before one.
+	 */
+	std::mutex fileFramesLatch;
+
+	/**
+	 * Frames of the partition whose pages were unpinned marked HINT_EVICT_SOON, oldest
+	 * first. An entry goes stale when its page is pinned again or leaves the pool, and is
+	 * dropped when it comes up.
+	 */
+	std::deque<FrameId> evictSoon;
+
+	/**
+	 * Number of entries in evictSoon, so misses can skip the latch while it is empty
+	 */
+	std::atomic<std::uint32_t> evictSoonCount;
+
+	/**
+	 * Guards evictSoon. No other latch is taken while it is held.
+	 */
+	std::mutex evictSoonLatch;
+
+	/**
+	 * Keeps the statistics of neighbouring partitions off each other's cache lines
+	 */
+	char padding[64];
+
+	/**
+	 * Constructor of BufPartition class. The descriptors of the first bufs frames must be
+	 * constructed already.
+	 *
+	 * @param first     	Frame number of the first frame
+	 * @param bufs      	Number of frames in use
+	 * @param reserved  	Number of frames reserved
+	 * @param states    	Eviction state of the pool
+	 * @param policyType	Page replacement algorithm to use
+	 */
+	BufPartition(const FrameId first, const std::uint32_t bufs, const std::uint32_t reserved,
+	             FrameStateTable* states, const ReplacementPolicyType policyType)
+		: firstFrame(first), numBufs(bufs), maxBufs(reserved), constructedBufs(bufs),
+		  hashTable(new BufHashTbl(bufs)),
+		  policy(ReplacementPolicy::create(policyType, states, first, bufs, reserved)),
+		  evictSoonCount(0)
+	{
+	}
+
+	~BufPartition()
+	{
+		for (std::unordered_map<FileId, FileFrames>::iterator it = fileFrames.begin(); it != fileFrames.end(); ++it)
+			delete it->second.handle;
+		delete policy;
+		delete hashTable;
+	}
+};
+
+
+/**
+* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file
+*
+* All public methods may be called concurrently from several threads. The pool is split
+* into one or more BufPartitions and every page is routed to one of them by a hash of
+* (file, pageNo). Lookups and pins are done under the latch of the page's hash table
+* partition within it. Victims are chosen by the partition's ReplacementPolicy and claimed
+* by moving their pin count from 0 to 1 with a compare-and-swap; a partition whose frames
+* are all pinned borrows a frame from another one. The PageHint a page is pinned or unpinned
+* with bends that choice: pages unpinned marked HINT_EVICT_SOON are taken before the policy
+* is asked, and pages marked HINT_KEEP are passed over while any other frame can be claimed. A thread that finds every frame pinned
+* waits for an unpin (up to the pin wait timeout) instead of failing straight away.
+*/
+class BufMgr : private FileCloseListener
+{
+	friend class PageHandle;
+
+ private:
+	/**
+   * Number of frames in the buffer pool; changes when the pool is resized
+	 */
+  std::atomic<std::uint32_t> numBufs;
+
+	/**
+	 * Most frames the pool can be resized to; bufPool and bufDescTable are mapped this large
+	 */
+  std::uint32_t maxBufs;
+
+	/**
+	 * Partitions of the pool; partition i holds the frames from i * partitionStride on
+	 */
+  std::vector<BufPartition*> partitions;
+
+	/**
+	 * Number of frames reserved for each partition
+	 */
+  std::uint32_t partitionStride;
+
+	/**
+	 * Partition allocPage takes its next frame from; pages are numbered only once they have one
+	 */
+  std::atomic<std::uint32_t> nextAllocPartition;
+
+	/**
+	 * Serializes resize() calls
+	 */
+  std::mutex resizeMutex;
+
+	/**
+   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+	 */
+  BufDesc *bufDescTable;
+
+	/**
+	 * Pin counts, valid and reference bits of every frame, swept by the replacement policies
+	 */
+  FrameStateTable* frameStates;
+
+	/**
+   * Buffer pool usage statistics, added up from the partitions by getBufStats()
+	 */
+  BufStats bufStats;
+
+	/**
+   * Per-file, eviction, latency and pinning metrics
+	 */
+  BufMetrics metrics;
+
+	/**
+	 * Index of the partition a page is routed to
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+  std::uint32_t homeIndex(const File* file, const PageId pageNo) const
+  {
+		// the hash table picks its latch from the top bits, so route on other ones
+		return (std::uint32_t) ((BufHashTbl::hash(file->id(), pageNo) >> 32) % partitions.size());
+  }
+
+	/**
+	 * Partition a page is routed to; its hash table says where the page is
+	 */
+  BufPartition& homePartition(const File* file, const PageId pageNo) const
+  {
+		return *partitions[homeIndex(file, pageNo)];
+  }
+
+	/**
+	 * Partition owning a frame; its policy and statistics account for the frame
+	 */
+  BufPartition& framePartition(const FrameId frameNo) const
+  {
+		return *partitions[frameNo / partitionStride];
+  }
+
+	/**
+	 * Grow or shrink one partition, as resize() does for the pool.
+	 *
+	 * @param part     	Partition to resize
+	 * @param newFrames	Number of frames wanted, at least 1 and at most part.maxBufs
+	 * @return  				Number of frames the partition has now.
+	 */
+  std::uint32_t resizePartition(BufPartition& part, const std::uint32_t newFrames);
+
+	/**
+	 * Memory mappings holding bufPool and bufDescTable, and their lengths
+	 */
+  void* poolRegion;
+  std::size_t poolRegionSize;
+  void* descRegion;
+  std::size_t descRegionSize;
+
+	/**
+	 * Kind of memory bufPool ended up in
+	 */
+  PoolMemory poolMemory;
+
+	/**
+	 * Map the memory for the buffer pool. Frames are constructed by the caller.
+	 *
+	 * @param requested    	Kind of memory to try first
+	 * @param numPartitions	Number of partitions the pool is split into
+	 */
+  void allocPool(const PoolMemory requested, const std::uint32_t numPartitions);
+
+	/**
+	 * Mutex paired with frameFreed and ioDone
+	 */
+  std::mutex waitMutex;
+
+	/**
+	 * Signalled when a pin count drops to zero and some thread is waiting for a frame
+	 */
+  std::condition_variable frameFreed;
+
+	/**
+	 * Signalled when a frame finishes loading from disk
+	 */
+  std::condition_variable ioDone;
+
+	/**
+	 * Incremented every time a pin count drops to zero while some thread waits for a frame
+	 */
+  std::atomic<std::uint32_t> unpinEpoch;
+
+	/**
+	 * Number of threads in allocBuf about to wait for a frame. It is raised before the last
+	 * look for a free frame, so an unpin either lets that look succeed or sees the waiter.
+	 */
+  std::atomic<int> frameWaiters;
+
+	/**
+	 * How long allocBuf waits for a frame to be unpinned before giving up
+	 */
+  std::chrono::milliseconds pinWaitTimeout;
+
+	/**
+	 * Background writer thread, if started
+	 */
+  std::thread writerThread;
+
+	/**
+	 * Tells the background writer to exit; guarded by waitMutex
+	 */
+  bool writerStop;
+
+	/**
+	 * Signalled to wake the background writer early, e.g. when an eviction had to write
+	 */
+  std::condition_variable writerWake;
+
+	/**
+	 * Held by the background writer while it has frames claimed, by flushFile and commit so
+	 * they never mistake the writer's pin for a user's, and by disposePage so it never takes
+	 * over a frame the writer is writing out
+	 */
+  std::mutex writeBackMutex;
+
+	/**
+	 * When written pages are synced to stable storage
+	 */
+  Durability durability;
+
+	/**
+	 * Number of frames ahead of the replacement policy the background writer keeps clean
+	 */
+  std::uint32_t writerLookahead;
+
+	/**
+	 * How long the background writer sleeps between passes
+	 */
+  std::chrono::milliseconds writerInterval;
+
+	/**
+	 * Main loop of the background writer thread.
+	 */
+  void writerLoop();
+
+	/**
+	 * One pass of the background writer: writes out the dirty pages among the next
+	 * writerLookahead victims of the replacement policy, in page number order.
+	 */
+  void writeBehind();
+
+	/**
+	 * Thread writing the metrics to exportPath every exportInterval, if started
+	 */
+  std::thread exportThread;
+
+	/**
+	 * Tells the metrics export thread to exit; guarded by waitMutex
+	 */
+  bool exportStop;
+
+	/**
+	 * Signalled to stop the metrics export thread
+	 */
+  std::condition_variable exportWake;
+
+	/**
+	 * Where, in which format and how often the export thread writes the metrics
+	 */
+  std::string exportPath;
+  MetricsFormat exportFormat;
+  std::chrono::milliseconds exportInterval;
+
+	/**
+	 * Snapshot file written by the destructor, if not empty
+	 */
+  std::string shutdownSnapshot;
+
+	/**
+	 * Second tier holding evicted pages in compressed form; disabled unless given a budget
+	 */
+  VictimCache victimCache;
+
+	/**
+	 * Main loop of the metrics export thread.
+	 */
+  void exportLoop();
+
+	/**
+	 * Thread sizing the pool from the cgroup memory limit, if started
+	 */
+  std::thread autoResizeThread;
+
+	/**
+	 * Tells the auto-resize thread to exit; guarded by waitMutex
+	 */
+  bool autoResizeStop;
+
+	/**
+	 * Signalled to stop the auto-resize thread
+	 */
+  std::condition_variable autoResizeWake;
+
+	/**
+	 * Share of the memory limit the pool is sized to, and how often the limit is checked
+	 */
+  double autoResizeFraction;
+  std::chrono::milliseconds autoResizeInterval;
+
+	/**
+	 * Main loop of the auto-resize thread.
+	 */
+  void autoResizeLoop();
+
+	/**
+	 * @brief A page to be loaded by a prefetch worker
+	 */
+  struct PrefetchRequest
+  {
+		File* file;
+		PageId pageNo;
+		BufferRing* ring;
+  };
+
+	/**
+	 * Pages waiting for a prefetch worker, in the order they were asked for
+	 */
+  std::deque<PrefetchRequest> prefetchQueue;
+
+	/**
+	 * Prefetch worker threads, started by the first prefetch
+	 */
+  std::vector<std::thread> prefetchWorkers;
+
+	/**
+	 * File each prefetch worker is loading a page of, or NULL if it is idle
+	 */
+  std::vector<const File*> prefetchInFlight;
+
+	/**
+	 * Guards prefetchQueue, prefetchInFlight and prefetchStop
+	 */
+  std::mutex prefetchMutex;
+
+	/**
+	 * Signalled when requests are queued or the workers have to stop
+	 */
+  std::condition_variable prefetchReady;
+
+	/**
+	 * Signalled when a prefetch worker finishes a page
+	 */
+  std::condition_variable prefetchIdle;
+
+	/**
+	 * Tells the prefetch workers to exit
+	 */
+  bool prefetchStop;
+
+	/**
+	 * Number of prefetch workers to start
+	 */
+  std::uint32_t numPrefetchWorkers;
+
+	/**
+	 * Main loop of a prefetch worker thread.
+	 *
+	 * @param worker	Index of the worker in prefetchInFlight
+	 */
+  void prefetchLoop(const std::uint32_t worker);
+
+	/**
+	 * Loads one requested page unless it is resident already or no frame is free, and
+	 * leaves it unpinned in the pool.
+	 *
+	 * @param request	Page to load
+	 * @return  			True if the page was read into the pool
+	 */
+  bool prefetchPage(const PrefetchRequest& request);
+
+	/**
+	 * Drops a queued prefetch of a page which a reader is about to read itself, so a
+	 * worker that falls behind the reader doesn't load the page a second time.
+	 *
+	 * @param file		File object
+	 * @param pageNo	Page number in the file
+	 */
+  void dropPrefetch(const File* file, const PageId pageNo);
+
+	/**
+	 * Drops the queued prefetches of the given pages which were asked for without a ring,
+	 * and waits for the workers loading a page of the file, so none of them uses the File
+	 * object after the caller returns.
+	 *
+	 * @param file    	File object
+	 * @param pageIds 	Page numbers in the file
+	 */
+  void dropPrefetches(const File* file, const std::vector<PageId>& pageIds);
+
+	/**
+	 * Stops the prefetch workers, dropping requests they have not started.
+	 */
+  void stopPrefetchWorkers();
+
+	/**
+	 * Claim a victim frame of a partition from its replacement policy without waiting. The
+	 * frame is returned claimed, with a pin count of 1 and no entry in the hash table.
+	 *
+	 * @param part    	Partition to take the frame from
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @return  				False if every frame of the partition is pinned.
+	 */
+  bool claimFrame(BufPartition& part, FrameId & frame);
+
+	/**
+	 * Claim the frame of the oldest page unpinned with HINT_EVICT_SOON in a partition and
+	 * evict that page, skipping stale entries.
+	 *
+	 * @param part    	Partition to take the frame from
+	 * @param frame   	Frame ID of the claimed frame returned via this variable
+	 * @return  				False if no such page can be claimed.
+	 */
+  bool claimEvictSoon(BufPartition& part, FrameId & frame);
+
+	/**
+	 * Record the hint a page was pinned or unpinned with on its frame.
+	 *
+	 * @param frameNo	Frame holding the page, pinned by the caller
+	 * @param hint   	Hint given by the caller
+	 */
+  void applyHint(const FrameId frameNo, const PageHint hint);
+
+	/**
+	 * Queue a frame just unpinned for eviction ahead of the replacement policy if its page
+	 * is marked HINT_EVICT_SOON and nobody else has it pinned.
+	 *
+	 * @param frameNo	Frame which was unpinned
+	 */
+  void queueEvictSoon(const FrameId frameNo);
+
+	/**
+	 * Claim a victim frame without waiting, trying the partitions in turn from firstChoice on.
+	 *
+	 * @param firstChoice	Index of the partition to try first
+	 * @param frame      	Frame ID of the claimed frame returned via this variable
+	 * @return  					False if every frame is pinned.
+	 */
+  bool claimAnyFrame(const std::uint32_t firstChoice, FrameId & frame);
+
+	/**
+	 * Read a page into a frame claimed for it, unless another thread brought the page in
+	 * meanwhile. Either way the caller ends up holding a pin on the frame with the page.
+	 *
+	 * @param file    	File object
+	 * @param pageNo  	Page number in the file
+	 * @param newFrame	Frame claimed by the caller
+	 * @param ring    	Ring the frame is recorded in, or NULL
+	 * @param ringSlot	Ring slot newFrame was recycled from, or -1
+	 * @param frameNo 	Frame holding the page returned via this variable
+	 * @return  				True if the page was read into newFrame, false if it was already resident.
+	 */
+  bool installPage(File* file, const PageId pageNo, const FrameId newFrame,
+                   BufferRing* ring, const long ringSlot, FrameId& frameNo);
+
+	/**
+	 * Allocate a free frame. The frame is returned claimed, with a pin count of 1 and
+	 * no entry in the hash table. If every frame is pinned, waits for another thread to
+	 * unpin one.
+	 *
+	 * @param firstChoice	Index of the partition to take the frame from if it has one
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @return  				BUF_OK, or BUF_EXCEEDED if no frame became available within the pin wait timeout
+	 */
+  BufStatus tryAllocBuf(const std::uint32_t firstChoice, FrameId & frame);
+
+	/**
+	 * Throwing version of tryAllocBuf().
+	 *
+	 * @param firstChoice	Index of the partition to take the frame from if it has one
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @throws BufferExceededException If no frame became available within the pin wait timeout
+	 */
+  void allocBuf(const std::uint32_t firstChoice, FrameId & frame);
+
+	/**
+	 * Writes out and evicts all pages of the file. Only the frames listed for the file are
+	 * visited, and dirty pages are written in page number order, a run of adjacent pages
+	 * at a time. Nothing is written or evicted if one of the pages is pinned.
+	 *
+	 * @param file       	File object
+	 * @param pinnedFrame	Frame of the pinned page returned via this variable
+	 * @return  					BUF_OK, or BUF_PAGE_PINNED if a page of the file is pinned
+   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+	 */
+  BufStatus flushPages(const File* file, FrameId& pinnedFrame);
+
+	/**
+	 * Writes out the dirty pages of the file, which stay in the pool, and syncs the file if
+	 * the durability level is SYNC_ON_COMMIT. Pages pinned while clean are skipped. Nothing
+	 * is written if a dirty page is pinned.
+	 *
+	 * @param file       	File object
+	 * @param pinnedFrame	Frame of the pinned page returned via this variable
+	 * @return  					BUF_OK, or BUF_PAGE_PINNED if a dirty page of the file is pinned
+	 */
+  BufStatus commitPages(const File* file, FrameId& pinnedFrame);
+
+	/**
+	 * Claims a frame of the file for commitPages() which someone else has pinned. An
+	 * eviction writing the page out is waited for, and so is a pin on a dirty page, for up
+	 * to COMMIT_PIN_WAIT_MS.
+	 *
+	 * @param file   	File object
+	 * @param frameNo	Frame listed for the file
+	 * @param claimed	Set if the frame was claimed; left unset if it needs no write
+	 * @return  			BUF_OK, or BUF_PAGE_PINNED if the page stayed pinned and dirty
+	 */
+  BufStatus claimForCommit(const File* file, const FrameId frameNo, bool& claimed);
+
+	/**
+	 * Claims every frame listed for the file, the caller holding writeBackMutex. Frames
+	 * which turn out to hold another file's page are passed over.
+	 *
+	 * @param file       	File object
+	 * @param skipClean  	Pass over pinned pages which need no write instead of giving up
+	 * @param claimed    	Claimed frames returned via this variable
+	 * @param pinnedFrame	Frame of the pinned page returned via this variable
+	 * @return  					BUF_OK, or BUF_PAGE_PINNED with nothing claimed
+   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+	 */
+  BufStatus claimFileFrames(const File* file, const bool skipClean, std::vector<FrameId>& claimed,
+                            FrameId& pinnedFrame);
+
+	/**
+	 * Writes out the dirty pages among frames claimed by claimFileFrames(), in page number
+	 * order and a run of adjacent pages at a time. Sorts claimed by page number. If a write
+	 * fails, the pages not yet written stay dirty and every claim is dropped.
+	 *
+	 * @param claimed	Frames holding pages of one file
+	 */
+  void writeClaimed(std::vector<FrameId>& claimed);
+
+	/**
+	 * Write a run of dirty pages with consecutive page numbers of one file with one call to
+	 * File::writePages(), timing the write.
+	 *
+	 * @param frames	Frames holding the pages in page number order, claimed by the caller
+	 * @param count 	Number of frames
+	 */
+  void writeFrames(const FrameId* frames, const std::size_t count);
+
+	/**
+	 * Add a frame which was just set to hold a page to its partition's list for the file,
+	 * and switch it to the partition's File object, opening that if the partition has none
+	 * for the file yet. If it can't be opened the frame is left empty and the error thrown.
+	 *
+	 * @param frameNo	Frame claimed by the caller
+	 */
+  void trackFrame(FrameId frameNo);
+
+	/**
+	 * Take a frame off its file's list, if it holds a page, and clear its descriptor. The
+	 * partition's File object for the file stays open, see fileClosed().
+	 *
+	 * @param frameNo	Frame claimed by the caller
+	 */
+  void clearFrame(FrameId frameNo);
+
+	/**
+	 * Called when every File object of a file but the pool handles is closed. Writes back
+	 * and evicts the file's pages, drops them from the victim cache and closes the
+	 * partitions' File objects for it, so the file is closed and can be removed. If a page
+	 * of the file is still pinned nothing is evicted and the handles stay open.
+	 *
+	 * @param id	Id of the file
+	 */
+  void fileClosed(const FileId id);
+
+	/**
+	 * Evict the page held by a frame that the caller has claimed (pin count 1).
+	 * Dirty contents are written back before the hash table entry is removed.
+	 *
+	 * @param frameNo       	Frame claimed by the caller
+	 * @param keepCompressed	If true and the victim cache is enabled, the page is offered to it
+	 * @return  							True if the frame is now free, false if another thread pinned the page meanwhile.
+	 */
+  bool evictFrame(FrameId frameNo, const bool keepCompressed = true);
+
+	/**
+	 * Claim the frame of the oldest page in a full ring and evict that page, for a miss
+	 * of the ring's reader.
+	 *
+	 * @param ring   	Ring of the reader
+	 * @param frame  	Frame ID of the claimed frame returned via this variable
+	 * @param slot   	Slot the frame belongs to returned via this variable
+	 * @return  			False if the ring is not full yet or every ring frame is in use.
+	 */
+  bool claimRingFrame(BufferRing& ring, FrameId& frame, long& slot);
+
+	/**
+	 * Give back a claimed frame which did not end up holding a page.
+	 *
+	 * @param frameNo	Frame claimed by the caller
+	 */
+  void releaseFrame(FrameId frameNo);
+
+	/**
+	 * Pin a frame only if nobody has it pinned.
+	 *
+	 * @param frameNo	Frame to claim
+	 * @return  			False if the frame is pinned.
+	 */
+  bool claimPin(FrameId frameNo);
+
+	/**
+	 * Add a pin to a frame whose page was found under the hash table latch.
+	 *
+	 * @param frameNo	Frame to pin
+	 */
+  void addPin(FrameId frameNo);
+
+	/**
+	 * Drop one pin from a frame and wake up threads waiting for a frame if it became unpinned.
+	 *
+	 * @param frameNo	Frame to unpin
+	 */
+  void dropPin(FrameId frameNo);
+
+	/**
+	 * Drop one pin from a frame like dropPin(), but only if it has one: checking the pin
+	 * count and decrementing it are one atomic step.
+	 *
+	 * @param frameNo	Frame to unpin
+	 * @return  			False if the frame was not pinned
+	 */
+  bool tryDropPin(FrameId frameNo);
+
+	/**
+	 * Account for a frame whose last pin was just dropped and wake up threads waiting for a
+	 * frame.
+	 */
+  void frameUnpinned();
+
+	/**
+	 * Unpin a page by the frame it is known to be pinned in, as PageHandle does.
+	 *
+	 * @param frameNo	Frame pinned by the caller
+	 * @param dirty  	True if the page needs to be marked dirty
+	 * @param hint   	How long the page will be wanted
+	 */
+  void unpinFrame(const FrameId frameNo, const bool dirty, const PageHint hint = HINT_NORMAL);
+
+	/**
+	 * Write the page held by a frame to its file, timing the write.
+	 *
+	 * @param frameNo	Frame holding a dirty page, claimed or pinned by the caller
+	 */
+  void writeFrame(FrameId frameNo);
+
+	/**
+	 * Block until the frame is no longer being read from disk.
+	 *
+	 * @param frameNo	Frame pinned by the caller
+	 */
+  void waitForIo(FrameId frameNo);
+
+	/**
+	 * Mark the frame as loaded and wake up threads waiting on it.
+	 *
+	 * @param frameNo	Frame which was being read in
+	 */
+  void finishIo(FrameId frameNo);
+
+ public:
+	/**
+   * Actual buffer pool from which frames are allocated
+	 */
+  Page* bufPool;
+
+	/**
+   * Constructor of BufMgr class
+	 *
+	 * @param bufs      	Number of frames in the buffer pool
+	 * @param policyType	Page replacement algorithm to use
+	 * @param memory    	Kind of memory to allocate the buffer pool from
+	 * @param maxFrames 	Most frames resize() can grow the pool to; 0 for as many as physical
+	 *                  	memory holds. Only address space is reserved for them. A pool in
+	 *                  	POOL_EXPLICIT_HUGE memory can't grow.
+	 * @param numPartitions	Number of partitions to split the pool into, at most bufs. Each
+	 *                  	gets an even share of the frames, its own hash table and its own
+	 *                  	replacement policy.
+	 */
+  BufMgr(std::uint32_t bufs, ReplacementPolicyType policyType = CLOCK,
+         PoolMemory memory = POOL_DEFAULT, std::uint32_t maxFrames = 0,
+         std::uint32_t numPartitions = 1);
+
+	/**
+	 * How long resize() waits for a pinned frame it wants to remove to be unpinned
+	 */
+  static const int SHRINK_PIN_WAIT_MS = 10;
+
+	/**
+	 * Number of prefetch worker threads by default
+	 */
+  static const std::uint32_t DEFAULT_PREFETCH_WORKERS = 4;
+
+	/**
+	 * How long commit() waits for a dirty page it has to write out to be unpinned
+	 */
+  static const int COMMIT_PIN_WAIT_MS = 10;
+
+	/**
+	 * Most frames, in percent of the pool, which HINT_KEEP holds back from eviction. Once
+	 * that many are marked, further HINT_KEEPs count as HINT_NORMAL.
+	 */
+  static const std::uint32_t MAX_KEPT_PERCENT = 25;
+	
+	/**
+   * Destructor of BufMgr class
+	 */
+  ~BufMgr();
+
+	/**
+	 * Reads the given page from the file into a frame and returns the pointer to page.
+	 * If the requested page is already present in the buffer pool pointer to that frame is returned
+	 * otherwise a new frame is allocated from the buffer pool for reading the page.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * @param ring  	If not NULL, a miss recycles a frame of this ring instead of taking one from the shared pool
+	 * @param hint  	How long the page will be wanted
+	 * @throws BufferExceededException If no frame became available within the pin wait timeout
+	 */
+  void readPage(File* file, const PageId PageNo, Page*& page, BufferRing* ring = NULL,
+                const PageHint hint = HINT_NORMAL);
+
+	/**
+	 * Non-throwing version of readPage() for callers which expect to find the pool full.
+	 * Errors reading the file are still thrown.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer, only set on BUF_OK
+	 * @param ring  	If not NULL, a miss recycles a frame of this ring instead of taking one from the shared pool
+	 * @param hint  	How long the page will be wanted
+	 * @return  			BUF_OK, or BUF_EXCEEDED if no frame became available within the pin wait timeout
+	 */
+  BufStatus tryReadPage(File* file, const PageId PageNo, Page*& page, BufferRing* ring = NULL,
+                        const PageHint hint = HINT_NORMAL);
+
+	/**
+	 * Reads the given page like readPage() and returns a handle which unpins it when it
+	 * goes away.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file to be read
+	 * @param ring  	If not NULL, a miss recycles a frame of this ring instead of taking one from the shared pool
+	 * @param hint  	How long the page will be wanted
+	 * @return  			Handle holding the pinned page
+	 * @throws BufferExceededException If no frame became available within the pin wait timeout
+	 */
+  PageHandle pinPage(File* file, const PageId pageNo, BufferRing* ring = NULL,
+                     const PageHint hint = HINT_NORMAL);
+
+	/**
+	 * Allocates a new page like allocPage() and returns a handle which unpins it when it
+	 * goes away.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  The number assigned to the page in the file is returned via this reference.
+	 * @param hint  	How long the page will be wanted
+	 * @return  			Handle holding the pinned page
+	 * @throws BufferExceededException If no frame became available within the pin wait timeout
+	 */
+  PageHandle pinNewPage(File* file, PageId& pageNo, const PageHint hint = HINT_NORMAL);
+
+	/**
+	 * Reads several pages of a file and pins them all. The first page is read right away
+	 * while the others are loaded by the prefetch workers. No worker is left using the File
+	 * object when this returns or throws.
+	 *
+	 * @param file    	File object
+	 * @param pageIds 	Page numbers in the file
+	 * @param outPages	Receives the pinned pages, in the order of pageIds
+	 * @throws BufferExceededException If no frame became available within the pin wait timeout
+	 */
+  void readPages(File* file, const std::vector<PageId>& pageIds, std::vector<Page*>& outPages);
+
+	/**
+	 * Asks the prefetch workers to load pages into the pool in the background; returns
+	 * without waiting. Frames are taken through the replacement policy (or the ring) and
+	 * left unpinned, so a later readPage of the page is a hit. Pages already resident, and
+	 * pages for which no frame is free when their turn comes, are skipped.
+	 *
+	 * @param file    	File object. It must stay open until its prefetches are done or
+	 *                	cancelled with cancelPrefetch() or flushFile().
+	 * @param pageIds 	Page numbers in the file
+	 * @param ring    	If not NULL, frames are recycled from this ring
+	 */
+  void prefetch(File* file, const std::vector<PageId>& pageIds, BufferRing* ring = NULL);
+
+	/**
+	 * Drops the queued prefetches of a file and waits for the ones being loaded.
+	 *
+	 * @param file    	File object
+	 */
+  void cancelPrefetch(const File* file);
+
+	/**
+	 * Unpin a page from memory since it is no longer required for it to remain in memory.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
+	 * @param hint  	How long the page will be wanted; HINT_NORMAL leaves the page's mark as it is
+   * @throws  PageNotPinnedException If the page is not already pinned
+	 */
+  void unPinPage(File* file, const PageId PageNo, const bool dirty, const PageHint hint = HINT_NORMAL);
+
+	/**
+	 * Non-throwing version of unPinPage().
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty
+	 * @param hint  	How long the page will be wanted; HINT_NORMAL leaves the page's mark as it is
+	 * @return  			BUF_OK, BUF_NOT_RESIDENT if the page is not in the pool or BUF_NOT_PINNED if it is not pinned
+	 */
+  BufStatus tryUnPinPage(File* file, const PageId PageNo, const bool dirty, const PageHint hint = HINT_NORMAL);
+
+	/**
+	 * Allocates a new, empty page in the file and returns the Page object.
+	 * The newly allocated page is also assigned a frame in the buffer pool.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+	 * @param hint  	How long the page will be wanted
+	 * @throws BufferExceededException If no frame became available within the pin wait timeout
+	 */
+  void allocPage(File* file, PageId &PageNo, Page*& page, const PageHint hint = HINT_NORMAL);
+
+	/**
+	 * Non-throwing version of allocPage(). Nothing is allocated in the file unless a frame
+	 * is available. Errors writing the file are still thrown; if the page was allocated by
+	 * then, it is deleted from the file again first.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @param page  	Reference to page pointer, only set on BUF_OK
+	 * @param hint  	How long the page will be wanted
+	 * @return  			BUF_OK, or BUF_EXCEEDED if no frame became available within the pin wait timeout
+	 */
+  BufStatus tryAllocPage(File* file, PageId &PageNo, Page*& page, const PageHint hint = HINT_NORMAL);
+
+	/**
+	 * Writes out all dirty pages of the file to disk, and the file's header, and evicts the
+	 * file's pages from the pool.
+	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
+	 * Otherwise nothing is written or evicted and an exception is thrown.
+	 *
+	 * @param file   	File object
+   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
+   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+   * @throws  FileSyncException If the durability level is SYNC_ON_FLUSHFILE and the file
+   *                            could not be synced
+   * @throws  FileIoException If a page could not be written; it stays dirty in the pool
+	 */
+  void flushFile(const File* file);
+
+	/**
+	 * Version of flushFile() which reports a pinned page instead of throwing. All or
+	 * nothing: every frame of the file is claimed first, and if any page of the file is
+	 * pinned the claims are released and no page is written or evicted, nor the header.
+	 *
+	 * @param file   	File object
+	 * @return  			BUF_OK if the file's pages were written and evicted, or BUF_PAGE_PINNED
+	 *              	if a page of the file is pinned and the pool was left as it was
+   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+   * @throws  FileSyncException If the durability level is SYNC_ON_FLUSHFILE and the file
+   *                            could not be synced
+   * @throws  FileIoException If a page could not be written; it stays dirty in the pool
+	 */
+  BufStatus tryFlushFile(const File* file);
+
+	/**
+	 * Writes out the dirty pages of the file without evicting them, and its header, and if
+	 * the durability level is SYNC_ON_COMMIT, waits until the file is on stable storage.
+	 * Changes of pages unpinned before the call are covered.
+	 *
+	 * @param file   	File object
+   * @throws  PagePinnedException If a dirty page of the file is pinned in the buffer pool
+   * @throws  FileSyncException If the file could not be synced
+   * @throws  FileIoException If a page could not be written; it stays dirty in the pool
+	 */
+  void commit(const File* file);
+
+	/**
+	 * Non-throwing version of commit() as far as pinned pages go; nothing is written if a
+	 * dirty page of the file is pinned.
+	 *
+	 * @param file   	File object
+	 * @return  			BUF_OK, or BUF_PAGE_PINNED if a dirty page of the file is pinned
+   * @throws  FileSyncException If the file could not be synced
+   * @throws  FileIoException If a page could not be written; it stays dirty in the pool
+	 */
+  BufStatus tryCommit(const File* file);
+
+	/**
+	 * Delete page from file and also from buffer pool if present.
+	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
+	 *
+	 * A pinned page is disposed of all the same: its pins go with it, and whoever held them
+	 * must not use or unpin the page afterwards.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+   * @throws  HashNotFoundException If the page is not in the buffer pool; it is not deleted then
+	 */
+  void disposePage(File* file, const PageId PageNo);
+
+	/**
+	 * Grows or shrinks the buffer pool while it is in use. Growing adds empty frames.
+	 * Shrinking writes out and evicts the pages of the frames being removed, from the top
+	 * frame down, and returns their memory to the system. A frame still pinned after
+	 * SHRINK_PIN_WAIT_MS stops the shrink, since its page must stay where its user's pointer
+	 * says, so the pool may end up larger than asked; a later call can finish the job.
+	 * Pages in the remaining frames never move.
+	 *
+	 * With several partitions each one gets an even share of the frames and is resized on
+	 * its own.
+	 *
+	 * @param newFrames	Number of frames wanted; clamped to getNumPartitions()..getMaxBufs()
+	 * @return  				Number of frames the pool has now.
+	 */
+  std::uint32_t resize(std::uint32_t newFrames);
+
+	/**
+	 * Number of frames in the pool
+	 */
+  std::uint32_t getNumBufs() const
+  {
+		return numBufs;
+  }
+
+	/**
+	 * Most frames the pool can be resized to
+	 */
+  std::uint32_t getMaxBufs() const
+  {
+		return maxBufs;
+  }
+
+	/**
+	 * Number of partitions the pool is split into
+	 */
+  std::uint32_t getNumPartitions() const
+  {
+		return partitions.size();
+  }
+
+	/**
+	 * Memory limit of the cgroup this process runs in, from cgroup v2 memory.max or the
+	 * cgroup v1 memory controller.
+	 *
+	 * @return  Limit in bytes, 0 if there is none or it can't be read.
+	 */
+  static std::uint64_t cgroupMemoryLimit();
+
+	/**
+	 * Starts a thread which keeps the pool at a share of the cgroup memory limit, so memory
+	 * given to or taken from the container is followed without a restart. Passes where no
+	 * limit is set leave the pool alone. Does nothing if the thread already runs.
+	 *
+	 * @param memoryFraction	Share of the memory limit to spend on frames
+	 * @param interval      	How often the limit is checked
+	 */
+  void startAutoResize(const double memoryFraction = 0.5,
+                       const std::chrono::milliseconds interval = std::chrono::milliseconds(5000));
+
+	/**
+	 * Stops the auto-resize thread. The pool keeps its current size.
+	 */
+  void stopAutoResize();
+
+	/**
+   * Print member variable values. 
+	 */
+  void  printSelf();
+
+	/**
+   * Kind of memory the buffer pool was allocated from, after any fallback
+	 */
+  PoolMemory getPoolMemory() const
+  {
+		return poolMemory;
   }
 
+	/**
+   * Get buffer pool usage statistics, added up over the partitions at the time of the call
+	 */
+  BufStats & getBufStats();
+
 	/**
    * Clear buffer pool usage statistics
 	 */
-  void clearBufStats() 
+  void clearBufStats();
+
+	/**
+	 * Takes a snapshot of the metrics: counters, latency histograms and the current
+	 * valid, dirty and pinned frame counts.
+	 *
+	 * @param out	Receives the snapshot
+	 */
+  void collectMetrics(BufMetricsSnapshot& out);
+
+	/**
+	 * Renders a snapshot of the metrics.
+	 *
+	 * @param fmt	JSON or Prometheus text
+	 * @return  	The metrics as text
+	 */
+  std::string exportMetrics(const MetricsFormat fmt);
+
+	/**
+	 * Writes a snapshot of the metrics to a file. The file is replaced atomically, so a
+	 * scraper never sees it half written.
+	 *
+	 * @param path	File to write
+	 * @param fmt 	JSON or Prometheus text
+	 * @return  		False if the file could not be written.
+	 */
+  bool writeMetrics(const std::string& path, const MetricsFormat fmt);
+
+	/**
+	 * Starts a thread rewriting the metrics file on an interval, e.g. for a node exporter
+	 * textfile collector. Does nothing if the export already runs.
+	 *
+	 * @param path    	File to write
+	 * @param fmt     	JSON or Prometheus text
+	 * @param interval	Pause between writes
+	 */
+  void startMetricsExport(const std::string& path, const MetricsFormat fmt,
+                          const std::chrono::milliseconds interval = std::chrono::milliseconds(10000));
+
+	/**
+	 * Stops the metrics export thread after a last write.
+	 */
+  void stopMetricsExport();
+
+	/**
+	 * Resets the metrics counters and histograms
+	 */
+  void clearMetrics()
+  {
+		metrics.clear();
+  }
+
+	/**
+	 * Switches collecting the metrics on or off; they are on by default. While off,
+	 * snapshots keep returning the counts collected so far.
+	 *
+	 * @param on	True to collect
+	 */
+  void setMetricsEnabled(const bool on)
+  {
+		metrics.setEnabled(on);
+  }
+
+	/**
+	 * Writes the pages resident in the pool to a snapshot file, so that a later pool can be
+	 * warmed up with loadSnapshot() instead of missing its way back to the working set. Each
+	 * page is recorded by file name and page number along with whether it was referenced
+	 * since the replacement policy last passed it. The file is replaced atomically.
+	 *
+	 * @param path	Snapshot file to write
+	 * @return  		False if the file could not be written.
+	 */
+  bool saveSnapshot(const std::string& path);
+
+	/**
+	 * Reads the pages listed in a snapshot written by saveSnapshot() back into the pool.
+	 * Recently referenced pages are taken first when the snapshot lists more pages than the
+	 * pool holds, and the pages taken are read a file at a time in page number order. Loading
+	 * goes through the prefetch path: it never waits for a frame and counts prefetch reads,
+	 * not misses. Pages which no longer exist in their file are skipped.
+	 *
+	 * @param path      	Snapshot file to read
+	 * @param files     	Open files whose pages may be loaded, matched to the snapshot by file
+	 *                  	name; pages of other files are skipped. When loading in the
+	 *                  	background they must stay open until their pages are loaded or
+	 *                  	cancelled with cancelPrefetch() or flushFile().
+	 * @param background	If true the pages are queued for the prefetch workers and the call
+	 *                  	returns right away
+	 * @return  					Number of pages read, or queued in the background; 0 if the snapshot
+	 *                  	could not be read.
+	 */
+  std::size_t loadSnapshot(const std::string& path, const std::vector<File*>& files,
+                           const bool background = false);
+
+	/**
+	 * Sets the memory budget of the compressed victim cache. Once enabled, pages leaving the
+	 * pool through eviction are compressed and kept within the budget, and a miss looks for
+	 * the page there before reading the file. Pages recycled by a BufferRing are not kept,
+	 * nor are pages which compress poorly. BufStats counts victim cache lookups, hits and
+	 * decompression time. The cache pays off when misses go to the device, as with
+	 * DIRECT_IO; a page held in the operating system's page cache is read about as fast.
+	 *
+	 * @param bytes	Budget in bytes; 0 disables the cache and frees its memory
+	 */
+  void setVictimCacheBudget(const std::size_t bytes)
+  {
+		victimCache.setBudget(bytes);
+  }
+
+	/**
+	 * Has the destructor save a snapshot of the pool once dirty pages are written out.
+	 *
+	 * @param path	Snapshot file to write; empty to save none
+	 */
+  void setShutdownSnapshot(const std::string& path)
+  {
+		shutdownSnapshot = path;
+  }
+
+	/**
+	 * Starts a background thread which writes out dirty pages before the replacement policy
+	 * gets to them, so that evictions find clean victims and a miss costs a single read.
+	 * Pages are written in page number order. Does nothing if the writer already runs.
+	 *
+	 * @param cleanFraction	Fraction of the pool, counted from the next victim on, kept clean
+	 * @param interval     	Pause between passes
+	 */
+  void startBackgroundWriter(const double cleanFraction = 0.1,
+                             const std::chrono::milliseconds interval = std::chrono::milliseconds(20));
+
+	/**
+	 * Stops the background writer and waits for it to exit. Dirty pages it has not
+	 * reached stay in the pool.
+	 */
+  void stopBackgroundWriter();
+
+	/**
+	 * Set the number of prefetch worker threads. Only has an effect before the first prefetch.
+	 *
+	 * @param workers	Number of threads
+	 */
+  void setPrefetchWorkers(const std::uint32_t workers)
+  {
+		numPrefetchWorkers = workers > 0 ? workers : 1;
+  }
+
+	/**
+   * Set how long a caller waits for a frame to be unpinned when every frame is pinned,
+	 * before BufferExceededException is thrown.
+	 *
+	 * @param timeout	Maximum wait
+	 */
+  void setPinWaitTimeout(const std::chrono::milliseconds timeout)
+  {
+		pinWaitTimeout = timeout;
+  }
+
+	/**
+	 * Set when written pages are synced to stable storage. DURABILITY_NONE by default.
+	 *
+	 * @param level	Durability level
+	 */
+  void setDurability(const Durability level)
+  {
+		durability = level;
+  }
+
+	/**
+	 * Returns when written pages are synced to stable storage.
+	 */
+  Durability getDurability() const
   {
-		bufStats.clear();
+		return durability;
   }
 };
 
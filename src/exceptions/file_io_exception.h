@@ -0,0 +1,58 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when the operating system fails to read
+ *        or write a file.
+ */
+class FileIoException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a file I/O exception for the given file.
+   *
+   * @param name    Name of file whose read or write failed.
+   * @param error   errno reported by the failed call.
+   */
+  FileIoException(const std::string& name, const int error);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~FileIoException() throw() {}
+
+  /**
+   * Returns the name of the file that caused this exception.
+   */
+  virtual const std::string& filename() const { return filename_; }
+
+  /**
+   * Returns the errno reported by the failed call.
+   */
+  virtual int error() const { return error_; }
+
+ protected:
+  /**
+   * Name of file that caused this exception.
+   */
+  const std::string filename_;
+
+  /**
+   * errno reported by the failed call.
+   */
+  const int error_;
+};
+
+}
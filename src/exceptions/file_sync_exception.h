@@ -0,0 +1,58 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when the operating system fails to make
+ *        the writes to a file durable.
+ */
+class FileSyncException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a file sync exception for the given file.
+   *
+   * @param name    Name of file that failed to sync.
+   * @param error   errno reported by the failed call.
+   */
+  FileSyncException(const std::string& name, const int error);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~FileSyncException() throw() {}
+
+  /**
+   * Returns the name of the file that caused this exception.
+   */
+  virtual const std::string& filename() const { return filename_; }
+
+  /**
+   * Returns the errno reported by the failed call.
+   */
+  virtual int error() const { return error_; }
+
+ protected:
+  /**
+   * Name of file that caused this exception.
+   */
+  const std::string filename_;
+
+  /**
+   * errno reported by the failed call.
+   */
+  const int error_;
+};
+
+}
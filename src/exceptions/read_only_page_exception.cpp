@@ -0,0 +1,22 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "read_only_page_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+ReadOnlyPageException::ReadOnlyPageException(const std::string& nameIn, PageId pageNoIn)
+    : BadgerDbException(""), name(nameIn), pageNo(pageNoIn) {
+  std::stringstream ss;
+  ss << "This page is mapped read-only and cannot be modified. file: " << name << " page: " << pageNo;
+  message_.assign(ss.str());
+}
+
+}
@@ -0,0 +1,39 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a page mapped read-only is unpinned as dirty.
+ */
+class ReadOnlyPageException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a read only page exception for the given file.
+   */
+  explicit ReadOnlyPageException(const std::string& nameIn, PageId pageNoIn);
+
+ protected:
+  /**
+   * Name of file that caused this exception.
+   */
+  const std::string& name;
+
+  /**
+   * Page number in file
+   */
+  const PageId pageNo;
+};
+
+}
@@ -7,24 +7,150 @@
 
 #include "file.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <cstdio>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <cassert>
+#include <climits>
+#include <cstddef>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
 
 #include "exceptions/file_exists_exception.h"
+#include "exceptions/file_io_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
+#include "exceptions/file_sync_exception.h"
 #include "exceptions/invalid_page_exception.h"
 #include "file_iterator.h"
 #include "page.h"
 
 namespace badgerdb {
 
-File::StreamMap File::open_streams_;
+namespace {
+
+/**
+ * Block-aligned scratch space for DIRECT_IO transfers which don't start and end
+ * on block boundaries. One per thread, grown on demand.
+ */
+struct DirectBuffer {
+  char* data;
+  std::size_t size;
+
+  DirectBuffer() : data(NULL), size(0) {}
+  ~DirectBuffer() { std::free(data); }
+
+  char* get(const std::size_t needed) {
+    if (needed > size) {
+      std::free(data);
+      data = NULL;
+      size = 0;
+      if (posix_memalign(reinterpret_cast<void**>(&data), File::DIRECT_ALIGNMENT, needed) != 0) {
+        throw std::bad_alloc();
+      }
+      size = needed;
+    }
+    return data;
+  }
+};
+
+thread_local DirectBuffer direct_buffer;
+
+// Reads length bytes at offset, zero-filling whatever lies past the end of the file.
+// Throws FileIoException, named after the file, if the read fails.
+void positionalRead(const int fd, char* buffer, const std::size_t length, const off_t offset,
+                    const std::string& name) {
+  std::size_t done = 0;
+  while (done < length) {
+    const ssize_t n = pread(fd, buffer + done, length - done, offset + done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIoException(name, errno);
+    }
+    if (n == 0) {
+      break;
+    }
+    done += n;
+  }
+  std::memset(buffer + done, 0, length - done);
+}
+
+// Writes length bytes at offset. Throws FileIoException, named after the file, if the
+// write fails.
+void positionalWrite(const int fd, const char* buffer, const std::size_t length, const off_t offset,
+                     const std::string& name) {
+  std::size_t done = 0;
+  while (done < length) {
+    const ssize_t n = pwrite(fd, buffer + done, length - done, offset + done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIoException(name, errno);
+    }
+    if (n == 0) {
+      // nothing written and no error to report; don't spin on it
+      throw FileIoException(name, EIO);
+    }
+    done += n;
+  }
+}
+
+// Writes the buffers at offset, picking up after short writes. Returns false if the
+// descriptor refuses the write.
+bool vectorWrite(const int fd, const struct iovec* parts, const int count, off_t offset) {
+  std::vector<struct iovec> rest(parts, parts + count);
+  std::size_t first = 0;
+  while (first < rest.size()) {
+    const int batch = static_cast<int>(std::min<std::size_t>(rest.size() - first, IOV_MAX));
+    const ssize_t n = pwritev(fd, &rest[first], batch, offset);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    offset += n;
+    // drop the buffers written in full and trim the one written in part
+    std::size_t done = n;
+    while (first < rest.size() && done >= rest[first].iov_len) {
+      done -= rest[first].iov_len;
+      first++;
+    }
+    if (done > 0) {
+      rest[first].iov_base = static_cast<char*>(rest[first].iov_base) + done;
+      rest[first].iov_len -= done;
+    }
+  }
+  return true;
+}
+
+bool isAligned(const void* buffer, const off_t offset, const std::size_t length) {
+  return reinterpret_cast<std::uintptr_t>(buffer) % File::DIRECT_ALIGNMENT == 0 &&
+      offset % File::DIRECT_ALIGNMENT == 0 && length % File::DIRECT_ALIGNMENT == 0;
+}
+
+}
+
+File::DescriptorMap File::open_fds_;
 File::CountMap File::open_counts_;
+File::CountMap File::pool_counts_;
+File::LatchMap File::open_latches_;
+File::IdMap File::open_ids_;
+File::HeaderMap File::open_headers_;
+FileId File::next_id_ = File::INVALID_ID + 1;
+const FileId File::INVALID_ID;
+std::mutex File::open_mutex_;
 
 void File::remove(const std::string& filename) {
   if (!exists(filename)) {
@@ -40,6 +166,7 @@ bool File::isOpen(const std::string& filename) {
   if (!exists(filename)) {
     return false;
   }
+  std::lock_guard<std::mutex> guard(open_mutex_);
   return open_counts_.find(filename) != open_counts_.end();
 }
 
@@ -64,68 +191,460 @@ PageId File::getFirstPageNo() {
   return header.first_used_page;
 }
 
-File::File(const std::string& name, const bool create_new) : filename_(name) {
+File::File(const std::string& name, const bool create_new,
+           const FileIoMode io_mode)
+    : filename_(name), id_(INVALID_ID), io_mode_(io_mode), direct_fd_(-1),
+      pool_handle_(false) {
   openIfNeeded(create_new);
 
   if (create_new) {
     // File starts with 1 page (the header).
     FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                         0 /* num_free_pages */, 0 /* first_free_page */};
+                         0 /* num_free_pages */, FileHeader::ALIGNED_FLAG /* first_free_page */};
     writeHeader(header);
+    flushHeader();
+  }
+  openDirect();
+}
+
+void File::openDirect() {
+  if (io_mode_ == DIRECT_IO && header_->first_page_position % DIRECT_ALIGNMENT != 0) {
+    // pages of older files straddle blocks; O_DIRECT would turn every page
+    // transfer into a read-modify-write of the blocks around it
+    io_mode_ = BUFFERED_IO;
+  }
+  if (io_mode_ == DIRECT_IO) {
+    direct_fd_ = ::open(filename_.c_str(), O_RDWR | O_DIRECT);
+    if (direct_fd_ >= 0) {
+      return;
+    }
+    // Some file systems (tmpfs on older kernels) don't support O_DIRECT.
+    io_mode_ = BUFFERED_IO;
   }
 }
 
 void File::openIfNeeded(const bool create_new) {
+  std::lock_guard<std::mutex> guard(open_mutex_);
   if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
     ++open_counts_[filename_];
-    stream_ = open_streams_[filename_];
+    if (pool_handle_) {
+      ++pool_counts_[filename_];
+    }
+    fd_ = open_fds_[filename_];
+    latch_ = open_latches_[filename_];
+    header_ = open_headers_[filename_];
+    id_ = open_ids_[filename_];
   } else {
-    std::ios_base::openmode mode =
-        std::fstream::in | std::fstream::out | std::fstream::binary;
+    int flags = O_RDWR;
     const bool already_exists = exists(filename_);
     if (create_new) {
       // Error if we try to overwrite an existing file.
       if (already_exists) {
         throw FileExistsException(filename_);
       }
-      // New files have to be truncated on open.
-      mode = mode | std::fstream::trunc;
+      flags |= O_CREAT | O_TRUNC;
     } else {
       // Error if we try to open a file that doesn't exist.
       if (!already_exists) {
         throw FileNotFoundException(filename_);
       }
     }
-    stream_.reset(new std::fstream(filename_, mode));
-    open_streams_[filename_] = stream_;
+    const int fd = ::open(filename_.c_str(), flags, 0644);
+    if (fd < 0) {
+      throw FileNotFoundException(filename_);
+    }
+    fd_.reset(new FileDescriptor(fd));
+    latch_.reset(new std::recursive_mutex());
+    header_.reset(new CachedHeader());
+    if (!create_new) {
+      positionalRead(fd, reinterpret_cast<char*>(&header_->header), sizeof(FileHeader), 0, filename_);
+    }
+    header_->num_pages = header_->header.num_pages;
+    header_->first_page_position =
+        create_new || (header_->header.first_free_page & FileHeader::ALIGNED_FLAG) ?
+        static_cast<off_t>(Page::SIZE) : static_cast<off_t>(sizeof(FileHeader));
+    header_->changes = 0;
+    header_->write_interval = 0;
+    header_->directory.loaded = false;
+    open_fds_[filename_] = fd_;
+    open_headers_[filename_] = header_;
+    open_latches_[filename_] = latch_;
+    id_ = next_id_++;
+    open_ids_[filename_] = id_;
     open_counts_[filename_] = 1;
   }
 }
 
 void File::close() {
-	if(open_counts_[filename_] > 0)
-  	--open_counts_[filename_];
+  if (direct_fd_ >= 0) {
+    ::close(direct_fd_);
+    direct_fd_ = -1;
+  }
 
-  stream_.reset();
-	assert(open_counts_[filename_] >= 0);
+  // id of a file left open only by pool handles, whose pools are told below
+  FileId left_to_pools = INVALID_ID;
+  {
+    std::lock_guard<std::mutex> guard(open_mutex_);
+	  if(open_counts_[filename_] > 0)
+    	--open_counts_[filename_];
+    if (fd_ && pool_handle_) {
+      --pool_counts_[filename_];
+    } else if (fd_ && open_counts_[filename_] > 0 &&
+               open_counts_[filename_] == pool_counts_[filename_]) {
+      left_to_pools = id_;
+    }
 
-  if (open_counts_[filename_] == 0) {
-    open_streams_.erase(filename_);
-    open_counts_.erase(filename_);
+    if (open_counts_[filename_] == 0 && fd_) {
+      // the last File object of the file takes the header with it; close() runs
+      // from the destructor, so a failed write is lost here and only sync()
+      // reports it
+      try {
+        flushHeader();
+      } catch (FileIoException&) {
+      }
+    }
+    fd_.reset();
+    latch_.reset();
+    header_.reset();
+    id_ = INVALID_ID;
+	  assert(open_counts_[filename_] >= 0);
+
+    if (open_counts_[filename_] == 0) {
+      open_fds_.erase(filename_);
+      open_counts_.erase(filename_);
+      pool_counts_.erase(filename_);
+      open_latches_.erase(filename_);
+      open_ids_.erase(filename_);
+      open_headers_.erase(filename_);
+    }
   }
+
+  if (left_to_pools != INVALID_ID) {
+    std::lock_guard<std::mutex> guard(listenersMutex());
+    std::vector<FileCloseListener*>& listeners = closeListeners();
+    for (std::size_t i = 0; i < listeners.size(); i++) {
+      listeners[i]->fileClosed(left_to_pools);
+    }
+  }
+}
+
+File* File::poolHandle() const {
+  File* handle = clone();
+  std::lock_guard<std::mutex> guard(open_mutex_);
+  ++pool_counts_[handle->filename_];
+  handle->pool_handle_ = true;
+  return handle;
+}
+
+void File::addCloseListener(FileCloseListener* listener) {
+  std::lock_guard<std::mutex> guard(listenersMutex());
+  closeListeners().push_back(listener);
+}
+
+void File::removeCloseListener(FileCloseListener* listener) {
+  std::lock_guard<std::mutex> guard(listenersMutex());
+  std::vector<FileCloseListener*>& listeners = closeListeners();
+  listeners.erase(std::remove(listeners.begin(), listeners.end(), listener),
+                  listeners.end());
+}
+
+std::vector<FileCloseListener*>& File::closeListeners() {
+  static std::vector<FileCloseListener*> listeners;
+  return listeners;
+}
+
+std::mutex& File::listenersMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+const PageId PageDirectory::MAP_FORMAT_FLAG;
+const std::size_t PageDirectory::MAP_WORDS;
+const PageId PageDirectory::MAP_BITS;
+
+bool PageDirectory::isUsed(const PageId page_number) const {
+  const std::size_t word = page_number / 64;
+  return word < used.size() && (used[word] >> (page_number % 64) & 1) != 0;
+}
+
+void PageDirectory::setUsed(const PageId page_number, const bool in_use) {
+  const std::size_t word = page_number / 64;
+  if (in_use) {
+    if (word >= used.size()) {
+      used.resize(word + 1, 0);
+    }
+    used[word] |= std::uint64_t(1) << (page_number % 64);
+  } else if (word < used.size()) {
+    used[word] &= ~(std::uint64_t(1) << (page_number % 64));
+    free_word = std::min(free_word, word);
+  }
+  touch(page_number);
+}
+
+PageId PageDirectory::previous(const PageId page_number) const {
+  if (page_number <= 1 || used.empty()) {
+    return Page::INVALID_NUMBER;
+  }
+  std::size_t word = (page_number - 1) / 64;
+  std::uint64_t bits;
+  if (word >= used.size()) {
+    word = used.size() - 1;
+    bits = used[word];
+  } else {
+    // keep the bits up to and including page_number - 1
+    bits = used[word] & (~std::uint64_t(0) >> (63 - (page_number - 1) % 64));
+  }
+  while (true) {
+    if (bits != 0) {
+      return word * 64 + 63 - __builtin_clzll(bits);
+    }
+    if (word == 0) {
+      return Page::INVALID_NUMBER;
+    }
+    bits = used[--word];
+  }
+}
+
+PageId PageDirectory::next(const PageId page_number) const {
+  const PageId first = page_number + 1;
+  std::size_t word = first / 64;
+  if (word >= used.size()) {
+    return Page::INVALID_NUMBER;
+  }
+  std::uint64_t bits = used[word] & (~std::uint64_t(0) << (first % 64));
+  while (true) {
+    if (bits != 0) {
+      return word * 64 + __builtin_ctzll(bits);
+    }
+    if (++word >= used.size()) {
+      return Page::INVALID_NUMBER;
+    }
+    bits = used[word];
+  }
+}
+
+PageId PageDirectory::firstFree(const PageId num_pages) {
+  for (std::size_t word = free_word; word * 64 < num_pages; word++) {
+    std::uint64_t bits = word < used.size() ? ~used[word] : ~std::uint64_t(0);
+    if (word == 0) {
+      bits &= ~std::uint64_t(1);	// page 0 is the file header
+    }
+    while (bits != 0) {
+      const PageId page_number = word * 64 + __builtin_ctzll(bits);
+      if (page_number >= num_pages) {
+        break;
+      }
+      if (std::find(map_pages.begin(), map_pages.end(), page_number) == map_pages.end()) {
+        free_word = word;
+        return page_number;
+      }
+      bits &= bits - 1;
+    }
+    free_word = word + 1;
+  }
+  return Page::INVALID_NUMBER;
+}
+
+void PageDirectory::touch(const PageId page_number) {
+  const std::size_t map = page_number / MAP_BITS;
+  if (map >= map_dirty.size()) {
+    map_dirty.resize(map + 1, false);
+  }
+  map_dirty[map] = true;
+}
+
+FileDescriptor::~FileDescriptor() {
+  ::close(fd_);
 }
 
 FileHeader File::readHeader() const {
-  FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
-  return header;
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  return header_->header;
+}
+
+void File::readBytes(const off_t offset, char* buffer,
+                     const std::size_t length) const {
+  if (direct_fd_ < 0) {
+    positionalRead(fd_->get(), buffer, length, offset, filename_);
+    return;
+  }
+
+  if (isAligned(buffer, offset, length)) {
+    positionalRead(direct_fd_, buffer, length, offset, filename_);
+    return;
+  }
+  // read the whole blocks around the range and copy out the part asked for
+  const off_t start = offset - offset % DIRECT_ALIGNMENT;
+  const off_t end = (offset + length + DIRECT_ALIGNMENT - 1) / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT;
+  char* blocks = direct_buffer.get(end - start);
+  positionalRead(direct_fd_, blocks, end - start, start, filename_);
+  std::memcpy(buffer, blocks + (offset - start), length);
+}
+
+void File::writeBytes(const off_t offset, const char* buffer,
+                      const std::size_t length) {
+  if (direct_fd_ < 0) {
+    positionalWrite(fd_->get(), buffer, length, offset, filename_);
+    return;
+  }
+
+  if (isAligned(buffer, offset, length)) {
+    positionalWrite(direct_fd_, buffer, length, offset, filename_);
+    return;
+  }
+  // patch the range into the blocks around it; the file latch keeps other
+  // writers of those blocks out meanwhile
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  const off_t start = offset - offset % DIRECT_ALIGNMENT;
+  const off_t end = (offset + length + DIRECT_ALIGNMENT - 1) / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT;
+  char* blocks = direct_buffer.get(end - start);
+  positionalRead(direct_fd_, blocks, end - start, start, filename_);
+  std::memcpy(blocks + (offset - start), buffer, length);
+  positionalWrite(direct_fd_, blocks, end - start, start, filename_);
+}
+
+void File::writeVector(const off_t position, const struct iovec* parts,
+                       const int count) {
+  if (direct_fd_ < 0) {
+    if (vectorWrite(fd_->get(), parts, count, position)) {
+      return;
+    }
+    // write what pwritev() refused one buffer at a time, which throws if the
+    // file itself can't be written
+    off_t offset = position;
+    for (int i = 0; i < count; i++) {
+      positionalWrite(fd_->get(), static_cast<const char*>(parts[i].iov_base), parts[i].iov_len, offset, filename_);
+      offset += parts[i].iov_len;
+    }
+    return;
+  }
+
+  // O_DIRECT wants aligned buffers, so gather the parts and write them as one range
+  if (count == 1) {
+    writeBytes(position, static_cast<const char*>(parts[0].iov_base), parts[0].iov_len);
+    return;
+  }
+  std::size_t length = 0;
+  for (int i = 0; i < count; i++) {
+    length += parts[i].iov_len;
+  }
+  if (position % DIRECT_ALIGNMENT == 0 && length % DIRECT_ALIGNMENT == 0) {
+    // whole blocks, such as pages: gather straight into aligned memory
+    char* gathered = direct_buffer.get(length);
+    std::size_t at = 0;
+    for (int i = 0; i < count; i++) {
+      std::memcpy(gathered + at, parts[i].iov_base, parts[i].iov_len);
+      at += parts[i].iov_len;
+    }
+    positionalWrite(direct_fd_, gathered, length, position, filename_);
+    return;
+  }
+  std::vector<char> gathered(length);
+  std::size_t at = 0;
+  for (int i = 0; i < count; i++) {
+    std::memcpy(&gathered[at], parts[i].iov_base, parts[i].iov_len);
+    at += parts[i].iov_len;
+  }
+  writeBytes(position, &gathered[0], length);
+}
+
+void File::sync() const {
+  flushHeader();
+  // one descriptor covers the writes of all of them, direct or not
+  while (fdatasync(fd_->get()) != 0) {
+    if (errno != EINTR) {
+      throw FileSyncException(filename_, errno);
+    }
+  }
+}
+
+void File::readPageInto(const PageId page_number, Page& page) const {
+  page = readPage(page_number);
+}
+
+void File::allocatePageInto(PageId& new_page_number, Page& page) {
+  page = allocatePage(new_page_number);
+}
+
+void File::writePages(const PageId first_page_number, const Page* const* pages,
+                      const std::size_t count) {
+  for (std::size_t i = 0; i < count; i++) {
+    writePage(first_page_number + i, *pages[i]);
+  }
 }
 
 void File::writeHeader(const FileHeader& header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
-  stream_->flush();
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  header_->header = header;
+  header_->num_pages = header.num_pages;
+  ++header_->changes;
+  if (header_->write_interval > 0 && header_->changes >= header_->write_interval) {
+    flushHeader();
+  }
+}
+
+void File::flushHeader() const {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  writeDirectory();
+  if (header_->changes == 0) {
+    return;
+  }
+  positionalWrite(fd_->get(), reinterpret_cast<const char*>(&header_->header), sizeof(FileHeader), 0, filename_);
+  header_->changes = 0;
+}
+
+void File::writeDirectory() const {
+  PageDirectory& directory = header_->directory;
+  if (!directory.loaded) {
+    return;
+  }
+  FileHeader& header = header_->header;
+  const std::size_t needed = directory.last_used_page / PageDirectory::MAP_BITS + 1;
+  while (directory.map_pages.size() < needed) {
+    // the page before the new one links to it
+    if (!directory.map_pages.empty()) {
+      directory.touch((directory.map_pages.size() - 1) * PageDirectory::MAP_BITS);
+    }
+    directory.touch(directory.map_pages.size() * PageDirectory::MAP_BITS);
+    directory.map_pages.push_back(header.num_pages++);
+    header_->num_pages = header.num_pages;
+    ++header_->changes;
+  }
+
+  for (std::size_t map = 0; map < directory.map_pages.size(); map++) {
+    if (map >= directory.map_dirty.size() || !directory.map_dirty[map]) {
+      continue;
+    }
+    Page page;
+    if (map + 1 < directory.map_pages.size()) {
+      page.header_.next_page_number = directory.map_pages[map + 1];
+    }
+    const PageId fields[2] = {directory.last_used_page, 0};
+    std::memcpy(page.data_, fields, sizeof(fields));
+    const std::size_t first_word = map * PageDirectory::MAP_WORDS;
+    if (first_word < directory.used.size()) {
+      const std::size_t words = std::min(PageDirectory::MAP_WORDS, directory.used.size() - first_word);
+      std::memcpy(page.data_ + sizeof(fields), &directory.used[first_word], words * sizeof(std::uint64_t));
+    }
+    positionalWrite(fd_->get(), reinterpret_cast<const char*>(&page), Page::SIZE,
+                    pagePosition(directory.map_pages[map]), filename_);
+    directory.map_dirty[map] = false;
+  }
+
+  const PageId first_map_page = (header.first_free_page & FileHeader::ALIGNED_FLAG) |
+      PageDirectory::MAP_FORMAT_FLAG | directory.map_pages[0];
+  if (header.first_free_page != first_map_page) {
+    header.first_free_page = first_map_page;
+    ++header_->changes;
+  }
+}
+
+void File::setHeaderWriteInterval(const std::uint32_t changes) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  header_->write_interval = changes;
+  if (changes > 0 && header_->changes >= changes) {
+    flushHeader();
+  }
 }
 
 
@@ -140,8 +659,9 @@ PageFile PageFile::open(const std::string& filename) {
   return PageFile(filename, false /* create_new */);
 }
 
-PageFile::PageFile(const std::string& name, const bool create_new)
-: File(name, create_new)
+PageFile::PageFile(const std::string& name, const bool create_new,
+                   const FileIoMode io_mode)
+: File(name, create_new, io_mode)
 {
 }
 
@@ -149,7 +669,7 @@ PageFile::~PageFile() {
 }
 
 PageFile::PageFile(const PageFile& other)
-: File(other.filename_, false /* create_new */)
+: File(other.filename_, false /* create_new */, other.io_mode_)
 {
 }
 
@@ -158,149 +678,141 @@ PageFile& PageFile::operator=(const PageFile& rhs) {
   // same file.
   close();	//close my file and associate me with the new one
   filename_ = rhs.filename_;
+  io_mode_ = rhs.io_mode_;
   openIfNeeded(false /* create_new */);
+  openDirect();
   return *this;
 }
 
+File* PageFile::clone() const {
+  return new PageFile(*this);
+}
+
 Page PageFile::allocatePage(PageId &new_page_number) {
-  FileHeader header = readHeader();
   Page new_page;
-  Page existing_page;
+  allocatePageInto(new_page_number, new_page);
+  return new_page;
+}
+
+void PageFile::allocatePageInto(PageId &new_page_number, Page& new_page) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  loadDirectory();
+  PageDirectory& directory = header_->directory;
+  FileHeader header = readHeader();
+  PageId previous_page_number;
+  PageId next_page_number;
   if (header.num_free_pages > 0) {
-    new_page = readPage(header.first_free_page, true /* allow_free */);
-    new_page.set_page_number(header.first_free_page);
-		new_page_number = new_page.page_number();
-    header.first_free_page = new_page.next_page_number();
+    // Reuse the lowest free page, between its neighbours in the used list.
+    new_page_number = directory.firstFree(header.num_pages);
+    assert(new_page_number != Page::INVALID_NUMBER);
     --header.num_free_pages;
-
-    if (header.first_used_page == Page::INVALID_NUMBER ||
-        header.first_used_page > new_page.page_number()) {
-      // Either have no pages used or the head of the used list is a page later
-      // than the one we just allocated, so add the new page to the head.
-      if (header.first_used_page > new_page.page_number()) {
-        new_page.set_next_page_number(header.first_used_page);
-      }
-      header.first_used_page = new_page.page_number();
-    } else {
-      // New page is reused from somewhere after the beginning, so we need to
-      // find where in the used list to insert it.
-      PageId next_page_number = Page::INVALID_NUMBER;
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        next_page_number = (*iter).next_page_number();
-        if (next_page_number > new_page.page_number() ||
-            next_page_number == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      existing_page.set_next_page_number(new_page.page_number());
-      new_page.set_next_page_number(next_page_number);
-    }
-
-    assert((header.num_free_pages == 0) ==
-           (header.first_free_page == Page::INVALID_NUMBER));
-  }
-	else
-	{
-    new_page.set_page_number(header.num_pages);
-		new_page_number = new_page.page_number();
-
-    if (header.first_used_page == Page::INVALID_NUMBER)
-		{
-      header.first_used_page = new_page.page_number();
-    }
-		else
-		{
-      // If we have pages allocated, we need to add the new page to the tail
-      // of the linked list.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      assert(existing_page.isUsed());
-      existing_page.set_next_page_number(new_page.page_number());
-    }
+    previous_page_number = directory.previous(new_page_number);
+    next_page_number = directory.next(new_page_number);
+  } else {
+    // Add a page at the end of the file, after the tail of the used list.
+    new_page_number = header.num_pages;
     ++header.num_pages;
+    previous_page_number = directory.last_used_page;
+    next_page_number = Page::INVALID_NUMBER;
+  }
+  directory.setUsed(new_page_number, true);
+  if (next_page_number == Page::INVALID_NUMBER) {
+    directory.last_used_page = new_page_number;
+    directory.touch(0);
   }
+
+  new_page.initialize();
+  new_page.set_page_number(new_page_number);
+  new_page.set_next_page_number(next_page_number);
   writePage(new_page_number, new_page.header_, new_page);
-  if (existing_page.page_number() != Page::INVALID_NUMBER) {
-    // If we updated an existing page by inserting the new page into the
-    // used list, we need to write it out.
-    writePage(existing_page.page_number(), existing_page.header_, existing_page);
+  if (previous_page_number == Page::INVALID_NUMBER) {
+    header.first_used_page = new_page_number;
+  } else {
+    writeNextPageNumber(previous_page_number, new_page_number);
   }
   writeHeader(header);
-
-  return new_page;
 }
 
 Page PageFile::readPage(const PageId page_number) const {
-  FileHeader header = readHeader();
+  Page page;
+  readPageInto(page_number, page);
+  return page;
+}
 
-	if (page_number >= header.num_pages)
+void PageFile::readPageInto(const PageId page_number, Page& page) const {
+	if (page_number >= numPages())
 	{
 		throw InvalidPageException(page_number, filename_);
 	}
-	return readPage(page_number, false /* allow_free */);
+	readPageInto(page_number, page, false /* allow_free */);
 }
 
-Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
-  Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(PageHeader));
-  stream_->read(reinterpret_cast<char*>(&page.data_[0]), Page::DATA_SIZE);
+void PageFile::readPageInto(const PageId page_number, Page& page,
+                            const bool allow_free) const {
+  readBytes(pagePosition(page_number), reinterpret_cast<char*>(&page), Page::SIZE);
   if (!allow_free && !page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
-
-  return page;
 }
 
 void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
-	PageHeader header = readPageHeader(new_page_number);
-	if (header.current_page_number == Page::INVALID_NUMBER)
-	{
-		// Page has been deleted since it was read.
-		throw InvalidPageException(new_page_number, filename_);
-	}
-	// Page on disk may have had its next page pointer updated since it was read;
-	// we don't modify that, but we do keep all the other modifications to the
-	// page header.
-	const PageId next_page_number = header.next_page_number;
-	header = new_page.header_;
-	header.next_page_number = next_page_number;
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+	// The page's next page pointer may have been updated since it was read; we
+	// don't modify that, but we do keep all the other modifications to the page
+	// header.
+	PageHeader header = new_page.header_;
+	header.next_page_number = keptNextPageNumber(new_page_number);
 	writePage(new_page_number, header, new_page);
 }
 
+void PageFile::writePages(const PageId first_page_number,
+                          const Page* const* pages, const std::size_t count) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  // look up all the next page pointers first, so the pages go out in one write
+  std::vector<PageHeader> headers(count);
+  for (std::size_t i = 0; i < count; i++) {
+    headers[i] = pages[i]->header_;
+    headers[i].next_page_number = keptNextPageNumber(first_page_number + i);
+  }
+
+  std::vector<struct iovec> parts(2 * count);
+  for (std::size_t i = 0; i < count; i++) {
+    parts[2 * i].iov_base = &headers[i];
+    parts[2 * i].iov_len = sizeof(PageHeader);
+    parts[2 * i + 1].iov_base = const_cast<char*>(&pages[i]->data_[0]);
+    parts[2 * i + 1].iov_len = Page::DATA_SIZE;
+  }
+  writeVector(pagePosition(first_page_number), &parts[0], parts.size());
+}
+
 void PageFile::deletePage(const PageId page_number) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  loadDirectory();
+  PageDirectory& directory = header_->directory;
   FileHeader header = readHeader();
+  if (page_number >= header.num_pages || !directory.isUsed(page_number)) {
+    throw InvalidPageException(page_number, filename_);
+  }
 
-  Page existing_page = readPage(page_number);
-  Page previous_page;
-  // If this page is the head of the used list, update the header to point to
-  // the next page in line.
-  if (page_number == header.first_used_page) {
-    header.first_used_page = existing_page.next_page_number();
+  // Unlink the page from the used list.
+  const PageId previous_page_number = directory.previous(page_number);
+  const PageId next_page_number = directory.next(page_number);
+  if (previous_page_number == Page::INVALID_NUMBER) {
+    header.first_used_page = next_page_number;
   } else {
-    // Walk the used list so we can update the page that points to this one.
-    for (FileIterator iter = begin(); iter != end(); ++iter) {
-      previous_page = *iter;
-      if (previous_page.next_page_number() == existing_page.page_number()) {
-        previous_page.set_next_page_number(existing_page.next_page_number());
-        break;
-      }
-    }
+    writeNextPageNumber(previous_page_number, next_page_number);
   }
-  // Clear the page and add it to the head of the free list.
-  existing_page.initialize();
-  existing_page.set_next_page_number(header.first_free_page);
-  header.first_free_page = page_number;
-  ++header.num_free_pages;
-  if (previous_page.isUsed()) {
-    writePage(previous_page.page_number(), previous_page.header_, previous_page);
+  if (directory.last_used_page == page_number) {
+    directory.last_used_page = previous_page_number;
+    directory.touch(0);
   }
-  writePage(page_number, existing_page.header_, existing_page);
+  directory.setUsed(page_number, false);
+  ++header.num_free_pages;
+
+  // Clearing the header is enough for the page to read as free.
+  const Page empty_page;
+  writeBytes(pagePosition(page_number), reinterpret_cast<const char*>(&empty_page.header_),
+             sizeof(PageHeader));
   writeHeader(header);
 }
 
@@ -315,20 +827,107 @@ FileIterator PageFile::end() {
 
 void PageFile::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(PageHeader));
-  stream_->write(reinterpret_cast<const char*>(&new_page.data_[0]),
-                 Page::DATA_SIZE);
-  stream_->flush();
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  // one write of the whole page, which is one block-aligned transfer in DIRECT_IO mode
+  struct iovec parts[2];
+  parts[0].iov_base = const_cast<PageHeader*>(&header);
+  parts[0].iov_len = sizeof(PageHeader);
+  parts[1].iov_base = const_cast<char*>(&new_page.data_[0]);
+  parts[1].iov_len = Page::DATA_SIZE;
+  writeVector(pagePosition(page_number), parts, 2);
 }
 
 PageHeader PageFile::readPageHeader(PageId page_number) const {
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(PageHeader));
+  readBytes(pagePosition(page_number), reinterpret_cast<char*>(&header), sizeof(PageHeader));
   return header;
 }
 
+void PageFile::writeNextPageNumber(const PageId page_number,
+                                   const PageId next_page_number) {
+  writeBytes(pagePosition(page_number) + static_cast<off_t>(offsetof(PageHeader, next_page_number)),
+             reinterpret_cast<const char*>(&next_page_number), sizeof(PageId));
+}
+
+PageId PageFile::nextUsedPage(const PageId page_number) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  // don't switch a file over just to read it
+  if (!header_->directory.loaded &&
+      !(header_->header.first_free_page & PageDirectory::MAP_FORMAT_FLAG)) {
+    return readPageHeader(page_number).next_page_number;
+  }
+  loadDirectory();
+  return header_->directory.next(page_number);
+}
+
+PageId PageFile::keptNextPageNumber(const PageId page_number) {
+  if (header_->directory.loaded ||
+      (header_->header.first_free_page & PageDirectory::MAP_FORMAT_FLAG)) {
+    loadDirectory();
+    if (!header_->directory.isUsed(page_number)) {
+      // Page has been deleted since it was read.
+      throw InvalidPageException(page_number, filename_);
+    }
+    return header_->directory.next(page_number);
+  }
+  const PageHeader on_disk = readPageHeader(page_number);
+  if (on_disk.current_page_number == Page::INVALID_NUMBER) {
+    // Page has been deleted since it was read.
+    throw InvalidPageException(page_number, filename_);
+  }
+  return on_disk.next_page_number;
+}
+
+void PageFile::loadDirectory() {
+  PageDirectory& directory = header_->directory;
+  if (directory.loaded) {
+    return;
+  }
+  const FileHeader header = readHeader();
+  directory.used.clear();
+  directory.map_pages.clear();
+  directory.map_dirty.clear();
+  directory.free_word = 0;
+  directory.last_used_page = Page::INVALID_NUMBER;
+
+  if (header.first_free_page & PageDirectory::MAP_FORMAT_FLAG) {
+    // Read the bitmap off the chain of map pages.
+    PageId map_page_number = header.first_free_page &
+        ~(PageDirectory::MAP_FORMAT_FLAG | FileHeader::ALIGNED_FLAG);
+    Page page;
+    while (map_page_number != Page::INVALID_NUMBER) {
+      readPageInto(map_page_number, page, true /* allow_free */);
+      if (directory.map_pages.empty()) {
+        std::memcpy(&directory.last_used_page, page.data_, sizeof(PageId));
+      }
+      const std::size_t first_word = directory.map_pages.size() * PageDirectory::MAP_WORDS;
+      directory.used.resize(first_word + PageDirectory::MAP_WORDS);
+      std::memcpy(&directory.used[first_word], page.data_ + 2 * sizeof(PageId),
+                  PageDirectory::MAP_WORDS * sizeof(std::uint64_t));
+      directory.map_pages.push_back(map_page_number);
+      map_page_number = page.header_.next_page_number;
+    }
+    directory.map_dirty.assign(directory.map_pages.size(), false);
+    directory.loaded = true;
+    return;
+  }
+
+  // A file without map pages: walk the used list once, then switch the file
+  // over. Its free list is dropped; the free pages are those not in use. A
+  // file created with ALIGNED_FLAG has no free list to begin with.
+  for (PageId page_number = header.first_used_page; page_number != Page::INVALID_NUMBER;
+       page_number = readPageHeader(page_number).next_page_number) {
+    directory.setUsed(page_number, true);
+    directory.last_used_page = page_number;
+  }
+  directory.map_dirty.assign(directory.last_used_page / PageDirectory::MAP_BITS + 1, true);
+  directory.loaded = true;
+  FileHeader upgraded = header;
+  upgraded.first_free_page = (header.first_free_page & FileHeader::ALIGNED_FLAG) |
+      PageDirectory::MAP_FORMAT_FLAG;
+  writeHeader(upgraded);
+}
+
 
 
 
@@ -340,15 +939,16 @@ BlobFile BlobFile::open(const std::string& filename) {
   return BlobFile(filename, false /* create_new */);
 }
 
-BlobFile::BlobFile(const std::string& name, const bool create_new)
-: File(name, create_new) {
+BlobFile::BlobFile(const std::string& name, const bool create_new,
+                   const FileIoMode io_mode)
+: File(name, create_new, io_mode) {
 }
 
 BlobFile::~BlobFile() {
 }
 
 BlobFile::BlobFile(const BlobFile& other)
-: File(other.filename_, false /* create_new */)
+: File(other.filename_, false /* create_new */, other.io_mode_)
 {
 }
 
@@ -357,13 +957,26 @@ BlobFile& BlobFile::operator=(const BlobFile& rhs) {
   // same file.
   close();	//close my file and associate me with the new one
   filename_ = rhs.filename_;
+  io_mode_ = rhs.io_mode_;
   openIfNeeded(false /* create_new */);
+  openDirect();
   return *this;
 }
 
+File* BlobFile::clone() const {
+  return new BlobFile(*this);
+}
+
 Page BlobFile::allocatePage(PageId &new_page_number) {
-  FileHeader header = readHeader();
 	Page new_page;
+	allocatePageInto(new_page_number, new_page);
+	return new_page;
+}
+
+void BlobFile::allocatePageInto(PageId &new_page_number, Page& new_page) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  FileHeader header = readHeader();
+	new_page.initialize();
 
 	new_page_number = header.num_pages;
 
@@ -375,21 +988,30 @@ Page BlobFile::allocatePage(PageId &new_page_number) {
 
 	writePage(new_page_number, new_page);
 	writeHeader(header);
-
-	return new_page;
 }
 
 Page BlobFile::readPage(const PageId page_number) const {
 	Page page;
-	stream_->seekg(pagePosition(page_number), std::ios::beg);
-	stream_->read(reinterpret_cast<char*>(&page), Page::SIZE);
+	readPageInto(page_number, page);
 	return page;
 }
 
+void BlobFile::readPageInto(const PageId page_number, Page& page) const {
+	readBytes(pagePosition(page_number), reinterpret_cast<char*>(&page), Page::SIZE);
+}
+
 void BlobFile::writePage(const PageId new_page_number, const Page& new_page) {
-	stream_->seekp(pagePosition(new_page_number), std::ios::beg);
-	stream_->write(reinterpret_cast<const char*>(&new_page), Page::SIZE);
-	stream_->flush();
+	writeBytes(pagePosition(new_page_number), reinterpret_cast<const char*>(&new_page), Page::SIZE);
+}
+
+void BlobFile::writePages(const PageId first_page_number,
+                          const Page* const* pages, const std::size_t count) {
+	std::vector<struct iovec> parts(count);
+	for (std::size_t i = 0; i < count; i++) {
+		parts[i].iov_base = const_cast<Page*>(pages[i]);
+		parts[i].iov_len = Page::SIZE;
+	}
+	writeVector(pagePosition(first_page_number), &parts[0], count);
 }
 
 //delePage should not be called for a blob_file, not supported
@@ -7,17 +7,42 @@
 
 #pragma once
 
-#include <fstream>
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
+#include <sys/types.h>
 
 #include "page.h"
 
+struct iovec;
+
 namespace badgerdb {
 
 class FileIterator;
 
+/**
+ * @brief How a File object moves page data to and from disk.
+ */
+enum FileIoMode {
+  /**
+   * Through the shared descriptor and the operating system's page cache.
+   */
+  BUFFERED_IO = 0,
+
+  /**
+   * Page reads and writes bypass the page cache with O_DIRECT, through
+   * block-aligned buffers. Falls back to BUFFERED_IO where the file system
+   * refuses O_DIRECT, and for files created before pages were block aligned
+   * (see FileHeader::ALIGNED_FLAG). Headers still go through the shared
+   * descriptor.
+   */
+  DIRECT_IO = 1
+};
+
 /**
  * @brief Header metadata for files on disk which contain pages.
  */
@@ -39,9 +64,18 @@ struct FileHeader {
 
   /**
    * Page number of the first free (allocated but unused) page in the file.
+   * The high bits are flags: ALIGNED_FLAG, and PageDirectory::MAP_FORMAT_FLAG
+   * in a PageFile.
    */
   PageId first_free_page;
 
+  /**
+   * Set in first_free_page of files whose header has the first page slot to
+   * itself, so that page n starts at n * Page::SIZE, on a block boundary. Files
+   * created without it keep their pages right after the header.
+   */
+  static const PageId ALIGNED_FLAG = 0x40000000;
+
   /**
    * Returns true if this file header is equal to the other.
    *
@@ -56,19 +90,220 @@ struct FileHeader {
   }
 };
 
+/**
+ * @brief Which pages of a PageFile are in use, so that allocating and deleting
+ *        a page need not walk the page lists on disk.
+ *
+ * On disk the bitmap is kept in map pages, which are on neither the used nor the
+ * free list and read as free pages. first_free_page of the header holds
+ * MAP_FORMAT_FLAG and the number of the first map page, 0 while there is none;
+ * each map page links to the next through its next page number, and the first
+ * one also records the last page of the used list. Free pages are the pages
+ * which are neither in use nor map pages.
+ *
+ * Files written before map pages existed keep a free list in first_free_page
+ * instead. Their directory is rebuilt from the used list the first time a page
+ * is allocated or deleted, and written in the new format from then on.
+ */
+struct PageDirectory {
+  /**
+   * Set in first_free_page of files in the map page format.
+   */
+  static const PageId MAP_FORMAT_FLAG = 0x80000000;
+
+  /**
+   * Bitmap words per map page, after the last used page number and a spare one.
+   */
+  static const std::size_t MAP_WORDS =
+      (Page::DATA_SIZE - 2 * sizeof(PageId)) / sizeof(std::uint64_t);
+
+  /**
+   * Page numbers covered by one map page.
+   */
+  static const PageId MAP_BITS = MAP_WORDS * 64;
+
+  /**
+   * True once the directory is read or rebuilt.
+   */
+  bool loaded;
+
+  /**
+   * One bit per page number, set for pages in use; bits past the end are clear.
+   */
+  std::vector<std::uint64_t> used;
+
+  /**
+   * Last page of the used list, which has the highest number in use.
+   */
+  PageId last_used_page;
+
+  /**
+   * Map pages, in order.
+   */
+  std::vector<PageId> map_pages;
+
+  /**
+   * Per map page, whether it changed since it was written. May run ahead of
+   * map_pages for bits whose map page doesn't exist yet.
+   */
+  std::vector<bool> map_dirty;
+
+  /**
+   * Bitmap word below which there is no free page.
+   */
+  std::size_t free_word;
+
+  /**
+   * Returns true if the page is in use.
+   */
+  bool isUsed(const PageId page_number) const;
+
+  /**
+   * Marks a page as in use or not.
+   */
+  void setUsed(const PageId page_number, const bool in_use);
+
+  /**
+   * Returns the page in use with the highest number below the given one, or
+   * Page::INVALID_NUMBER.
+   */
+  PageId previous(const PageId page_number) const;
+
+  /**
+   * Returns the page in use with the lowest number above the given one, or
+   * Page::INVALID_NUMBER.
+   */
+  PageId next(const PageId page_number) const;
+
+  /**
+   * Returns the free page with the lowest number, or Page::INVALID_NUMBER.
+   *
+   * @param num_pages   Number of pages of the file.
+   */
+  PageId firstFree(const PageId num_pages);
+
+  /**
+   * Marks the map page covering the given page as changed.
+   */
+  void touch(const PageId page_number);
+};
+
+/**
+ * @brief Header of an open file, cached in memory and shared by all File objects
+ *        of the file. Changes reach the disk when the file is flushed, synced or
+ *        closed, or every write_interval changes.
+ */
+struct CachedHeader {
+  /**
+   * The header; guarded by the file latch.
+   */
+  FileHeader header;
+
+  /**
+   * Copy of header.num_pages, for bounds checks without the latch.
+   */
+  std::atomic<PageId> num_pages;
+
+  /**
+   * Changes to the header since it was last written.
+   */
+  std::uint32_t changes;
+
+  /**
+   * Number of changes after which the header is written; 0 to wait for a flush,
+   * sync or close.
+   */
+  std::uint32_t write_interval;
+
+  /**
+   * Pages in use, for a PageFile; written back with the header.
+   */
+  PageDirectory directory;
+
+  /**
+   * Offset of page 1 in the file, which depends on FileHeader::ALIGNED_FLAG.
+   */
+  off_t first_page_position;
+};
+
+/**
+ * @brief Descriptor of an open file, shared by all File objects of the file and
+ *        closed when the last of them goes away.
+ */
+class FileDescriptor {
+ public:
+  /**
+   * Takes over the given descriptor.
+   *
+   * @param fd  Open descriptor.
+   */
+  explicit FileDescriptor(const int fd) : fd_(fd) {}
+
+  /**
+   * Closes the descriptor.
+   */
+  ~FileDescriptor();
+
+  /**
+   * Returns the descriptor.
+   */
+  int get() const { return fd_; }
+
+ private:
+  FileDescriptor(const FileDescriptor&);
+  FileDescriptor& operator=(const FileDescriptor&);
+
+  /**
+   * The descriptor.
+   */
+  const int fd_;
+};
+
+/**
+ * @brief Told when the last File object of a file other than the buffer pool's
+ *        goes away.
+ *
+ * The buffer pool keeps a File object of its own for every file it holds pages
+ * of (see File::poolHandle()), which keeps the file open. A listener registered
+ * with File::addCloseListener() is called once no other File object of the
+ * file is left, so it can write back and drop the pages and let the file close.
+ */
+class FileCloseListener {
+ public:
+  virtual ~FileCloseListener() {}
+
+  /**
+   * Called after the last File object of a file, not counting pool handles, is
+   * closed. No latch of the file is held.
+   *
+   * @param id  Id of the file, which its pool handles still have.
+   */
+  virtual void fileClosed(const FileId id) = 0;
+};
+
 /**
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
  *
- * The File class wraps a stream to an underlying file on disk.  Files contain
+ * The File class wraps a descriptor of an underlying file on disk.  Files contain
  * fixed-sized pages, and they never deallocate space (though they do reuse
  * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
+ * underlying file, they will share the descriptor.
  * If a file that has already been opened (possibly by another query), then the File class
- * detects this (by looking in the open_streams_ map) and just returns a file object with
- * the already created stream for the file without actually opening the UNIX file again. 
+ * detects this (by looking in the open_fds_ map) and just returns a file object with
+ * the already opened descriptor for the file without actually opening the UNIX file again. 
+ * All those objects also share the file's id(), under which the buffer pool caches its
+ * pages.
+ *
+ * All I/O is positional (pread() and pwrite()), so there is no shared file position
+ * and several threads may read and write pages of one file at the same time. A latch
+ * shared by all File objects of the file serializes changes to the header and the page
+ * lists, and the read-modify-write of partial blocks in DIRECT_IO mode.
  *
- * @warning This class is not threadsafe.
+ * The header is read from disk once, when the file is opened, and kept in memory with
+ * the descriptor; allocating or deleting a page changes only that copy. It is written
+ * back by flushHeader(), which sync() and the last close call, and optionally every
+ * few changes (see setHeaderWriteInterval()).
  */
 
 
@@ -80,15 +315,19 @@ class File {
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param io_mode     How page data is read and written.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  File(const std::string& name, const bool create_new);
+  File(const std::string& name, const bool create_new,
+       const FileIoMode io_mode = BUFFERED_IO);
 
   /**
-   * Deletes an existing file.
+   * Deletes an existing file. Every File object of the file must be closed
+   * first. The handles a buffer pool keeps are let go of when the last other
+   * File object closes, unless a page of the file is still pinned in that pool.
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the file doesn't exist.
@@ -121,6 +360,8 @@ class File {
    * Allocates a new page in the file.
    *
    * @return The new page.
+   * @throws  FileIoException       If the operating system fails to read or
+   *                                write the file.
    */
   virtual Page allocatePage(PageId &new_page_number) = 0;
 
@@ -131,25 +372,91 @@ class File {
    * @return  The page.
    * @throws  InvalidPageException  If the page doesn't exist in the file or is
    *                                not currently used.
+   * @throws  FileIoException       If the operating system fails to read or
+   *                                write the file.
    */
   virtual Page readPage(const PageId page_number) const = 0;
 
+  /**
+   * Reads an existing page from the file straight into the given page, such as
+   * a buffer pool frame, with no temporary page in between. The default reads
+   * into a temporary and copies it.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   * @throws  FileIoException       If the operating system fails to read or
+   *                                write the file.
+   */
+  virtual void readPageInto(const PageId page_number, Page& page) const;
+
+  /**
+   * Allocates a new page in the file and sets it up in the given page. The
+   * default allocates a temporary and copies it.
+   *
+   * @param new_page_number   The number of the new page is returned here.
+   * @param page              Page to set up as the new page.
+   */
+  virtual void allocatePageInto(PageId& new_page_number, Page& page);
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
    *
    * @param page_number Number of page whose contents to replace.
    * @param new_page    Page to write.
+   * @throws  FileIoException       If the operating system fails to read or
+   *                                write the file.
    */
   virtual void writePage(const PageId page_number, const Page& new_page) = 0;
 
+  /**
+   * Writes pages with consecutive numbers, in as few system calls as the I/O
+   * mode allows. The buffer manager writes runs of adjacent dirty pages this way.
+   * The default writes the pages one by one.
+   *
+   * @param first_page_number Number of the first page to write.
+   * @param pages             Pages to write, one per page number from
+   *                          first_page_number on.
+   * @param count             Number of pages.
+   * @throws  FileIoException       If the operating system fails to read or
+   *                                write the file.
+   */
+  virtual void writePages(const PageId first_page_number,
+                          const Page* const* pages, const std::size_t count);
+
   /**
    * Deletes a page from the file.
    *
    * @param page_number   Number of page to delete.
+   * @throws  FileIoException       If the operating system fails to read or
+   *                                write the file.
    */
   virtual void deletePage(const PageId page_number) = 0;
 
+  /**
+   * Writes back the cached header and waits until it and every page written so
+   * far, through any File object of this file, is on stable storage. Writes are
+   * otherwise left to the operating system.
+   *
+   * @throws  FileSyncException   If the operating system reports an error.
+   */
+  void sync() const;
+
+  /**
+   * Writes the cached header to the file if it changed since it was last written.
+   */
+  void flushHeader() const;
+
+  /**
+   * Sets how many header changes, through any File object of this file, are
+   * written back at once. 0, the default, leaves them for flushHeader().
+   *
+   * @param changes   Number of changes.
+   */
+  void setHeaderWriteInterval(const std::uint32_t changes);
+
   /**
    * Returns the name of the file this object represents.
    *
@@ -157,6 +464,60 @@ class File {
    */
   const std::string& filename() const { return filename_; }
 
+  /**
+   * Returns the id of the underlying file. Every File object of the file has
+   * the same id for as long as any of them is open; ids are never reused.
+   *
+   * @return Id of file.
+   */
+  FileId id() const { return id_; }
+
+  /**
+   * Id no open file has.
+   */
+  static const FileId INVALID_ID = 0;
+
+  /**
+   * Opens another File object of the same kind on the same file.
+   *
+   * @return  Newly allocated File object, owned by the caller.
+   */
+  virtual File* clone() const = 0;
+
+  /**
+   * Opens another File object on the same file for a buffer pool to write its
+   * pages back through. Pool handles don't count as users of the file: when
+   * every other File object of it is closed, the close listeners are told.
+   *
+   * @return  Newly allocated File object, owned by the caller.
+   */
+  File* poolHandle() const;
+
+  /**
+   * Registers a listener to be told when the last File object of a file other
+   * than its pool handles is closed.
+   *
+   * @param listener  Listener, which must stay alive until removed.
+   */
+  static void addCloseListener(FileCloseListener* listener);
+
+  /**
+   * Unregisters a listener. Returns once no call to it is in progress.
+   *
+   * @param listener  Listener added with addCloseListener().
+   */
+  static void removeCloseListener(FileCloseListener* listener);
+
+  /**
+   * Returns true if page data of this object bypasses the page cache.
+   */
+  bool isDirect() const { return io_mode_ == DIRECT_IO; }
+
+  /**
+   * Alignment of file offsets, lengths and memory required by DIRECT_IO.
+   */
+  static const std::size_t DIRECT_ALIGNMENT = 4096;
+
  	/**
    * Returns pageid of first page in the file.
    *
@@ -164,7 +525,6 @@ class File {
    */
 	PageId getFirstPageNo();
 
- protected:
   /**
    * Returns the position of the page with the given number in the file (as an
    * offset from the beginning of the file).
@@ -172,14 +532,16 @@ class File {
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
-  static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+  off_t pagePosition(const PageId page_number) const {
+    return header_->first_page_position + static_cast<off_t>(page_number - 1) * Page::SIZE;
   }
 
+ protected:
+
   /**
    * Opens the underlying file named in filename_.
    * This method only opens the file if no other File objects exist that access
-   * the same filesystem file; otherwise, it reuses the existing stream.
+   * the same filesystem file; otherwise, it reuses the existing descriptor.
    *
    * @param create_new  Whether to create a new file.
    * @throws  FileExistsException     If the underlying file exists and
@@ -190,48 +552,178 @@ class File {
   void openIfNeeded(const bool create_new);
 
   /**
-   * Closes the underlying file stream in <stream_>.
-   * This method only closes the file if no other File objects exist that access
-   * the same file.
+   * Lets go of the underlying descriptor in <fd_>.
+   * The file is only closed if no other File objects exist that access the same
+   * file.
    */
   void close();
 
   /**
-   * Reads the header for this file from disk.
+   * Reads bytes of page data at the given position, through the direct
+   * descriptor in DIRECT_IO mode and through the shared one otherwise.
+   * Bytes past the end of the file read as zero.
+   *
+   * @param position  Offset in the file.
+   * @param buffer    Destination.
+   * @param length    Number of bytes.
+   */
+  void readBytes(const off_t position, char* buffer,
+                 const std::size_t length) const;
+
+  /**
+   * Writes bytes of page data at the given position. In DIRECT_IO mode the
+   * surrounding blocks are read, patched and written back whole.
+   *
+   * @param position  Offset in the file.
+   * @param buffer    Source.
+   * @param length    Number of bytes.
+   */
+  void writeBytes(const off_t position, const char* buffer,
+                  const std::size_t length);
+
+  /**
+   * Writes the concatenation of several buffers at the given position. In
+   * BUFFERED_IO mode this is pwritev() on the shared descriptor; in DIRECT_IO
+   * mode the buffers are gathered into one aligned write.
+   *
+   * @param position  Offset in the file.
+   * @param parts     Source buffers, in file order.
+   * @param count     Number of buffers.
+   */
+  void writeVector(const off_t position, const struct iovec* parts,
+                   const int count);
+
+  /**
+   * Opens direct_fd_ if io_mode_ asks for DIRECT_IO.
+   */
+  void openDirect();
+
+  /**
+   * Returns the cached header for this file.
    *
    * @return  The file header.
    */
   FileHeader readHeader() const;
 
   /**
-   * Writes the given header to the disk as the header for this file.
+   * Replaces the cached header for this file. It is written to disk later, see
+   * flushHeader().
    *
-   * @param header  File header to write.
+   * @param header  New file header.
    */
   void writeHeader(const FileHeader& header);
 
-  typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
+  /**
+   * Returns the number of pages of the file, without taking the latch.
+   */
+  PageId numPages() const { return header_->num_pages.load(); }
+
+  /**
+   * Writes the changed map pages of the directory, adding map pages at the end
+   * of the file where the used pages have outgrown them, and points the cached
+   * header at them. The caller holds the latch and writes the header after.
+   */
+  void writeDirectory() const;
+
+  typedef std::map<std::string, std::shared_ptr<FileDescriptor> > DescriptorMap;
   typedef std::map<std::string, int> CountMap;
+  typedef std::map<std::string, std::shared_ptr<std::recursive_mutex> > LatchMap;
+  typedef std::map<std::string, FileId> IdMap;
+  typedef std::map<std::string, std::shared_ptr<CachedHeader> > HeaderMap;
 
   /**
-   * Streams for opened files.
+   * Descriptors of opened files.
    */
-  static StreamMap open_streams_;
+  static DescriptorMap open_fds_;
 
   /**
    * Counts for opened files.
    */
   static CountMap open_counts_;
 
+  /**
+   * Latches for opened files, shared like the descriptors.
+   */
+  static LatchMap open_latches_;
+
+  /**
+   * Ids of opened files, shared like the descriptors.
+   */
+  static IdMap open_ids_;
+
+  /**
+   * Cached headers of opened files, shared like the descriptors.
+   */
+  static HeaderMap open_headers_;
+
+  /**
+   * Id the next file opened gets.
+   */
+  static FileId next_id_;
+
+  /**
+   * Counts of pool handles among open_counts_.
+   */
+  static CountMap pool_counts_;
+
+  /**
+   * Guards open_fds_, open_counts_, pool_counts_, open_latches_, open_ids_,
+   * open_headers_ and next_id_.
+   */
+  static std::mutex open_mutex_;
+
+  /**
+   * Listeners told when a file is left with only pool handles. Made on first
+   * use, since a buffer pool constructed during static initialization
+   * registers before the static members of this file would be.
+   */
+  static std::vector<FileCloseListener*>& closeListeners();
+
+  /**
+   * Guards closeListeners(), and is held while they are called.
+   */
+  static std::mutex& listenersMutex();
+
   /**
    * Name of the file this object represents.
    */
   std::string filename_;
 
   /**
-   * Stream for underlying filesystem object.
+   * Descriptor of the underlying filesystem object.
+   */
+  std::shared_ptr<FileDescriptor> fd_;
+
+  /**
+   * Latch serializing changes to the header and page lists across every File
+   * object of this file.
+   */
+  std::shared_ptr<std::recursive_mutex> latch_;
+
+  /**
+   * Cached header of the underlying file.
+   */
+  std::shared_ptr<CachedHeader> header_;
+
+  /**
+   * Id of the underlying file.
+   */
+  FileId id_;
+
+  /**
+   * How page data is read and written.
+   */
+  FileIoMode io_mode_;
+
+  /**
+   * Descriptor opened with O_DIRECT in DIRECT_IO mode, -1 otherwise.
+   */
+  int direct_fd_;
+
+  /**
+   * True if this object was opened by poolHandle().
    */
-  std::shared_ptr<std::fstream> stream_;
+  bool pool_handle_;
 
   friend class FileIterator;
 };
@@ -249,10 +741,10 @@ class PageFile : public File {
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+	 * It first checks if the file is already open. If so, then the new File object created uses the same descriptor to read to or write fom
 	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the descriptor associated with this File object are inserted into the
+	 * open_fds_ map.
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
@@ -264,12 +756,14 @@ class PageFile : public File {
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param io_mode     How page data is read and written.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  PageFile(const std::string& name, const bool create_new);
+  PageFile(const std::string& name, const bool create_new,
+           const FileIoMode io_mode = BUFFERED_IO);
 
   /**
    * Copy constructor.
@@ -287,6 +781,11 @@ class PageFile : public File {
    */
   PageFile& operator=(const PageFile& rhs);
 
+  /**
+   * Opens another PageFile object on the same file.
+   */
+  File* clone() const;
+
   /**
    * Destructor that automatically closes the underlying file if no other
    * File objects are using it.
@@ -300,6 +799,14 @@ class PageFile : public File {
    */
   Page allocatePage(PageId &new_page_number);
 
+  /**
+   * Allocates a new page in the file, setting it up in place.
+   *
+   * @param new_page_number   The number of the new page is returned here.
+   * @param new_page          Page to set up as the new page.
+   */
+  void allocatePageInto(PageId &new_page_number, Page& new_page);
+
   /**
    * Reads an existing page from the file.
    *
@@ -310,6 +817,16 @@ class PageFile : public File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file straight into the given page.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPageInto(const PageId page_number, Page& page) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -319,6 +836,18 @@ class PageFile : public File {
    */
   void writePage(const PageId page_number, const Page& new_page);
 
+  /**
+   * Writes pages with consecutive numbers in one vectored write, keeping the
+   * next page pointers on disk like writePage() does.
+   *
+   * @param first_page_number Number of the first page to write.
+   * @param pages             Pages to write.
+   * @param count             Number of pages.
+   * @throws  InvalidPageException  If one of the pages has been deleted.
+   */
+  void writePages(const PageId first_page_number, const Page* const* pages,
+                  const std::size_t count);
+
   /**
    * Deletes a page from the file.
    *
@@ -344,19 +873,21 @@ class PageFile : public File {
  private:
 
   /**
-   * Reads a page from the file.  If <allow_free> is not set, an exception
-   * will be thrown if the page read from disk is not currently in use.
+   * Reads a page from the file into the given page.  If <allow_free> is not
+   * set, an exception will be thrown if the page read from disk is not
+   * currently in use.
    *
-   * No bounds checking is performed; the underlying file stream will throw
-   * an exception if the page is past the end of the file.
+   * No bounds checking is performed; a page past the end of the file reads
+   * as zero, i.e. as a free page.
    *
    * @param page_number   Number of page to read.
+   * @param page          Page to read into.
    * @param allow_free    Whether to allow reading a free (unused) page.
-   * @return  The page.
    * @throws  InvalidPageException  If the page is free (unused) and
    *                                allow_free is false.
    */
-  Page readPage(const PageId page_number, const bool allow_free) const;
+  void readPageInto(const PageId page_number, Page& page,
+                    const bool allow_free) const;
 
   /**
    * Writes a page into the file at the given page number with the given header.
@@ -379,6 +910,42 @@ class PageFile : public File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
+  /**
+   * Sets the next page number in the header of the given page on disk, leaving
+   * the rest of the page alone.
+   *
+   * @param page_number       Number of page to change.
+   * @param next_page_number  New next page number.
+   */
+  void writeNextPageNumber(const PageId page_number, const PageId next_page_number);
+
+  /**
+   * Reads or rebuilds the directory of pages in use unless it is loaded. The
+   * caller holds the latch.
+   */
+  void loadDirectory();
+
+  /**
+   * Returns the page after the given one in the used list. Answered from the
+   * directory when the file has map pages, from the page header on disk
+   * otherwise.
+   *
+   * @param page_number   Number of a page in use.
+   * @return  Next page number, or Page::INVALID_NUMBER after the last page.
+   */
+  PageId nextUsedPage(const PageId page_number);
+
+  /**
+   * Returns the next page number a page being written keeps: the one in the
+   * directory when the file has map pages, the one on disk otherwise. The
+   * caller holds the latch.
+   *
+   * @param page_number   Number of page to be written.
+   * @return  Next page number of the page.
+   * @throws  InvalidPageException  If the page has been deleted.
+   */
+  PageId keptNextPageNumber(const PageId page_number);
+
   friend class FileIterator;
 };
 
@@ -395,10 +962,10 @@ class BlobFile : public File {
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+	 * It first checks if the file is already open. If so, then the new File object created uses the same descriptor to read to or write fom
 	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the descriptor associated with this File object are inserted into the
+	 * open_fds_ map.
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
@@ -412,12 +979,14 @@ class BlobFile : public File {
    * @see File::open()
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param io_mode     How page data is read and written.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  BlobFile(const std::string& name, const bool create_new);
+  BlobFile(const std::string& name, const bool create_new,
+           const FileIoMode io_mode = BUFFERED_IO);
 
   /**
    * Copy constructor.
@@ -435,6 +1004,11 @@ class BlobFile : public File {
    */
   BlobFile& operator=(const BlobFile& rhs);
 
+  /**
+   * Opens another BlobFile object on the same file.
+   */
+  File* clone() const;
+
   /**
    * Destructor that automatically closes the underlying file if no other
    * File objects are using it.
@@ -448,6 +1022,14 @@ class BlobFile : public File {
    */
   Page allocatePage(PageId &new_page_number);
 
+  /**
+   * Allocates a new page in the file, setting it up in place.
+   *
+   * @param new_page_number   The number of the new page is returned here.
+   * @param new_page          Page to set up as the new page.
+   */
+  void allocatePageInto(PageId &new_page_number, Page& new_page);
+
   /**
    * Reads an existing page from the file.
    *
@@ -458,6 +1040,16 @@ class BlobFile : public File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file straight into the given page.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPageInto(const PageId page_number, Page& page) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -467,6 +1059,16 @@ class BlobFile : public File {
    */
   void writePage(const PageId page_number, const Page& new_page);
 
+  /**
+   * Writes pages with consecutive numbers in one vectored write.
+   *
+   * @param first_page_number Number of the first page to write.
+   * @param pages             Pages to write.
+   * @param count             Number of pages.
+   */
+  void writePages(const PageId first_page_number, const Page* const* pages,
+                  const std::size_t count);
+
   /**
    * Deletes a page from the file.
    *
@@ -18,7 +18,8 @@ namespace badgerdb {
  * @brief Iterator for iterating over the pages in a file.
  *
  * This class provides a forward-only iterator for iterating over all of the
- * pages in a file.
+ * pages in a file. Once the file has map pages, advancing it takes the next
+ * page number from the page directory instead of reading the page header.
  */
 class FileIterator {
  public:
@@ -60,8 +61,7 @@ class FileIterator {
    */
 	inline FileIterator& operator++() {
     assert(file_ != NULL);
-    const PageHeader& header = file_->readPageHeader(current_page_number_);
-    current_page_number_ = header.next_page_number;
+    current_page_number_ = file_->nextUsedPage(current_page_number_);
 
 		return *this;
 	}
@@ -72,8 +72,7 @@ class FileIterator {
 		FileIterator tmp = *this;   // copy ourselves
 
     assert(file_ != NULL);
-    const PageHeader& header = file_->readPageHeader(current_page_number_);
-    current_page_number_ = header.next_page_number;
+    current_page_number_ = file_->nextUsedPage(current_page_number_);
 
 		return tmp;
 	}
@@ -85,18 +84,27 @@ class FileIterator {
    * @return    True if other iterator is equal to this one.
    */
 	inline bool operator==(const FileIterator& rhs) const {
-    return file_->filename() == rhs.file_->filename() &&
-        current_page_number_ == rhs.current_page_number_;
+    return current_page_number_ == rhs.current_page_number_ &&
+        sameFile(rhs);
   }
 
 	inline bool operator!=(const FileIterator& rhs) const {
-    return (file_->filename() != rhs.file_->filename()) ||
-        (current_page_number_ != rhs.current_page_number_);
+    return !(*this == rhs);
+  }
+
+  /**
+   * Returns the number of the page the iterator points at, without reading it.
+   *
+   * @return  Page number, or Page::INVALID_NUMBER past the last page.
+   */
+  inline PageId pageNo() const {
+    return current_page_number_;
   }
 
   /**
    * Dereferences the iterator, returning a copy of the current page in the
-   * file.
+   * file. This reads the page from disk; a scan going through the buffer pool
+   * pins pageNo() instead.
    *
    * @return  Page in file.
    */
@@ -104,6 +112,17 @@ class FileIterator {
   { return file_->readPage(current_page_number_); }
 
  private:
+  /**
+   * Returns true if both iterators are over the same open file, possibly
+   * through different File objects.
+   */
+  inline bool sameFile(const FileIterator& rhs) const {
+    if (file_ == rhs.file_) {
+      return true;
+    }
+    return file_ != NULL && rhs.file_ != NULL && file_->id() == rhs.file_->id();
+  }
+
   /**
    * File we're iterating over.
    */
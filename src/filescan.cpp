@@ -13,24 +13,37 @@ namespace badgerdb {
 FileScan::FileScan(const std::string &name, BufMgr *bufferMgr)
 {
   file = new PageFile(name, false);	//dont create new file
+  ownsFile = true;
+  pagesAhead = 0;
+  readAheadDepth = DEFAULT_READ_AHEAD;
+	bufMgr = bufferMgr;
+	filePageIter = file->begin();
+}
+
+FileScan::FileScan(PageFile *scanFile, BufMgr *bufferMgr)
+{
+  file = scanFile;
+  ownsFile = false;
+  pagesAhead = 0;
+  readAheadDepth = DEFAULT_READ_AHEAD;
 	bufMgr = bufferMgr;
-	curDirtyFlag = false;
-  curPage = NULL;
 	filePageIter = file->begin();
 }
 
 FileScan::~FileScan()
 {
   // generally must unpin last page of the scan
-  if (curPage != NULL)
+  if (curPage.valid())
   {
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
-    curPage = NULL;
-		curDirtyFlag = false;
-    filePageIter = file->begin();
+    curPage.release();
+  }
+  // the prefetch workers may still be loading pages into our ring
+  bufMgr->cancelPrefetch(file);
+
+  if (ownsFile)
+  {
+    delete file;
   }
-  bufMgr->flushFile(file);
-  delete file;
 }
 
 void FileScan::scanNext(RecordId& outRid)
@@ -43,7 +56,7 @@ void FileScan::scanNext(RecordId& outRid)
 	}
 
   // special case of the first record of the first page of the file
-  if (curPage == NULL)
+  if (!curPage.valid())
   {
     // need to get the first page of the file
 		filePageIter = file->begin();
@@ -52,9 +65,11 @@ void FileScan::scanNext(RecordId& outRid)
 			throw EndOfFileException();
 		}
 	 
-		// read the first page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage); 
-		curDirtyFlag = false;
+		// read the first page of the file, and start loading the ones after it
+    aheadIter = filePageIter;
+    pagesAhead = 0;
+    readAhead();
+    curPage = bufMgr->pinPage(file, filePageIter.pageNo(), &ring);
 
 		// get the first record off the page
     pageRecordIter = curPage->begin(); 
@@ -76,19 +91,23 @@ void FileScan::scanNext(RecordId& outRid)
   while (pageRecordIter == curPage->end())
   {
     // unpin the current page
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
-    curPage = NULL;
-    curDirtyFlag = false;
+    curPage.release();
 
     filePageIter++;
     if (filePageIter == file->end())
     {
-      curPage = NULL;
 			throw EndOfFileException();
     }
 
+    // keep the read-ahead window in front of the scan
+    if (pagesAhead > 0)
+      pagesAhead--;
+    else
+      aheadIter = filePageIter;
+    readAhead();
+
     // read the next page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage);
+    curPage = bufMgr->pinPage(file, filePageIter.pageNo(), &ring);
 
     // get the first record off the page
     pageRecordIter = curPage->begin(); 
@@ -114,7 +133,26 @@ std::string FileScan::getRecord()
 // mark current page of scan dirty
 void FileScan::markDirty()
 {
-  curDirtyFlag = true;
+  curPage.markDirty();
+}
+
+void FileScan::setReadAhead(const std::uint32_t depth)
+{
+  readAheadDepth = depth < BufferRing::DEFAULT_SIZE / 2 ? depth : BufferRing::DEFAULT_SIZE / 2;
+}
+
+void FileScan::readAhead()
+{
+  std::vector<PageId> pages;
+  while (pagesAhead < readAheadDepth && aheadIter != file->end())
+  {
+    ++aheadIter;
+    if (aheadIter == file->end())
+      break;
+    pages.push_back(aheadIter.pageNo());
+    pagesAhead++;
+  }
+  bufMgr->prefetch(file, pages, &ring);
 }
 
 }
@@ -19,13 +19,26 @@ namespace badgerdb {
 
 /**
  * @brief This class is used to sequentially scan records in a relation.
+ *
+ * Pages are read through a private BufferRing, so a scan of a large relation recycles a
+ * few frames instead of pushing the rest of the buffer pool out.
  */
 class FileScan
 {
  public:
 
+  /**
+   * Opens its own handle on the relation, closed when the scan ends. If nothing
+   * else has the relation open then, the pool writes back and drops its pages.
+   */
   FileScan(const std::string &name, BufMgr *bufMgr);
 
+  /**
+   * Scans through a handle owned by the caller. The pages the scan read stay
+   * cached when it ends.
+   */
+  FileScan(PageFile *file, BufMgr *bufMgr);
+
   ~FileScan();
 
   //return RecordId of next record that satisfies the scan 
@@ -37,6 +50,17 @@ class FileScan
   //marks current page of scan dirty
   void markDirty();
 
+  /**
+   * Sets how many pages ahead of the current one the scan keeps loading in the
+   * background. 0 turns read-ahead off. Capped at half the scan's ring.
+   */
+  void setReadAhead(const std::uint32_t depth);
+
+  /**
+   * Number of pages read ahead by default
+   */
+  static const std::uint32_t DEFAULT_READ_AHEAD = 8;
+
  private:
   /**
    * File which is being scanned.
@@ -49,17 +73,38 @@ class FileScan
 	BufMgr				*bufMgr;
 
   /**
-   * Current page being scanned.
+   * Pin on the page being scanned, marked dirty by markDirty()
    */
-  Page*         curPage;
+  PageHandle    curPage;
 
   FileIterator  filePageIter;
   PageIterator  pageRecordIter;
 
   /**
-   * True if page has been updated
+   * Last page handed to the prefetcher, and how far it is ahead of filePageIter
+   */
+  FileIterator  aheadIter;
+  std::uint32_t pagesAhead;
+
+  /**
+   * Number of pages to keep loading ahead of the scan
+   */
+  std::uint32_t readAheadDepth;
+
+  /**
+   * Asks the buffer manager for the pages up to readAheadDepth past the current one.
+   */
+  void readAhead();
+
+  /**
+   * True if the scan opened file itself
+   */
+  bool          ownsFile;
+
+  /**
+   * Frames recycled by the scan
    */
-  bool  	      curDirtyFlag;
+  BufferRing    ring;
 };
 
 }
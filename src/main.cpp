@@ -5,6 +5,10 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <sstream>
 #include <vector>
 #include "btree.h"
 #include "page.h"
@@ -78,6 +82,9 @@ void test1();
 void test2();
 void test3();
 void errorTests();
+void readPagesTests();
+void writeListFormatFile(const int numPages);
+void pageDirectoryTests();
 void deleteRelation();
 
 int main(int argc, char **argv)
@@ -162,6 +169,12 @@ int main(int argc, char **argv)
 	// filescan goes out of scope here, so relation file gets closed.
 	File::remove(relationName);
 
+	readPagesTests();
+	std::cout << "@@@@@ READPAGES TEST PASSED!!! @@@@\n";
+
+	pageDirectoryTests();
+	std::cout << "@@@@@ PAGE DIRECTORY TEST PASSED!!! @@@@\n";
+
 	test1();
 	std::cout << "@@@@@ TEST 1 PASSED!!! @@@@\n";
 
@@ -661,6 +674,154 @@ int stringScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Oper
 	return numResults;
 }
 
+// -----------------------------------------------------------------------------
+// readPagesTests
+// -----------------------------------------------------------------------------
+
+void readPagesTests()
+{
+	std::cout << "readPages tests" << std::endl;
+	std::cout << "---------------" << std::endl;
+
+	const int numPages = 50;
+	{
+		PageFile new_file = PageFile::create(relationName);
+		for (int i = 0; i < numPages; ++i)
+		{
+			PageId new_page_number;
+			new_file.allocatePage(new_page_number);
+		}
+	}
+
+	// the File object goes away as soon as readPages returns; no prefetch may still use it
+	for (int round = 0; round < 20; round++)
+	{
+		PageFile* file = new PageFile(relationName, false);
+		std::vector<PageId> pageIds;
+		for (PageId pageNo = 1; pageNo <= (PageId) numPages; pageNo++)
+			pageIds.push_back(pageNo);
+		std::vector<Page*> pages;
+		bufMgr->readPages(file, pageIds, pages);
+
+		int pinned = 0;
+		for (std::size_t i = 0; i < pageIds.size(); i++)
+		{
+			if (pages[i] != NULL && pages[i]->page_number() == pageIds[i])
+				pinned++;
+			bufMgr->unPinPage(file, pageIds[i], false);
+		}
+		checkPassFail(pinned, numPages)
+		delete file;
+	}
+
+	File::remove(relationName);
+}
+
+// -----------------------------------------------------------------------------
+// pageDirectoryTests
+// -----------------------------------------------------------------------------
+
+/**
+ * Writes the relation the way PageFile did before page directories: the header, then
+ * numPages used pages linked in page number order, each holding one record with its
+ * number, and an empty free list.
+ */
+void writeListFormatFile(const int numPages)
+{
+	std::ofstream out(relationName.c_str(), std::ios::binary | std::ios::trunc);
+	const FileHeader header = {static_cast<PageId>(numPages + 1), 1 /* first_used_page */,
+	                           0 /* num_free_pages */, 0 /* first_free_page */};
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	for (int i = 1; i <= numPages; i++)
+	{
+		Page page;
+		std::ostringstream data;
+		data << "page " << i;
+		page.insertRecord(data.str());
+
+		char buffer[Page::SIZE];
+		std::memcpy(buffer, &page, Page::SIZE);
+		const PageId current = i;
+		const PageId next = i < numPages ? i + 1 : Page::INVALID_NUMBER;
+		std::memcpy(buffer + offsetof(PageHeader, current_page_number), &current, sizeof(current));
+		std::memcpy(buffer + offsetof(PageHeader, next_page_number), &next, sizeof(next));
+		out.write(buffer, Page::SIZE);
+	}
+}
+
+void pageDirectoryTests()
+{
+	std::cout << "Page directory tests" << std::endl;
+	std::cout << "--------------------" << std::endl;
+
+	// a file without a page directory gets one on its first allocation, and keeps its pages
+	const int numPages = 100;
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	writeListFormatFile(numPages);
+	PageId added;
+	{
+		PageFile file = PageFile::open(relationName);
+		file.allocatePage(added);
+		const bool appended = added > (PageId) numPages;
+		checkPassFail(appended, true)
+	}
+	{
+		PageFile file = PageFile::open(relationName);
+		int found = 0;
+		PageId expected = 1;
+		for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+		{
+			Page page = *iter;
+			std::ostringstream data;
+			data << "page " << expected;
+			if (page.page_number() == expected && (expected == added ||
+			    page.getRecord(RecordId{expected, 1}) == data.str()))
+				found++;
+			expected = expected == (PageId) numPages ? added : expected + 1;
+		}
+		checkPassFail(found, numPages + 1)
+	}
+
+	// deleted pages are handed out again, lowest first, also after the file is reopened
+	{
+		PageFile file = PageFile::open(relationName);
+		file.deletePage(40);
+		file.deletePage(7);
+	}
+	{
+		PageFile file = PageFile::open(relationName);
+		PageId reused;
+		file.allocatePage(reused);
+		checkPassFail(reused, 7)
+		file.allocatePage(reused);
+		checkPassFail(reused, 40)
+		file.allocatePage(reused);
+		const bool appended = reused > added;
+		checkPassFail(appended, true)
+		Page reusedPage = file.readPage(7);
+		const bool cleared = reusedPage.begin() == reusedPage.end();
+		checkPassFail(cleared, true)
+
+		int found = 0;
+		PageId last = 0;
+		for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+		{
+			if ((*iter).page_number() > last)
+				found++;
+			last = (*iter).page_number();
+		}
+		checkPassFail(found, numPages + 2)
+	}
+
+	File::remove(relationName);
+}
+
 // -----------------------------------------------------------------------------
 // errorTests
 // -----------------------------------------------------------------------------
@@ -0,0 +1,177 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "mapped_buffer.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/hash_not_found_exception.h"
+#include "exceptions/invalid_page_exception.h"
+#include "exceptions/page_not_pinned_exception.h"
+#include "exceptions/page_pinned_exception.h"
+#include "exceptions/read_only_page_exception.h"
+
+namespace badgerdb {
+
+MappedBufMgr::MappedBufMgr()
+{
+  bufStats.policyName = "mmap";
+}
+
+MappedBufMgr::~MappedBufMgr()
+{
+  for (std::unordered_map<const File*, Mapping>::iterator it = mappings.begin(); it != mappings.end(); ++it)
+  {
+    Mapping& m = it->second;
+    if (m.base != NULL)
+      munmap(m.base, m.length);
+    for (std::size_t i = 0; i < m.retired.size(); i++)
+      munmap(m.retired[i].first, m.retired[i].second);
+    close(m.fd);
+  }
+}
+
+void MappedBufMgr::readPage(File* file, const PageId pageNo, Page*& page)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  Mapping& m = mappingOf(file);
+  const std::size_t offset = file->pagePosition(pageNo);
+  if (pageNo != Page::INVALID_NUMBER && offset + Page::SIZE > m.length)
+  {
+    // the header of a grown file may only be cached by the File objects
+    file->flushHeader();
+    remap(m);
+  }
+  if (pageNo == Page::INVALID_NUMBER || offset + Page::SIZE > m.length)
+    throw InvalidPageException(pageNo, file->filename());
+
+  Page* mapped = reinterpret_cast<Page*>(m.base + offset);
+  // the header of a PageFile knows its page count; pages in between may have been deleted
+  if (m.pageFile &&
+      (pageNo >= reinterpret_cast<const FileHeader*>(m.base)->num_pages || mapped->page_number() == Page::INVALID_NUMBER))
+    throw InvalidPageException(pageNo, file->filename());
+
+  m.pins[pageNo]++;
+  bufStats.accesses++;
+  bufStats.hits++;
+  page = mapped;
+}
+
+void MappedBufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty)
+{
+  if (dirty)
+    throw ReadOnlyPageException(file->filename(), pageNo);
+
+  std::lock_guard<std::mutex> guard(latch);
+  std::unordered_map<const File*, Mapping>::iterator found = mappings.find(file);
+  if (found == mappings.end())
+    throw HashNotFoundException(file->filename(), pageNo);
+  std::unordered_map<PageId, std::uint32_t>& pins = found->second.pins;
+  std::unordered_map<PageId, std::uint32_t>::iterator pin = pins.find(pageNo);
+  if (pin == pins.end())
+    throw PageNotPinnedException(file->filename(), pageNo, 0);
+  if (--pin->second == 0)
+    pins.erase(pin);
+}
+
+void MappedBufMgr::advise(File* file, const MapAdvice advice)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  Mapping& m = mappingOf(file);
+  m.advice = advice;
+  applyAdvice(m);
+}
+
+void MappedBufMgr::prefetch(File* file, const std::vector<PageId>& pageIds)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  Mapping& m = mappingOf(file);
+  const std::size_t osPage = sysconf(_SC_PAGESIZE);
+  for (std::size_t i = 0; i < pageIds.size(); i++)
+  {
+    const std::size_t offset = file->pagePosition(pageIds[i]);
+    if (pageIds[i] == Page::INVALID_NUMBER || offset + Page::SIZE > m.length)
+      continue;
+    // madvise wants an address aligned to the page size of the operating system
+    const std::size_t start = offset - offset % osPage;
+    madvise(m.base + start, offset + Page::SIZE - start, MADV_WILLNEED);
+  }
+}
+
+void MappedBufMgr::flushFile(const File* file)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  std::unordered_map<const File*, Mapping>::iterator found = mappings.find(file);
+  if (found == mappings.end())
+    return;
+  Mapping& m = found->second;
+  if (!m.pins.empty())
+    throw PagePinnedException(file->filename(), m.pins.begin()->first, 0);
+
+  if (m.base != NULL)
+    munmap(m.base, m.length);
+  for (std::size_t i = 0; i < m.retired.size(); i++)
+    munmap(m.retired[i].first, m.retired[i].second);
+  close(m.fd);
+  mappings.erase(found);
+}
+
+MappedBufMgr::Mapping& MappedBufMgr::mappingOf(File* file)
+{
+  std::unordered_map<const File*, Mapping>::iterator found = mappings.find(file);
+  if (found != mappings.end())
+    return found->second;
+
+  // a descriptor of our own: the File object may use buffered or direct I/O
+  const int fd = open(file->filename().c_str(), O_RDONLY);
+  if (fd < 0)
+    throw FileNotFoundException(file->filename());
+  Mapping& m = mappings[file];
+  m.fd = fd;
+  m.base = NULL;
+  m.length = 0;
+  m.pageFile = dynamic_cast<PageFile*>(file) != NULL;
+  m.advice = MAP_ADVICE_NORMAL;
+  file->flushHeader();
+  remap(m);
+  return m;
+}
+
+void MappedBufMgr::remap(Mapping& m)
+{
+  struct stat st;
+  if (fstat(m.fd, &st) != 0 || (std::size_t) st.st_size <= m.length)
+    return;
+
+  void* base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, m.fd, 0);
+  if (base == MAP_FAILED)
+    throw std::bad_alloc();
+  if (m.base != NULL)
+  {
+    // pinned pages may point into the old mapping
+    if (m.pins.empty())
+      munmap(m.base, m.length);
+    else
+      m.retired.push_back(std::make_pair(m.base, m.length));
+  }
+  m.base = static_cast<char*>(base);
+  m.length = st.st_size;
+  applyAdvice(m);
+}
+
+void MappedBufMgr::applyAdvice(const Mapping& m)
+{
+  if (m.base == NULL)
+    return;
+  const int advice[] = { MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM };
+  madvise(m.base, m.length, advice[m.advice]);
+}
+
+}
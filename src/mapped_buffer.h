@@ -0,0 +1,197 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "buffer.h"
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief How a mapped file is going to be read, passed on to the kernel with madvise
+ */
+enum MapAdvice
+{
+	MAP_ADVICE_NORMAL = 0,	/* no hint; the kernel reads ahead moderately */
+	MAP_ADVICE_SEQUENTIAL = 1,	/* file scans: read ahead aggressively, drop pages behind */
+	MAP_ADVICE_RANDOM = 2	/* index probes: read only the pages touched */
+};
+
+/**
+* @brief Read-only buffer manager which maps files into memory instead of copying pages
+*
+* Offers the readPage/unPinPage calls of BufMgr for read-mostly replicas. Each file is mapped
+* read-only on first use and the Page* handed out points straight into the mapping, so a page
+* in the operating system's page cache is never copied, and memory is managed by the kernel
+* rather than by a replacement policy. Pins are only counted, to catch unbalanced unpins and
+* to refuse flushFile while pages are in use; they do not keep pages in memory.
+*
+* Pages cannot be modified: unpinning a page as dirty throws. Writes to the file through its
+* File object show up in the mapping. A file which grows is mapped again at its new length;
+* if pages of the old mapping are pinned it stays until flushFile, so they remain valid.
+*/
+class MappedBufMgr
+{
+ public:
+	/**
+	 * Constructor of MappedBufMgr class
+	 */
+	MappedBufMgr();
+
+	/**
+	 * Destructor of MappedBufMgr class; unmaps all files
+	 */
+	~MappedBufMgr();
+
+	/**
+	 * Reads the given page from the file through its mapping and pins it.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number inside the file to be read
+	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * @throws InvalidPageException If the page is past the end of the file, or a deleted page of a PageFile
+	 */
+	void readPage(File* file, const PageId pageNo, Page*& page);
+
+	/**
+	 * Unpins a page read with readPage.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number
+	 * @param dirty		Must be false, the mapping is read-only
+	 * @throws ReadOnlyPageException If dirty is true
+	 * @throws PageNotPinnedException If the page is not already pinned
+	 */
+	void unPinPage(File* file, const PageId pageNo, const bool dirty);
+
+	/**
+	 * Tells the kernel how a file will be read. Scans do best with MAP_ADVICE_SEQUENTIAL and
+	 * B+tree probes with MAP_ADVICE_RANDOM. The advice also applies when the file is mapped
+	 * again after growing.
+	 *
+	 * @param file  	File object
+	 * @param advice	Expected access pattern
+	 */
+	void advise(File* file, const MapAdvice advice);
+
+	/**
+	 * Asks the kernel to start reading pages which will be needed soon, without waiting.
+	 * Pages past the end of the file are ignored.
+	 *
+	 * @param file   	File object
+	 * @param pageIds	Page numbers in the file
+	 */
+	void prefetch(File* file, const std::vector<PageId>& pageIds);
+
+	/**
+	 * Unmaps a file, e.g. before it is closed. There is nothing to write back.
+	 *
+	 * @param file   	File object
+	 * @throws  PagePinnedException If some page of the file is pinned
+	 */
+	void flushFile(const File* file);
+
+	/**
+	 * Get buffer pool usage statistics. Every access is a hit: whether the kernel had to
+	 * read the page is not seen here.
+	 */
+	BufStats& getBufStats()
+	{
+		return bufStats;
+	}
+
+	/**
+	 * Clear buffer pool usage statistics
+	 */
+	void clearBufStats()
+	{
+		bufStats.clear();
+	}
+
+ private:
+	/**
+	 * A mapped file
+	 */
+	struct Mapping
+	{
+		/**
+		 * Read-only descriptor the file is mapped through
+		 */
+		int fd;
+
+		/**
+		 * Current mapping of the whole file, or NULL while the file is empty
+		 */
+		char* base;
+		std::size_t length;
+
+		/**
+		 * True for a PageFile, whose header tells which pages exist
+		 */
+		bool pageFile;
+
+		/**
+		 * Advice given for the file
+		 */
+		MapAdvice advice;
+
+		/**
+		 * Mappings replaced after the file grew, kept while pages in them may be in use
+		 */
+		std::vector<std::pair<char*, std::size_t> > retired;
+
+		/**
+		 * Pin count of every pinned page
+		 */
+		std::unordered_map<PageId, std::uint32_t> pins;
+	};
+
+	/**
+	 * Mapped files
+	 */
+	std::unordered_map<const File*, Mapping> mappings;
+
+	/**
+	 * Guards mappings
+	 */
+	std::mutex latch;
+
+	/**
+	 * Usage statistics
+	 */
+	BufStats bufStats;
+
+	/**
+	 * Returns the mapping of a file, mapping it first if needed. Caller holds latch.
+	 *
+	 * @param file	File object
+	 * @return  		The mapping
+	 */
+	Mapping& mappingOf(File* file);
+
+	/**
+	 * Maps the file again if it grew past the current mapping. Caller holds latch.
+	 *
+	 * @param m	Mapping of the file
+	 */
+	void remap(Mapping& m);
+
+	/**
+	 * Passes the advice of a mapping to the kernel.
+	 */
+	static void applyAdvice(const Mapping& m);
+};
+
+}
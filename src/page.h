@@ -344,5 +344,7 @@ static_assert(Page::SIZE > sizeof(PageHeader),
               "Page size must be large enough to hold header and data.");
 static_assert(Page::DATA_SIZE > 0,
               "Page must have some space to hold data.");
+static_assert(sizeof(Page) == Page::SIZE,
+              "Pages are read and written as a single block of SIZE bytes.");
 
 }
@@ -0,0 +1,615 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include "buffer.h"
+#include "replacement_policy.h"
+
+namespace badgerdb {
+
+ReplacementPolicy* ReplacementPolicy::create(const ReplacementPolicyType type, FrameStateTable* states, const FrameId base,
+                                             const std::uint32_t numBufs,
+                                             const std::uint32_t maxBufs)
+{
+  switch (type)
+  {
+    case GCLOCK:
+      return new GClockPolicy(states, base, numBufs, maxBufs);
+    case LRU_K:
+      return new LruKPolicy(states, base, numBufs);
+    case TWO_Q:
+      return new TwoQPolicy(states, base, numBufs);
+    case ARC:
+      return new ArcPolicy(states, base, numBufs);
+    case CLOCK:
+    default:
+      return new ClockPolicy(states, base, numBufs);
+  }
+}
+
+bool ReplacementPolicy::isPinned(const FrameId frame) const
+{
+  return states->pinCnt(base + frame).load() != 0;
+}
+
+bool ReplacementPolicy::isValid(const FrameId frame) const
+{
+  return states->isValid(base + frame);
+}
+
+bool ReplacementPolicy::isReferenced(const FrameId frame) const
+{
+  return states->isReferenced(base + frame);
+}
+
+void ReplacementPolicy::setRef(const FrameId frame)
+{
+  states->setRef(base + frame);
+}
+
+bool ReplacementPolicy::testAndClearRef(const FrameId frame)
+{
+  return states->testAndClearRef(base + frame);
+}
+
+//----------------------------------------
+// Clock
+//----------------------------------------
+
+ClockPolicy::ClockPolicy(FrameStateTable* states, const FrameId base, const std::uint32_t numBufs)
+  : ReplacementPolicy(states, base, numBufs), clockHand(numBufs - 1)
+{
+}
+
+void ClockPolicy::recordAccess(const FrameId frame)
+{
+  setRef(frame);
+}
+
+void ClockPolicy::recordLoad(const FrameId frame, const FileId file, const PageId pageNo)
+{
+  setRef(frame);
+}
+
+void ClockPolicy::recordEvict(const FrameId frame, const FileId file, const PageId pageNo)
+{
+}
+
+bool ClockPolicy::pickVictim(FrameId& frame, const ClaimFn& tryClaim, std::uint32_t& examined)
+{
+  std::uint32_t numScanned = 0;
+  while (numScanned < 2*numBufs)	//Need to scan twice
+  {
+    // the frames from the one after the hand to the end of its bitmap word or of the pool
+    const std::uint32_t bufs = numBufs;
+    FrameId hand = clockHand.load();
+    const FrameId next = (hand + 1) % bufs;
+    const std::uint32_t word = (base + next) / FrameStateTable::WORD_BITS;
+    const std::uint32_t shift = (base + next) % FrameStateTable::WORD_BITS;
+    const std::uint32_t span = std::min(FrameStateTable::WORD_BITS - shift, bufs - next);
+    const std::uint64_t range = FrameStateTable::bitRange(shift, span);
+
+    // valid and referenced frames get a second chance; the first of the others which
+    // nobody has pinned (or is claiming) is the candidate
+    const std::uint64_t secondChance = states->validWord(word) & states->refWord(word) & range;
+    std::uint64_t candidates = range & ~secondChance;
+    while (candidates != 0 &&
+           states->pinCnt(word * FrameStateTable::WORD_BITS + __builtin_ctzll(candidates)).load() != 0)
+      candidates &= candidates - 1;
+
+    // move the hand onto the candidate, or past the whole span; start over if another
+    // thread moved it first
+    const std::uint32_t steps = candidates != 0 ? __builtin_ctzll(candidates) - shift + 1 : span;
+    if (!clockHand.compare_exchange_weak(hand, hand + steps))
+      continue;
+    numScanned += steps;
+    examined += steps;
+
+    // clear the reference bits the hand passed over, pinned frames' included
+    const std::uint64_t passed = secondChance & FrameStateTable::bitRange(shift, steps);
+    if (passed != 0)
+      states->clearRefs(word, passed);
+
+    // claim the frame; fails if someone pinned it since we looked
+    if (candidates != 0 && tryClaim(next + steps - 1))
+    {
+      frame = next + steps - 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ClockPolicy::upcomingVictims(std::vector<FrameId>& frames, const std::size_t count)
+{
+  // the first sweep takes frames without a reference bit, the second the rest
+  const FrameId hand = clockHand.load();
+  for (int sweep = 0; sweep < 2; sweep++)
+  {
+    for (std::uint32_t i = 1; i <= numBufs && frames.size() < count; i++)
+    {
+      const FrameId frame = (hand + i) % numBufs;
+      if (isPinned(frame))
+        continue;
+      const bool referenced = isValid(frame) && isReferenced(frame);
+      if (referenced == (sweep == 1))
+        frames.push_back(frame);
+    }
+  }
+}
+
+//----------------------------------------
+// GCLOCK
+//----------------------------------------
+
+GClockPolicy::GClockPolicy(FrameStateTable* states, const FrameId base, const std::uint32_t numBufs, const std::uint32_t maxBufs)
+  : ReplacementPolicy(states, base, numBufs), clockHand(numBufs - 1)
+{
+  usage = new std::atomic<std::uint8_t>[maxBufs];
+  for (std::uint32_t i = 0; i < maxBufs; i++)
+    usage[i] = 0;
+}
+
+void GClockPolicy::resize(const std::uint32_t newNumBufs)
+{
+  // frames coming (back) into the pool start with no usage
+  for (std::uint32_t i = numBufs; i < newNumBufs; i++)
+    usage[i] = 0;
+  numBufs = newNumBufs;
+}
+
+GClockPolicy::~GClockPolicy()
+{
+  delete [] usage;
+}
+
+void GClockPolicy::recordAccess(const FrameId frame)
+{
+  std::uint8_t count = usage[frame].load();
+  while (count < MAX_USAGE && !usage[frame].compare_exchange_weak(count, count + 1))
+    ;
+}
+
+void GClockPolicy::recordLoad(const FrameId frame, const FileId file, const PageId pageNo)
+{
+  usage[frame] = 1;
+}
+
+void GClockPolicy::recordEvict(const FrameId frame, const FileId file, const PageId pageNo)
+{
+  usage[frame] = 0;
+}
+
+bool GClockPolicy::pickVictim(FrameId& frame, const ClaimFn& tryClaim, std::uint32_t& examined)
+{
+  // enough steps to wear a saturated count down to zero and come back to it
+  const std::uint32_t maxScan = (MAX_USAGE + 1) * numBufs + numBufs;
+  for (std::uint32_t numScanned = 0; numScanned < maxScan; numScanned++)
+  {
+    const FrameId hand = (clockHand.fetch_add(1) + 1) % numBufs;
+    examined++;
+
+    if (isPinned(hand))
+      continue;
+
+    if (isValid(hand))
+    {
+      std::uint8_t count = usage[hand].load();
+      if (count > 0)
+      {
+        usage[hand].compare_exchange_strong(count, count - 1);
+        continue;
+      }
+    }
+
+    if (tryClaim(hand))
+    {
+      frame = hand;
+      return true;
+    }
+  }
+  return false;
+}
+
+void GClockPolicy::upcomingVictims(std::vector<FrameId>& frames, const std::size_t count)
+{
+  // frames are reached in order of their usage count, then of their distance from the hand
+  const FrameId hand = clockHand.load();
+  for (std::uint8_t level = 0; level <= MAX_USAGE; level++)
+  {
+    for (std::uint32_t i = 1; i <= numBufs && frames.size() < count; i++)
+    {
+      const FrameId frame = (hand + i) % numBufs;
+      if (isPinned(frame))
+        continue;
+      const std::uint8_t uses = isValid(frame) ? usage[frame].load() : 0;
+      if (uses == level)
+        frames.push_back(frame);
+    }
+  }
+}
+
+//----------------------------------------
+// LRU-K
+//----------------------------------------
+
+LruKPolicy::LruKPolicy(FrameStateTable* states, const FrameId base, const std::uint32_t numBufs)
+  : ReplacementPolicy(states, base, numBufs), now(0), history(numBufs), keyOf(numBufs)
+{
+  for (FrameId i = 0; i < numBufs; i++)
+  {
+    for (int k = 0; k < K; k++)
+      history[i].times[k] = 0;
+    keyOf[i] = OrderKey(std::make_pair(0, 0), i);
+    order.insert(keyOf[i]);
+  }
+}
+
+void LruKPolicy::reorder(const FrameId frame)
+{
+  order.erase(keyOf[frame]);
+  keyOf[frame] = OrderKey(std::make_pair(history[frame].times[K - 1], history[frame].times[0]), frame);
+  order.insert(keyOf[frame]);
+}
+
+void LruKPolicy::recordAccess(const FrameId frame)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  History& h = history[frame];
+  for (int k = K - 1; k > 0; k--)
+    h.times[k] = h.times[k - 1];
+  h.times[0] = ++now;
+  reorder(frame);
+}
+
+void LruKPolicy::recordLoad(const FrameId frame, const FileId file, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  History& h = history[frame];
+  PageKey key = { file, pageNo };
+
+  // a page evicted a short while ago keeps its earlier references
+  std::unordered_map<PageKey, std::pair<History, std::uint64_t>, PageKeyHash>::iterator it = retained.find(key);
+  if (it != retained.end())
+  {
+    h = it->second.first;
+    retained.erase(it);
+  }
+  else
+  {
+    for (int k = 0; k < K; k++)
+      h.times[k] = 0;
+  }
+
+  for (int k = K - 1; k > 0; k--)
+    h.times[k] = h.times[k - 1];
+  h.times[0] = ++now;
+  reorder(frame);
+}
+
+void LruKPolicy::recordEvict(const FrameId frame, const FileId file, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  PageKey key = { file, pageNo };
+
+  std::uint64_t seq = ++now;
+  retained[key] = std::make_pair(history[frame], seq);
+  retainedOrder.push_back(std::make_pair(key, seq));
+  while (retainedOrder.size() > numBufs)
+  {
+    // only drop the entry if it was not re-retained since
+    std::unordered_map<PageKey, std::pair<History, std::uint64_t>, PageKeyHash>::iterator it = retained.find(retainedOrder.front().first);
+    if (it != retained.end() && it->second.second == retainedOrder.front().second)
+      retained.erase(it);
+    retainedOrder.pop_front();
+  }
+
+  // free frames sort first
+  for (int k = 0; k < K; k++)
+    history[frame].times[k] = 0;
+  reorder(frame);
+}
+
+void LruKPolicy::resize(const std::uint32_t newNumBufs)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for (FrameId i = newNumBufs; i < numBufs; i++)
+    order.erase(keyOf[i]);
+  history.resize(newNumBufs);
+  keyOf.resize(newNumBufs);
+  for (FrameId i = numBufs; i < newNumBufs; i++)
+  {
+    for (int k = 0; k < K; k++)
+      history[i].times[k] = 0;
+    keyOf[i] = OrderKey(std::make_pair(0, 0), i);
+    order.insert(keyOf[i]);
+  }
+  numBufs = newNumBufs;
+}
+
+bool LruKPolicy::pickVictim(FrameId& frame, const ClaimFn& tryClaim, std::uint32_t& examined)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for (std::set<OrderKey>::iterator it = order.begin(); it != order.end(); ++it)
+  {
+    examined++;
+    if (!isPinned(it->second) && tryClaim(it->second))
+    {
+      frame = it->second;
+      return true;
+    }
+  }
+  return false;
+}
+
+void LruKPolicy::upcomingVictims(std::vector<FrameId>& frames, const std::size_t count)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for (std::set<OrderKey>::iterator it = order.begin(); it != order.end() && frames.size() < count; ++it)
+  {
+    if (!isPinned(it->second))
+      frames.push_back(it->second);
+  }
+}
+
+//----------------------------------------
+// List based policies
+//----------------------------------------
+
+ListPolicy::ListPolicy(FrameStateTable* states, const FrameId base, const std::uint32_t numBufs, const int numLists)
+  : ReplacementPolicy(states, base, numBufs), lists(numLists), listOf(numBufs), position(numBufs)
+{
+  // every frame starts out free
+  for (FrameId i = 0; i < numBufs; i++)
+  {
+    listOf[i] = 0;
+    position[i] = lists[0].insert(lists[0].end(), i);
+  }
+}
+
+void ListPolicy::resize(const std::uint32_t newNumBufs)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for (FrameId i = newNumBufs; i < numBufs; i++)
+    lists[listOf[i]].erase(position[i]);
+  listOf.resize(newNumBufs);
+  position.resize(newNumBufs);
+  for (FrameId i = numBufs; i < newNumBufs; i++)
+  {
+    listOf[i] = 0;
+    position[i] = lists[0].insert(lists[0].end(), i);
+  }
+  numBufs = newNumBufs;
+  resized();
+}
+
+void ListPolicy::moveTo(const FrameId frame, const int list)
+{
+  lists[list].splice(lists[list].end(), lists[listOf[frame]], position[frame]);
+  listOf[frame] = list;
+}
+
+bool ListPolicy::claimFrom(const int list, FrameId& frame, const ClaimFn& tryClaim, std::uint32_t& examined)
+{
+  for (std::list<FrameId>::iterator it = lists[list].begin(); it != lists[list].end(); ++it)
+  {
+    examined++;
+    if (!isPinned(*it) && tryClaim(*it))
+    {
+      frame = *it;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ListPolicy::listFrom(const int list, std::vector<FrameId>& frames, const std::size_t count) const
+{
+  for (std::list<FrameId>::const_iterator it = lists[list].begin(); it != lists[list].end() && frames.size() < count; ++it)
+  {
+    if (!isPinned(*it))
+      frames.push_back(*it);
+  }
+}
+
+void ListPolicy::addGhost(const int ghost, const PageKey& key, const std::size_t limit)
+{
+  removeGhost(ghost, key);
+  ghostIndex[ghost][key] = ghosts[ghost].insert(ghosts[ghost].end(), key);
+  while (ghosts[ghost].size() > limit)
+    trimGhost(ghost);
+}
+
+bool ListPolicy::removeGhost(const int ghost, const PageKey& key)
+{
+  std::unordered_map<PageKey, std::list<PageKey>::iterator, PageKeyHash>::iterator it = ghostIndex[ghost].find(key);
+  if (it == ghostIndex[ghost].end())
+    return false;
+  ghosts[ghost].erase(it->second);
+  ghostIndex[ghost].erase(it);
+  return true;
+}
+
+void ListPolicy::trimGhost(const int ghost)
+{
+  if (ghosts[ghost].empty())
+    return;
+  ghostIndex[ghost].erase(ghosts[ghost].front());
+  ghosts[ghost].pop_front();
+}
+
+//----------------------------------------
+// 2Q
+//----------------------------------------
+
+TwoQPolicy::TwoQPolicy(FrameStateTable* states, const FrameId base, const std::uint32_t numBufs)
+  : ListPolicy(states, base, numBufs, 3)
+{
+  resized();
+}
+
+void TwoQPolicy::resized()
+{
+  kin = numBufs / 4 > 0 ? numBufs / 4 : 1;
+  kout = numBufs / 2 > 0 ? numBufs / 2 : 1;
+  while (ghosts[0].size() > kout)
+    trimGhost(0);
+}
+
+void TwoQPolicy::recordAccess(const FrameId frame)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  // re-references inside A1in are correlated and don't promote the page
+  if (listOf[frame] == AM)
+    moveTo(frame, AM);
+}
+
+void TwoQPolicy::recordLoad(const FrameId frame, const FileId file, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  PageKey key = { file, pageNo };
+  if (removeGhost(0, key))
+    moveTo(frame, AM);
+  else
+    moveTo(frame, A1IN);
+}
+
+void TwoQPolicy::recordEvict(const FrameId frame, const FileId file, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (listOf[frame] == A1IN)
+  {
+    PageKey key = { file, pageNo };
+    addGhost(0, key, kout);
+  }
+  moveTo(frame, FREE);
+}
+
+bool TwoQPolicy::pickVictim(FrameId& frame, const ClaimFn& tryClaim, std::uint32_t& examined)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (claimFrom(FREE, frame, tryClaim, examined))
+    return true;
+  if (lists[A1IN].size() > kin)
+    return claimFrom(A1IN, frame, tryClaim, examined) || claimFrom(AM, frame, tryClaim, examined);
+  return claimFrom(AM, frame, tryClaim, examined) || claimFrom(A1IN, frame, tryClaim, examined);
+}
+
+void TwoQPolicy::upcomingVictims(std::vector<FrameId>& frames, const std::size_t count)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  listFrom(FREE, frames, count);
+  if (lists[A1IN].size() > kin)
+  {
+    listFrom(A1IN, frames, count);
+    listFrom(AM, frames, count);
+  }
+  else
+  {
+    listFrom(AM, frames, count);
+    listFrom(A1IN, frames, count);
+  }
+}
+
+//----------------------------------------
+// ARC
+//----------------------------------------
+
+ArcPolicy::ArcPolicy(FrameStateTable* states, const FrameId base, const std::uint32_t numBufs)
+  : ListPolicy(states, base, numBufs, 3), p(0)
+{
+}
+
+void ArcPolicy::resized()
+{
+  if (p > numBufs)
+    p = numBufs;
+  trimGhosts();
+}
+
+void ArcPolicy::trimGhosts()
+{
+  while (!ghosts[B1].empty() && lists[T1].size() + ghosts[B1].size() > numBufs)
+    trimGhost(B1);
+  while (!ghosts[B2].empty() &&
+         lists[T1].size() + lists[T2].size() + ghosts[B1].size() + ghosts[B2].size() > 2 * numBufs)
+    trimGhost(B2);
+}
+
+void ArcPolicy::recordAccess(const FrameId frame)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (listOf[frame] != FREE)
+    moveTo(frame, T2);
+}
+
+void ArcPolicy::recordLoad(const FrameId frame, const FileId file, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  PageKey key = { file, pageNo };
+
+  if (ghostIndex[B1].count(key))
+  {
+    // recently evicted from the recency side: grow its target
+    std::size_t delta = ghosts[B1].size() >= ghosts[B2].size() ? 1 : ghosts[B2].size() / ghosts[B1].size();
+    p = p + delta < numBufs ? p + delta : (std::size_t) numBufs;
+    removeGhost(B1, key);
+    moveTo(frame, T2);
+  }
+  else if (ghostIndex[B2].count(key))
+  {
+    std::size_t delta = ghosts[B2].size() >= ghosts[B1].size() ? 1 : ghosts[B1].size() / ghosts[B2].size();
+    p = p > delta ? p - delta : 0;
+    removeGhost(B2, key);
+    moveTo(frame, T2);
+  }
+  else
+  {
+    moveTo(frame, T1);
+  }
+  trimGhosts();
+}
+
+void ArcPolicy::recordEvict(const FrameId frame, const FileId file, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  PageKey key = { file, pageNo };
+  if (listOf[frame] == T1)
+    addGhost(B1, key, numBufs);
+  else if (listOf[frame] == T2)
+    addGhost(B2, key, numBufs);
+  moveTo(frame, FREE);
+  trimGhosts();
+}
+
+bool ArcPolicy::pickVictim(FrameId& frame, const ClaimFn& tryClaim, std::uint32_t& examined)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (claimFrom(FREE, frame, tryClaim, examined))
+    return true;
+  if (!lists[T1].empty() && (lists[T1].size() > p || lists[T2].empty()))
+    return claimFrom(T1, frame, tryClaim, examined) || claimFrom(T2, frame, tryClaim, examined);
+  return claimFrom(T2, frame, tryClaim, examined) || claimFrom(T1, frame, tryClaim, examined);
+}
+
+void ArcPolicy::upcomingVictims(std::vector<FrameId>& frames, const std::size_t count)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  listFrom(FREE, frames, count);
+  if (!lists[T1].empty() && (lists[T1].size() > p || lists[T2].empty()))
+  {
+    listFrom(T1, frames, count);
+    listFrom(T2, frames, count);
+  }
+  else
+  {
+    listFrom(T2, frames, count);
+    listFrom(T1, frames, count);
+  }
+}
+
+}
@@ -0,0 +1,449 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "file.h"
+#include "types.h"
+
+namespace badgerdb {
+
+class FrameStateTable;
+
+/**
+ * @brief Page replacement algorithms the buffer manager can be constructed with.
+ */
+enum ReplacementPolicyType
+{
+	CLOCK = 0,	/* single reference bit second-chance clock */
+	GCLOCK = 1,	/* clock with saturating usage counts */
+	LRU_K = 2,	/* LRU-2: evict the page with the oldest second-to-last reference */
+	TWO_Q = 3,	/* 2Q: FIFO probation queue, LRU main queue and a ghost queue */
+	ARC = 4		/* Adaptive Replacement Cache */
+};
+
+/**
+ * @brief Identity of a page, used by policies that remember pages after they leave the pool.
+ */
+struct PageKey
+{
+	FileId file;
+	PageId pageNo;
+
+	bool operator==(const PageKey& rhs) const
+	{
+		return file == rhs.file && pageNo == rhs.pageNo;
+	}
+};
+
+/**
+ * @brief Hash functor for PageKey.
+ */
+struct PageKeyHash
+{
+	std::size_t operator()(const PageKey& key) const
+	{
+		std::uint64_t h = (std::uint64_t) key.file * 0x9e3779b97f4a7c15ULL;
+		return (std::size_t) (h ^ (key.pageNo * 0xc2b2ae3d27d4eb4fULL));
+	}
+};
+
+/**
+ * @brief Interface between BufMgr and a page replacement algorithm.
+ *
+ * BufMgr reports every hit, load and eviction, and asks the policy for a victim when it
+ * needs a frame. The policy offers candidates in its preferred order through the tryClaim
+ * callback, which atomically claims a frame if nobody has it pinned, and stops at the first
+ * one that succeeds. tryClaim never blocks and never calls back into the policy, so
+ * policies may call it while holding their own latch. Writing back a dirty victim happens
+ * afterwards in BufMgr, outside the policy.
+ *
+ * Frames that hold no page are preferred over any resident page.
+ */
+class ReplacementPolicy
+{
+ public:
+	/**
+	 * Callback claiming a frame for eviction; returns false if the frame is pinned.
+	 */
+	typedef std::function<bool(FrameId)> ClaimFn;
+
+	/**
+	 * Creates the policy of the given type.
+	 *
+	 * @param type   	Which algorithm to use
+	 * @param states 	Eviction state of the buffer pool
+	 * @param base   	Frame number in the pool of the policy's frame 0
+	 * @param numBufs	Number of frames in the buffer pool
+	 * @param maxBufs	Most frames the pool can be resized to
+	 * @return  			Newly allocated policy, owned by the caller.
+	 */
+	static ReplacementPolicy* create(const ReplacementPolicyType type, FrameStateTable* states, const FrameId base,
+	                                 const std::uint32_t numBufs,
+	                                 const std::uint32_t maxBufs);
+
+	virtual ~ReplacementPolicy() {}
+
+	/**
+	 * Short name of the algorithm, used in statistics.
+	 */
+	virtual const char* name() const = 0;
+
+	/**
+	 * A resident page was pinned again.
+	 *
+	 * @param frame	Frame holding the page
+	 */
+	virtual void recordAccess(const FrameId frame) = 0;
+
+	/**
+	 * A page was brought into a frame.
+	 *
+	 * @param frame  	Frame now holding the page
+	 * @param file   	Id of the file of the page
+	 * @param pageNo 	Page number in the file
+	 */
+	virtual void recordLoad(const FrameId frame, const FileId file, const PageId pageNo) = 0;
+
+	/**
+	 * A page left its frame (evicted, flushed or disposed); the frame is free.
+	 *
+	 * @param frame  	Frame which held the page
+	 * @param file   	Id of the file of the page
+	 * @param pageNo 	Page number in the file
+	 */
+	virtual void recordEvict(const FrameId frame, const FileId file, const PageId pageNo) = 0;
+
+	/**
+	 * Chooses and claims a victim frame.
+	 *
+	 * @param frame   	The claimed frame is returned via this reference
+	 * @param tryClaim	Callback claiming a candidate frame
+	 * @param examined	Number of frames looked at (the sweep length) is added to this
+	 * @return  				False if every candidate was pinned.
+	 */
+	virtual bool pickVictim(FrameId& frame, const ClaimFn& tryClaim, std::uint32_t& examined) = 0;
+
+	/**
+	 * Lists the unpinned frames the policy would evict next, most likely victim first,
+	 * without claiming them or disturbing the policy state. Used by the background writer
+	 * to clean dirty pages before eviction reaches them.
+	 *
+	 * @param frames	Receives at most count frames
+	 * @param count 	How many frames to look ahead
+	 */
+	virtual void upcomingVictims(std::vector<FrameId>& frames, const std::size_t count) = 0;
+
+	/**
+	 * The pool was resized. New frames are free; when shrinking, the frames at and above
+	 * newNumBufs have been emptied and stay pinned, so a concurrent pickVictim may still
+	 * offer one but can never claim it.
+	 *
+	 * @param newNumBufs	Number of frames from now on
+	 */
+	virtual void resize(const std::uint32_t newNumBufs)
+	{
+		numBufs = newNumBufs;
+	}
+
+ protected:
+	ReplacementPolicy(FrameStateTable* statesIn, const FrameId baseIn, const std::uint32_t numBufsIn)
+		: states(statesIn), base(baseIn), numBufs(numBufsIn)
+	{
+	}
+
+	/**
+	 * True if the frame is pinned or being claimed.
+	 */
+	bool isPinned(const FrameId frame) const;
+
+	/**
+	 * True if the frame holds a page.
+	 */
+	bool isValid(const FrameId frame) const;
+
+	/**
+	 * True if the reference bit of the frame is set.
+	 */
+	bool isReferenced(const FrameId frame) const;
+
+	/**
+	 * Sets the reference bit of the frame.
+	 */
+	void setRef(const FrameId frame);
+
+	/**
+	 * Clears the reference bit of the frame, returning its previous value.
+	 */
+	bool testAndClearRef(const FrameId frame);
+
+	/**
+	 * Eviction state of the buffer pool
+	 */
+	FrameStateTable* states;
+
+	/**
+	 * Frame number in the pool of frame 0 of the policy
+	 */
+	FrameId base;
+
+	/**
+	 * Number of frames in the buffer pool; changes when the pool is resized
+	 */
+	std::atomic<std::uint32_t> numBufs;
+};
+
+/**
+ * @brief The classic second-chance clock, sweeping the reference bits without locks.
+ *
+ * The hand moves over a bitmap word at a time: one AND of the valid and reference bits
+ * shows which of up to 64 frames get their second chance, the hand stops at the first
+ * other frame which is not pinned, and the reference bits of the frames it passed are
+ * cleared with one atomic operation.
+ */
+class ClockPolicy : public ReplacementPolicy
+{
+ public:
+	ClockPolicy(FrameStateTable* states, const FrameId base, const std::uint32_t numBufs);
+
+	const char* name() const { return "clock"; }
+	void recordAccess(const FrameId frame);
+	void recordLoad(const FrameId frame, const FileId file, const PageId pageNo);
+	void recordEvict(const FrameId frame, const FileId file, const PageId pageNo);
+	bool pickVictim(FrameId& frame, const ClaimFn& tryClaim, std::uint32_t& examined);
+	void upcomingVictims(std::vector<FrameId>& frames, const std::size_t count);
+
+ private:
+	/**
+	 * Current position of clockhand in our buffer pool. Only ever incremented; taken modulo numBufs.
+	 */
+	std::atomic<FrameId> clockHand;
+};
+
+/**
+ * @brief Generalized clock: each frame carries a usage count, raised on every access and
+ * lowered by each pass of the hand, so frequently used pages survive several sweeps.
+ */
+class GClockPolicy : public ReplacementPolicy
+{
+ public:
+	/**
+	 * Maximum usage count a frame can accumulate
+	 */
+	static const std::uint8_t MAX_USAGE = 5;
+
+	GClockPolicy(FrameStateTable* states, const FrameId base, const std::uint32_t numBufs, const std::uint32_t maxBufs);
+	~GClockPolicy();
+
+	const char* name() const { return "gclock"; }
+	void recordAccess(const FrameId frame);
+	void recordLoad(const FrameId frame, const FileId file, const PageId pageNo);
+	void recordEvict(const FrameId frame, const FileId file, const PageId pageNo);
+	bool pickVictim(FrameId& frame, const ClaimFn& tryClaim, std::uint32_t& examined);
+	void upcomingVictims(std::vector<FrameId>& frames, const std::size_t count);
+	void resize(const std::uint32_t newNumBufs);
+
+ private:
+	std::atomic<FrameId> clockHand;
+
+	/**
+	 * Usage count of every frame, allocated for the largest size the pool can grow to
+	 */
+	std::atomic<std::uint8_t>* usage;
+};
+
+/**
+ * @brief LRU-K with K = 2: evicts the page whose second most recent reference is oldest.
+ * Pages referenced only once go first, in LRU order. The history of evicted pages is kept
+ * for a while, so a page that comes back soon is not treated as new.
+ */
+class LruKPolicy : public ReplacementPolicy
+{
+ public:
+	static const int K = 2;
+
+	LruKPolicy(FrameStateTable* states, const FrameId base, const std::uint32_t numBufs);
+
+	const char* name() const { return "lru-2"; }
+	void recordAccess(const FrameId frame);
+	void recordLoad(const FrameId frame, const FileId file, const PageId pageNo);
+	void recordEvict(const FrameId frame, const FileId file, const PageId pageNo);
+	bool pickVictim(FrameId& frame, const ClaimFn& tryClaim, std::uint32_t& examined);
+	void upcomingVictims(std::vector<FrameId>& frames, const std::size_t count);
+	void resize(const std::uint32_t newNumBufs);
+
+ private:
+	/**
+	 * Reference times of a page, most recent first; 0 means no reference
+	 */
+	struct History
+	{
+		std::uint64_t times[K];
+	};
+
+	/**
+	 * Eviction order key: (K-th most recent reference, most recent reference, frame)
+	 */
+	typedef std::pair<std::pair<std::uint64_t, std::uint64_t>, FrameId> OrderKey;
+
+	void reorder(const FrameId frame);
+
+	std::mutex mutex;
+	std::uint64_t now;
+	std::vector<History> history;
+	std::vector<OrderKey> keyOf;
+	std::set<OrderKey> order;
+
+	/**
+	 * History of recently evicted pages, bounded to numBufs entries in FIFO order
+	 */
+	std::unordered_map<PageKey, std::pair<History, std::uint64_t>, PageKeyHash> retained;
+	std::list<std::pair<PageKey, std::uint64_t> > retainedOrder;
+};
+
+/**
+ * @brief Shared bookkeeping for policies built from lists of frames (2Q and ARC).
+ */
+class ListPolicy : public ReplacementPolicy
+{
+ public:
+	/**
+	 * New frames join the free list; removed frames leave whichever list they are on.
+	 */
+	void resize(const std::uint32_t newNumBufs);
+
+ protected:
+	ListPolicy(FrameStateTable* states, const FrameId base, const std::uint32_t numBufs, const int numLists);
+
+	/**
+	 * Called by resize() with the latch held, for subclasses to adapt their targets.
+	 */
+	virtual void resized() {}
+
+	/**
+	 * Moves a frame to the back (most recent end) of a list.
+	 */
+	void moveTo(const FrameId frame, const int list);
+
+	/**
+	 * Offers the frames of a list, oldest first, to tryClaim.
+	 */
+	bool claimFrom(const int list, FrameId& frame, const ClaimFn& tryClaim, std::uint32_t& examined);
+
+	/**
+	 * Appends the unpinned frames of a list, oldest first, until frames holds count entries.
+	 */
+	void listFrom(const int list, std::vector<FrameId>& frames, const std::size_t count) const;
+
+	/**
+	 * Remembers a page in a ghost list, dropping the oldest ghost beyond limit.
+	 */
+	void addGhost(const int ghost, const PageKey& key, const std::size_t limit);
+
+	/**
+	 * Removes a page from a ghost list; returns false if it was not there.
+	 */
+	bool removeGhost(const int ghost, const PageKey& key);
+
+	/**
+	 * Drops the oldest ghost of a list.
+	 */
+	void trimGhost(const int ghost);
+
+	std::mutex mutex;
+
+	/**
+	 * Resident lists of frames; list 0 holds the free frames
+	 */
+	std::vector<std::list<FrameId> > lists;
+
+	/**
+	 * Which list each frame is on, and where
+	 */
+	std::vector<int> listOf;
+	std::vector<std::list<FrameId>::iterator> position;
+
+	/**
+	 * Ghost lists of pages no longer resident, oldest first, with their index
+	 */
+	std::list<PageKey> ghosts[2];
+	std::unordered_map<PageKey, std::list<PageKey>::iterator, PageKeyHash> ghostIndex[2];
+};
+
+/**
+ * @brief 2Q: first-time pages enter a FIFO probation queue (A1in). Pages evicted from it
+ * are remembered in a ghost queue (A1out); only a page re-read while still remembered is
+ * admitted to the LRU main queue (Am). A single sweep can therefore never flush Am.
+ */
+class TwoQPolicy : public ListPolicy
+{
+ public:
+	TwoQPolicy(FrameStateTable* states, const FrameId base, const std::uint32_t numBufs);
+
+	const char* name() const { return "2q"; }
+	void recordAccess(const FrameId frame);
+	void recordLoad(const FrameId frame, const FileId file, const PageId pageNo);
+	void recordEvict(const FrameId frame, const FileId file, const PageId pageNo);
+	bool pickVictim(FrameId& frame, const ClaimFn& tryClaim, std::uint32_t& examined);
+	void upcomingVictims(std::vector<FrameId>& frames, const std::size_t count);
+
+ protected:
+	void resized();
+
+ private:
+	enum { FREE = 0, A1IN = 1, AM = 2 };
+
+	/**
+	 * Target size of A1in (a quarter of the pool) and of A1out (half of the pool)
+	 */
+	std::size_t kin, kout;
+};
+
+/**
+ * @brief ARC: balances a recency list (T1) against a frequency list (T2), adapting the
+ * target size of T1 from hits in the ghost lists of pages recently evicted from each.
+ */
+class ArcPolicy : public ListPolicy
+{
+ public:
+	ArcPolicy(FrameStateTable* states, const FrameId base, const std::uint32_t numBufs);
+
+	const char* name() const { return "arc"; }
+	void recordAccess(const FrameId frame);
+	void recordLoad(const FrameId frame, const FileId file, const PageId pageNo);
+	void recordEvict(const FrameId frame, const FileId file, const PageId pageNo);
+	bool pickVictim(FrameId& frame, const ClaimFn& tryClaim, std::uint32_t& examined);
+	void upcomingVictims(std::vector<FrameId>& frames, const std::size_t count);
+
+ protected:
+	void resized();
+
+ private:
+	enum { FREE = 0, T1 = 1, T2 = 2 };
+	enum { B1 = 0, B2 = 1 };
+
+	/**
+	 * Keeps |T1| + |B1| <= c and the whole directory within 2c.
+	 */
+	void trimGhosts();
+
+	/**
+	 * Target size of T1
+	 */
+	std::size_t p;
+};
+
+}
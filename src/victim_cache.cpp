@@ -0,0 +1,291 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstring>
+#include "victim_cache.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Encoding of the codec. A token byte below 0x80 starts a run of (token + 1) literal bytes.
+ * From 0x80 up to 0xfe it is a match of (token - 0x80 + MIN_MATCH) bytes, and 0xff is a
+ * match whose length follows in two bytes. Either match token is followed by the distance
+ * back to the matched bytes in two bytes. Two byte numbers are stored low byte first.
+ */
+const std::size_t MIN_MATCH = 4;
+const std::size_t MAX_SHORT_MATCH = 0x7e + MIN_MATCH;
+const std::size_t MAX_LITERALS = 0x80;
+const std::size_t MAX_DISTANCE = 0xffff;
+
+/**
+ * Slots of the table remembering where each four byte sequence was last seen
+ */
+const int HASH_BITS = 12;
+
+std::uint32_t hashAt(const unsigned char* p)
+{
+  std::uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/**
+ * Number of equal bytes at a and b, comparing at most limit bytes, eight at a time
+ */
+std::size_t matchLength(const unsigned char* a, const unsigned char* b, const std::size_t limit)
+{
+  std::size_t length = 0;
+  while (length + sizeof(std::uint64_t) <= limit)
+  {
+    std::uint64_t x, y;
+    std::memcpy(&x, a + length, sizeof(x));
+    std::memcpy(&y, b + length, sizeof(y));
+    if (x != y)
+      return length + __builtin_ctzll(x ^ y) / 8;
+    length += sizeof(x);
+  }
+  while (length < limit && a[length] == b[length])
+    length++;
+  return length;
+}
+
+void putShort(const std::size_t value, std::string& out)
+{
+  out.push_back((char) (value & 0xff));
+  out.push_back((char) (value >> 8));
+}
+
+/**
+ * Appends literals, in runs of at most MAX_LITERALS bytes.
+ */
+void putLiterals(const unsigned char* from, std::size_t count, std::string& out)
+{
+  while (count > 0)
+  {
+    const std::size_t run = count < MAX_LITERALS ? count : MAX_LITERALS;
+    out.push_back((char) (run - 1));
+    out.append((const char*) from, run);
+    from += run;
+    count -= run;
+  }
+}
+
+}
+
+const std::size_t VictimCache::MAX_STORED_SIZE;
+const std::size_t VictimCache::ENTRY_OVERHEAD;
+
+VictimCache::VictimCache()
+	: budget(0), used(0)
+{
+}
+
+bool VictimCache::compress(const Page& page, std::string& out)
+{
+  const unsigned char* src = (const unsigned char*) &page;
+  const std::size_t n = Page::SIZE;
+  int seen[1 << HASH_BITS];
+  for (int i = 0; i < (1 << HASH_BITS); i++)
+    seen[i] = -1;
+
+  out.clear();
+  std::size_t literalStart = 0;
+  std::size_t i = 0;
+  while (i + MIN_MATCH <= n)
+  {
+    const std::uint32_t h = hashAt(src + i);
+    const int candidate = seen[h];
+    seen[h] = (int) i;
+    if (candidate < 0 || i - (std::size_t) candidate > MAX_DISTANCE ||
+        std::memcmp(src + candidate, src + i, MIN_MATCH) != 0)
+    {
+      // the longer no match turns up, the bigger the steps through the literals
+      i += 1 + ((i - literalStart) >> 5);
+      continue;
+    }
+
+    const std::size_t length = MIN_MATCH +
+        matchLength(src + candidate + MIN_MATCH, src + i + MIN_MATCH, n - i - MIN_MATCH);
+    putLiterals(src + literalStart, i - literalStart, out);
+    if (length <= MAX_SHORT_MATCH)
+      out.push_back((char) (0x80 + length - MIN_MATCH));
+    else
+    {
+      out.push_back((char) 0xff);
+      putShort(length, out);
+    }
+    putShort(i - candidate, out);
+    i += length;
+    literalStart = i;
+    if (out.size() > MAX_STORED_SIZE)
+      return false;
+  }
+  putLiterals(src + literalStart, n - literalStart, out);
+  return out.size() <= MAX_STORED_SIZE;
+}
+
+bool VictimCache::decompress(const std::string& in, Page& page)
+{
+  unsigned char* dst = (unsigned char*) &page;
+  const unsigned char* src = (const unsigned char*) in.data();
+  const std::size_t n = Page::SIZE;
+  std::size_t pos = 0;
+  std::size_t i = 0;
+  while (i < in.size())
+  {
+    const std::size_t token = src[i++];
+    if (token < 0x80)
+    {
+      const std::size_t run = token + 1;
+      if (i + run > in.size() || pos + run > n)
+        return false;
+      std::memcpy(dst + pos, src + i, run);
+      i += run;
+      pos += run;
+      continue;
+    }
+
+    std::size_t length = token - 0x80 + MIN_MATCH;
+    if (token == 0xff)
+    {
+      if (i + 2 > in.size())
+        return false;
+      length = src[i] | ((std::size_t) src[i + 1] << 8);
+      i += 2;
+    }
+    if (i + 2 > in.size())
+      return false;
+    const std::size_t distance = src[i] | ((std::size_t) src[i + 1] << 8);
+    i += 2;
+    if (distance == 0 || distance > pos || pos + length > n)
+      return false;
+
+    // a match may overlap the bytes it produces, as in a run of zeros. What has been copied
+    // repeats with the period distance, so every copy can reach back twice as far.
+    std::size_t step = distance;
+    for (std::size_t done = 0; done < length; )
+    {
+      const std::size_t chunk = step < length - done ? step : length - done;
+      std::memcpy(dst + pos + done, dst + pos + done - step, chunk);
+      done += chunk;
+      step = done + distance;
+    }
+    pos += length;
+  }
+  return pos == n;
+}
+
+void VictimCache::setBudget(const std::size_t bytes)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  budget = bytes;
+  trim();
+}
+
+void VictimCache::put(const FileId file, const PageId pageNo, std::string& compressed)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  if (budget.load() == 0)
+    return;
+
+  std::unordered_map<PageId, std::list<Entry>::iterator>& filePages = index[file];
+  std::unordered_map<PageId, std::list<Entry>::iterator>::iterator found = filePages.find(pageNo);
+  if (found != filePages.end())
+  {
+    used -= found->second->data.size() + ENTRY_OVERHEAD;
+    lru.erase(found->second);
+  }
+
+  lru.push_front(Entry());
+  Entry& entry = lru.front();
+  entry.key.file = file;
+  entry.key.pageNo = pageNo;
+  entry.data.swap(compressed);
+  used += entry.data.size() + ENTRY_OVERHEAD;
+  filePages[pageNo] = lru.begin();
+  trim();
+}
+
+bool VictimCache::take(const FileId file, const PageId pageNo, Page& page)
+{
+  std::string data;
+  {
+    std::lock_guard<std::mutex> guard(latch);
+    std::unordered_map<FileId, std::unordered_map<PageId, std::list<Entry>::iterator> >::iterator
+        filePages = index.find(file);
+    if (filePages == index.end())
+      return false;
+    std::unordered_map<PageId, std::list<Entry>::iterator>::iterator found = filePages->second.find(pageNo);
+    if (found == filePages->second.end())
+      return false;
+    unlink(found->second, &data);
+  }
+  return decompress(data, page);
+}
+
+void VictimCache::erase(const FileId file, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  std::unordered_map<FileId, std::unordered_map<PageId, std::list<Entry>::iterator> >::iterator
+      filePages = index.find(file);
+  if (filePages == index.end())
+    return;
+  std::unordered_map<PageId, std::list<Entry>::iterator>::iterator found = filePages->second.find(pageNo);
+  if (found != filePages->second.end())
+    unlink(found->second);
+}
+
+void VictimCache::eraseFile(const FileId file)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  std::unordered_map<FileId, std::unordered_map<PageId, std::list<Entry>::iterator> >::iterator
+      filePages = index.find(file);
+  if (filePages == index.end())
+    return;
+  for (std::unordered_map<PageId, std::list<Entry>::iterator>::iterator it = filePages->second.begin();
+       it != filePages->second.end(); ++it)
+  {
+    used -= it->second->data.size() + ENTRY_OVERHEAD;
+    lru.erase(it->second);
+  }
+  index.erase(filePages);
+}
+
+std::size_t VictimCache::pages()
+{
+  std::lock_guard<std::mutex> guard(latch);
+  return lru.size();
+}
+
+std::size_t VictimCache::bytesUsed()
+{
+  std::lock_guard<std::mutex> guard(latch);
+  return used;
+}
+
+void VictimCache::unlink(std::list<Entry>::iterator it, std::string* data)
+{
+  used -= it->data.size() + ENTRY_OVERHEAD;
+  if (data != NULL)
+    data->swap(it->data);
+  std::unordered_map<FileId, std::unordered_map<PageId, std::list<Entry>::iterator> >::iterator
+      filePages = index.find(it->key.file);
+  filePages->second.erase(it->key.pageNo);
+  if (filePages->second.empty())
+    index.erase(filePages);
+  lru.erase(it);
+}
+
+void VictimCache::trim()
+{
+  while (used > budget.load() && !lru.empty())
+    unlink(--lru.end());
+}
+
+}
@@ -0,0 +1,180 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "file.h"
+#include "page.h"
+#include "replacement_policy.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Second buffer tier keeping clean pages evicted from the pool in compressed form.
+ *
+ * Pages are compressed with a small LZ77 codec which needs no outside library and mostly
+ * pays off on long runs of equal bytes (zeroed page tails, unused B+tree slots) and repeated
+ * records. Pages which do not compress to at most MAX_STORED_SIZE bytes are not kept. The
+ * compressed pages live in LRU order within a memory budget; a page taken back into the pool
+ * leaves the cache, so each page is in at most one of the two tiers.
+ *
+ * The cache has a latch of its own, always taken last: callers may hold a hash table latch.
+ */
+class VictimCache
+{
+ public:
+	/**
+	 * Largest compressed page worth keeping
+	 */
+	static const std::size_t MAX_STORED_SIZE = Page::SIZE / 2;
+
+	/**
+	 * Bytes of bookkeeping charged to the budget for every page kept, on top of its data
+	 */
+	static const std::size_t ENTRY_OVERHEAD = 96;
+
+	/**
+	 * Constructor. The cache starts out disabled.
+	 */
+	VictimCache();
+
+	/**
+	 * Changes the memory budget, dropping the least recently evicted pages that no longer fit.
+	 *
+	 * @param bytes	New budget; 0 disables the cache and empties it
+	 */
+	void setBudget(const std::size_t bytes);
+
+	/**
+	 * @return  True if the budget is not zero
+	 */
+	bool enabled() const
+	{
+		return budget.load(std::memory_order_relaxed) != 0;
+	}
+
+	/**
+	 * Compresses a page for put().
+	 *
+	 * @param page	Page to compress
+	 * @param out 	Receives the compressed page
+	 * @return  		False if the page does not compress to MAX_STORED_SIZE bytes or less.
+	 */
+	static bool compress(const Page& page, std::string& out);
+
+	/**
+	 * Restores a page compressed with compress().
+	 *
+	 * @param in  	Compressed page
+	 * @param page	Receives the page
+	 * @return  		False if the data is not a complete compressed page.
+	 */
+	static bool decompress(const std::string& in, Page& page);
+
+	/**
+	 * Keeps a compressed page as the most recently evicted one, replacing any older copy.
+	 *
+	 * @param file      	Id of the file the page belongs to
+	 * @param pageNo    	Page number in the file
+	 * @param compressed	Output of compress(); its contents are taken over
+	 */
+	void put(const FileId file, const PageId pageNo, std::string& compressed);
+
+	/**
+	 * Removes a page from the cache and decompresses it into a frame.
+	 *
+	 * @param file  	Id of the file the page belongs to
+	 * @param pageNo	Page number in the file
+	 * @param page  	Receives the page
+	 * @return  			False if the page is not in the cache.
+	 */
+	bool take(const FileId file, const PageId pageNo, Page& page);
+
+	/**
+	 * Drops a page, e.g. because it was deleted from its file.
+	 *
+	 * @param file  	Id of the file the page belongs to
+	 * @param pageNo	Page number in the file
+	 */
+	void erase(const FileId file, const PageId pageNo);
+
+	/**
+	 * Drops all pages of a file, e.g. when it is flushed. Pages of a file which was closed
+	 * are never asked for again, as its id is not reused; they age out.
+	 *
+	 * @param file	Id of the file
+	 */
+	void eraseFile(const FileId file);
+
+	/**
+	 * @return  Number of pages kept
+	 */
+	std::size_t pages();
+
+	/**
+	 * @return  Bytes charged to the budget
+	 */
+	std::size_t bytesUsed();
+
+ private:
+	/**
+	 * A kept page
+	 */
+	struct Entry
+	{
+		PageKey key;
+		std::string data;
+	};
+
+	/**
+	 * Kept pages, most recently evicted first
+	 */
+	std::list<Entry> lru;
+
+	/**
+	 * Position of every kept page in lru, by file so that a file's pages can be dropped
+	 * without a sweep
+	 */
+	std::unordered_map<FileId, std::unordered_map<PageId, std::list<Entry>::iterator> > index;
+
+	/**
+	 * Memory budget in bytes; 0 when disabled
+	 */
+	std::atomic<std::size_t> budget;
+
+	/**
+	 * Bytes charged for the pages kept
+	 */
+	std::size_t used;
+
+	/**
+	 * Guards lru, index and used
+	 */
+	std::mutex latch;
+
+	/**
+	 * Removes a page from lru and index. Caller holds latch.
+	 *
+	 * @param it  	Page to remove
+	 * @param data	If not NULL, receives the compressed page
+	 */
+	void unlink(std::list<Entry>::iterator it, std::string* data = NULL);
+
+	/**
+	 * Drops the least recently evicted pages until used is within budget. Caller holds latch.
+	 */
+	void trim();
+};
+
+}